@@ -0,0 +1,450 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef WCRP_BENCH_CPP
+#define WCRP_BENCH_CPP
+
+#include "common.hpp"
+#include "MixtureWCRP.hpp"
+
+using namespace std;
+
+// microbenchmarks for the sampler's inner loops
+// each kernel is run repeatedly until at least min_time seconds have elapsed, then its throughput is
+// reported as one tab-separated line: calls/sec plus a kernel-specific unit (trials/sec, draws/sec, ...)
+
+
+// returns num_skills * skill_size items and enough students that each item is studied by roughly students_per_item of them
+// every student has seq_len trials on uniformly drawn items. the expert labels group consecutive items into skills of size skill_size
+Dataset make_synthetic_dataset(Random & generator, const size_t num_skills, const size_t skill_size, const size_t students_per_item, const size_t seq_len) {
+
+    const size_t num_items = num_skills * skill_size;
+    const double p_studied = 1.0 - pow(1.0 - 1.0 / num_items, (double) seq_len);
+    const size_t num_students = max((size_t) 1, (size_t) ceil(students_per_item / p_studied));
+
+    vector< vector<bool> > recall_sequences(num_students);
+    vector< vector<size_t> > item_sequences(num_students);
+    for (size_t student = 0; student < num_students; student++) {
+        for (size_t trial = 0; trial < seq_len; trial++) {
+            item_sequences[student].push_back(generator.sampleUniformDiscrete(num_items));
+            recall_sequences[student].push_back(generator.sampleBernoulli(.6));
+        }
+    }
+
+    vector<size_t> provided_skill_labels(num_items);
+    for (size_t item = 0; item < num_items; item++) provided_skill_labels[item] = item / skill_size;
+    return Dataset(recall_sequences, item_sequences, provided_skill_labels, num_items);
+}
+
+
+// every student trains
+wcrp_config bench_config(const double beta, const size_t num_subsamples) {
+    wcrp_config config;
+    config.beta = beta;
+    config.init_alpha_prime = 1.0;
+    config.num_subsamples = num_subsamples;
+    return config;
+}
+
+
+// keeps calling a kernel until enough wall-clock time has passed
+class Stopwatch {
+
+  public:
+
+    Stopwatch(const double min_time) : min_time(min_time), calls(0), units(0), start(get_wall_time()), elapsed(0) {}
+
+    // returns true while the kernel should be called again. call once per kernel invocation
+    bool keep_going() {
+        elapsed = get_wall_time() - start;
+        return calls == 0 || elapsed < min_time;
+    }
+
+    void tally(const size_t units_done) {
+        calls++;
+        units += units_done;
+    }
+
+    const double min_time;
+    size_t calls;
+    size_t units;
+    double start;
+    double elapsed;
+};
+
+
+// exposes the sampler's protected kernels so they can be timed in isolation
+class BenchWCRP : public MixtureWCRP {
+
+  public:
+
+    BenchWCRP(Random * generator, const Dataset & dataset, const double beta, const size_t num_subsamples) :
+        MixtureWCRP(generator, dataset, bench_config(beta, num_subsamples)) {}
+
+    // skill_log_likelihood without cached forward state, as used when updating a skill's BKT parameters
+    void bench_skill_log_likelihood(Stopwatch & watch) {
+        vector<size_t> tables(extant_tables.begin(), extant_tables.end());
+        vector< vector<size_t> > students(tables.size()), first_exposures(tables.size());
+        vector<size_t> num_trials(tables.size(), 0);
+        for (size_t k = 0; k < tables.size(); k++) {
+            const boost::unordered_map<size_t, vector<size_t> > & lookup = trial_lookup.at(tables[k]);
+            for (boost::unordered_map<size_t, vector<size_t> >::const_iterator itr = lookup.begin(); itr != lookup.end(); itr++) {
+                students[k].push_back(itr->first);
+                first_exposures[k].push_back(0);
+                num_trials[k] += itr->second.size();
+            }
+        }
+
+        double sink = 0.0;
+        for (size_t k = 0; watch.keep_going(); k = (k + 1) % tables.size()) {
+            sink += skill_log_likelihood(tables[k], students[k], first_exposures[k]);
+            watch.tally(num_trials[k]);
+        }
+        assert(sink <= 0.0);
+    }
+
+    // skill_log_likelihood bootstrapped from cache_p_hat, as used when scoring candidate tables in the gibbs step
+    // only the scoring is timed; removing the item and caching the forward state are excluded
+    void bench_cached_skill_log_likelihood(Stopwatch & watch) {
+        size_t skipped = 0;
+        for (size_t item = 0; watch.keep_going(); item = (item + 1) % num_items) {
+            const double setup_begin = get_wall_time();
+            const vector<size_t> & affected_students = students_who_studied.at(item);
+            const vector<size_t> & first_exposures = all_first_encounters.at(item);
+            const size_t cur_table_id = seating_arrangement.at(item);
+            if (affected_students.empty() || table_sizes.at(cur_table_id) == 1) {
+                if (++skipped > num_items) break; // every item sits alone
+                continue;
+            }
+            skipped = 0;
+
+            remove_item_from_table(item, cur_table_id);
+            vector< boost::unordered_map<size_t, double> > p_hat(affected_students.size());
+            for (size_t student_idx = 0; student_idx < affected_students.size(); student_idx++) cache_p_hat(affected_students[student_idx], first_exposures[student_idx], p_hat[student_idx]);
+
+            const double begin = get_wall_time();
+            for (set<size_t>::const_iterator table_itr = extant_tables.begin(); table_itr != extant_tables.end(); table_itr++) skill_log_likelihood(*table_itr, affected_students, first_exposures, p_hat);
+            const double scoring_time = get_wall_time() - begin;
+
+            size_t trials_walked = 0;
+            for (set<size_t>::const_iterator table_itr = extant_tables.begin(); table_itr != extant_tables.end(); table_itr++) trials_walked += count_trials_from(*table_itr, affected_students, first_exposures);
+            assign_item_to_table(item, cur_table_id, false);
+
+            watch.start += (get_wall_time() - setup_begin) - scoring_time;
+            watch.tally(trials_walked);
+        }
+    }
+
+    // the whole gibbs conditional of one item, including cache_p_hat. units are extant tables scored
+    void bench_score_candidate_tables(Stopwatch & watch) {
+        score_every_item(watch);
+    }
+
+    // as above, without batching tables into vector lanes
+    void bench_score_candidate_tables_per_table(Stopwatch & watch) {
+        max_batched_table_size = 0;
+        score_every_item(watch);
+        max_batched_table_size = MAX_BATCHED_TABLE_SIZE;
+    }
+
+    void bench_cache_p_hat(Stopwatch & watch) {
+        boost::unordered_map<size_t, double> p_hat;
+        for (size_t student = 0; watch.keep_going(); student = (student + 1) % num_students) {
+            cache_p_hat(student, dataset->get_item_sequences().at(student).size(), p_hat);
+            watch.tally(dataset->get_item_sequences().at(student).size());
+        }
+    }
+
+    // compute_K for one unassigned item against every extant table. units are (item, table) pairs
+    void bench_compute_K(Stopwatch & watch) {
+        double sink = 0.0;
+        size_t skipped = 0;
+        for (size_t item = 0; watch.keep_going(); item = (item + 1) % num_items) {
+            const double setup_begin = get_wall_time();
+            const size_t cur_table_id = seating_arrangement.at(item);
+            if (table_sizes.at(cur_table_id) == 1) {
+                if (++skipped > num_items) break; // every item sits alone
+                continue;
+            }
+            skipped = 0;
+
+            remove_item_from_table(item, cur_table_id);
+            const double begin = get_wall_time();
+            for (set<size_t>::const_iterator table_itr = extant_tables.begin(); table_itr != extant_tables.end(); table_itr++) sink += compute_K(item, *table_itr, false);
+            const double scoring_time = get_wall_time() - begin;
+            assign_item_to_table(item, cur_table_id, false);
+
+            watch.start += (get_wall_time() - setup_begin) - scoring_time;
+            watch.tally(extant_tables.size());
+        }
+        assert(sink >= 0.0);
+    }
+
+    // units are items seated
+    void bench_log_seating_prob(Stopwatch & watch) {
+        double sink = 0.0;
+        while (watch.keep_going()) {
+            sink += log_seating_prob();
+            watch.tally(num_items);
+        }
+        assert(sink <= 0.0);
+    }
+
+    // one remove + one reassign of the same item. units are trials moved in or out of trial_lookup
+    void bench_assign_remove(Stopwatch & watch) {
+        size_t skipped = 0;
+        for (size_t item = 0; watch.keep_going(); item = (item + 1) % num_items) {
+            const size_t cur_table_id = seating_arrangement.at(item);
+            if (table_sizes.at(cur_table_id) == 1) {
+                if (++skipped > num_items) break; // every item sits alone
+                continue;
+            }
+            skipped = 0;
+
+            size_t trials_moved = 0;
+            const vector<size_t> & affected_students = students_who_studied.at(item);
+            for (size_t student_idx = 0; student_idx < affected_students.size(); student_idx++) trials_moved += trials_studied[affected_students[student_idx]][item].size();
+
+            remove_item_from_table(item, cur_table_id);
+            assign_item_to_table(item, cur_table_id, false);
+            watch.tally(2 * trials_moved);
+        }
+    }
+
+    // a draw over as many events as the gibbs step considers. units are events scanned
+    void bench_sample_unnormalized_discrete(Stopwatch & watch) {
+        vector<double> log_probs(num_used_skills + num_subsamples);
+        for (size_t event = 0; event < log_probs.size(); event++) log_probs[event] = -50.0 * generator->sampleUniform01();
+        vector<double> scratch(log_probs.size());
+
+        size_t sink = 0;
+        while (watch.keep_going()) {
+            copy(log_probs.begin(), log_probs.end(), scratch.begin()); // the draw normalizes its argument in place
+            sink += generator->sampleUnnormalizedDiscrete(scratch);
+            watch.tally(scratch.size());
+        }
+        assert(sink < watch.calls * log_probs.size());
+    }
+
+    // units are trials predicted. the recorded samples are discarded afterward
+    void bench_record_sample(Stopwatch & watch) {
+        size_t total_trials = 0;
+        for (size_t student = 0; student < num_students; student++) total_trials += dataset->get_item_sequences().at(student).size();
+
+        while (watch.keep_going()) {
+            record_sample(0, 0.0);
+            watch.tally(total_trials);
+
+            // keep memory bounded
+            if (memory_sink.get_num_samples() >= 64) memory_sink.clear();
+        }
+        memory_sink.clear();
+    }
+
+    double mean_students_per_item() const {
+        size_t total = 0;
+        for (size_t item = 0; item < num_items; item++) total += students_who_studied.at(item).size();
+        return 1.0 * total / num_items;
+    }
+
+  protected:
+
+    // only the scoring is timed; removing and reassigning the item are excluded
+    void score_every_item(Stopwatch & watch) {
+        vector<size_t> keys;
+        vector<double> log_probs;
+        size_t skipped = 0;
+        for (size_t item = 0; watch.keep_going(); item = (item + 1) % num_items) {
+            const size_t cur_table_id = seating_arrangement.at(item);
+            if (students_who_studied.at(item).empty() || table_sizes.at(cur_table_id) == 1) {
+                if (++skipped > num_items) break; // every item sits alone
+                continue;
+            }
+            skipped = 0;
+
+            const double setup_begin = get_wall_time();
+            remove_item_from_table(item, cur_table_id);
+            const double begin = get_wall_time();
+            score_candidate_tables(item, keys, log_probs);
+            const double scoring_time = get_wall_time() - begin;
+            assign_item_to_table(item, cur_table_id, false);
+
+            watch.start += (get_wall_time() - setup_begin) - scoring_time;
+            watch.tally(keys.size());
+        }
+    }
+
+    // the number of trials skill_log_likelihood walks for these students in this table
+    size_t count_trials_from(const size_t table_id, const vector<size_t> & affected_students, const vector<size_t> & first_exposures) const {
+        size_t n = 0;
+        const boost::unordered_map<size_t, vector<size_t> > & lookup = trial_lookup.at(table_id);
+        for (size_t student_idx = 0; student_idx < affected_students.size(); student_idx++) {
+            boost::unordered_map<size_t, vector<size_t> >::const_iterator itr = lookup.find(affected_students[student_idx]);
+            if (itr == lookup.end()) continue;
+            n += itr->second.end() - lower_bound(itr->second.begin(), itr->second.end(), first_exposures[student_idx]);
+        }
+        return n;
+    }
+};
+
+
+void report(const string & kernel, const size_t skill_size, const size_t students_per_item, const size_t seq_len, const double mean_students_per_item, const Stopwatch & watch, const string & unit) {
+    cout << kernel << "\t" << skill_size << "\t" << students_per_item << "\t" << seq_len << "\t" << setprecision(1) << mean_students_per_item << "\t"
+         << watch.calls << "\t" << setprecision(4) << watch.elapsed << "\t" << setprecision(1) << (watch.calls / watch.elapsed) << "\t"
+         << (watch.units / watch.elapsed) << "\t" << unit << endl;
+}
+
+
+// in the order run_all_kernels runs them
+const char * const KERNEL_NAMES[] = {"skill_log_likelihood", "cached_skill_log_likelihood", "score_candidate_tables", "per_table_score_candidate_tables", "cache_p_hat",
+                                     "compute_K", "log_seating_prob", "assign_remove", "sample_unnormalized_discrete", "record_sample"};
+const size_t NUM_KERNELS = sizeof(KERNEL_NAMES) / sizeof(KERNEL_NAMES[0]);
+
+
+void run_all_kernels(BenchWCRP & model, const set<string> & kernels, const double min_time, const size_t skill_size, const size_t students_per_item, const size_t seq_len) {
+
+    const double spi = model.mean_students_per_item();
+    #define RUN_KERNEL(name, method, unit) \
+        if (kernels.count(name)) { Stopwatch watch(min_time); model.method(watch); report(name, skill_size, students_per_item, seq_len, spi, watch, unit); }
+
+    RUN_KERNEL("skill_log_likelihood", bench_skill_log_likelihood, "trials");
+    RUN_KERNEL("cached_skill_log_likelihood", bench_cached_skill_log_likelihood, "trials");
+    RUN_KERNEL("score_candidate_tables", bench_score_candidate_tables, "tables");
+    RUN_KERNEL("per_table_score_candidate_tables", bench_score_candidate_tables_per_table, "tables");
+    RUN_KERNEL("cache_p_hat", bench_cache_p_hat, "trials");
+    RUN_KERNEL("compute_K", bench_compute_K, "tables");
+    RUN_KERNEL("log_seating_prob", bench_log_seating_prob, "items");
+    RUN_KERNEL("assign_remove", bench_assign_remove, "trials");
+    RUN_KERNEL("sample_unnormalized_discrete", bench_sample_unnormalized_discrete, "events");
+    RUN_KERNEL("record_sample", bench_record_sample, "trials");
+
+    #undef RUN_KERNEL
+}
+
+
+// "all" or a comma-separated list of kernel names, each of which has to match exactly
+set<string> parse_kernel_list(const string & text) {
+    set<string> kernels;
+    if (text == "all") {
+        kernels.insert(KERNEL_NAMES, KERNEL_NAMES + NUM_KERNELS);
+        return kernels;
+    }
+    vector<string> fields;
+    boost::split(fields, text, boost::is_any_of(","));
+    for (size_t i = 0; i < fields.size(); i++) {
+        if (find(KERNEL_NAMES, KERNEL_NAMES + NUM_KERNELS, fields[i]) == KERNEL_NAMES + NUM_KERNELS) {
+            cerr << "unknown kernel " << fields[i] << " (expected all or a comma-separated list of:";
+            for (size_t kernel = 0; kernel < NUM_KERNELS; kernel++) cerr << " " << KERNEL_NAMES[kernel];
+            cerr << ")" << endl;
+            exit(EXIT_FAILURE);
+        }
+        kernels.insert(fields[i]);
+    }
+    return kernels;
+}
+
+
+vector<size_t> parse_size_list(const string & text) {
+    vector<string> fields;
+    boost::split(fields, text, boost::is_any_of(","));
+    vector<size_t> values;
+    for (size_t i = 0; i < fields.size(); i++) values.push_back(boost::lexical_cast<size_t>(fields[i]));
+    return values;
+}
+
+
+int main(int argc, char ** argv) {
+
+    namespace po = boost::program_options;
+
+    string datafile, expertfile, skill_sizes_text, students_per_item_text, seq_lens_text, kernels_text;
+    int tmp_num_skills, tmp_num_subsamples;
+    unsigned int seed;
+    double min_time, beta;
+
+    // parse the command line arguments
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "print help message")
+        ("datafile", po::value<string>(&datafile), "(optional) benchmark on this dataset instead of synthetic data")
+        ("expertfile", po::value<string>(&expertfile), "(optional) expert-provided skill labels for --datafile. they determine the benchmarked seating arrangement")
+        ("skill_sizes", po::value<string>(&skill_sizes_text)->default_value("2,8,32"), "comma-separated list of synthetic items per skill")
+        ("students_per_item", po::value<string>(&students_per_item_text)->default_value("10,100"), "comma-separated list of synthetic students per item")
+        ("seq_lens", po::value<string>(&seq_lens_text)->default_value("50,500"), "comma-separated list of synthetic trials per student")
+        ("num_skills", po::value<int>(&tmp_num_skills)->default_value(16), "number of synthetic skills")
+        ("kernels", po::value<string>(&kernels_text)->default_value("all"), "comma-separated list of kernels to run, or all")
+        ("min_time", po::value<double>(&min_time)->default_value(.5), "minimum number of seconds to run each kernel")
+        ("beta", po::value<double>(&beta)->default_value(.5), "WCRP beta used by the kernels (must be < 1)")
+        ("num_subsamples", po::value<int>(&tmp_num_subsamples)->default_value(100), "number of auxiliary samples for new skills")
+        ("seed", po::value<unsigned int>(&seed)->default_value(1), "random seed for the synthetic data and the model")
+    ;
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        cout << desc << endl;
+        return EXIT_SUCCESS;
+    }
+
+    assert(beta >= 0 && beta < 1);
+    assert(tmp_num_skills > 0 && tmp_num_subsamples > 0);
+    const size_t num_skills = (size_t) tmp_num_skills;
+    const size_t num_subsamples = (size_t) tmp_num_subsamples;
+    const set<string> kernels = parse_kernel_list(kernels_text);
+
+    cout.setf(ios::fixed);
+    const string header = "kernel\tskill_size\tstudents_per_item\tseq_len\tmeasured_students_per_item\tcalls\tsec\tcalls_per_sec\tunits_per_sec\tunit";
+
+    if (!datafile.empty()) {
+        const Dataset dataset(datafile.c_str(), expertfile.empty() ? NULL : expertfile.c_str());
+        Random generator(seed);
+        BenchWCRP model(&generator, dataset, beta, num_subsamples);
+        cout << header << endl; // after load_student_data's status message
+        run_all_kernels(model, kernels, min_time, 0, 0, 0);
+        return EXIT_SUCCESS;
+    }
+
+    const vector<size_t> skill_sizes = parse_size_list(skill_sizes_text);
+    const vector<size_t> students_per_item = parse_size_list(students_per_item_text);
+    const vector<size_t> seq_lens = parse_size_list(seq_lens_text);
+    cout << header << endl;
+
+    for (size_t i = 0; i < skill_sizes.size(); i++) {
+        for (size_t j = 0; j < students_per_item.size(); j++) {
+            for (size_t k = 0; k < seq_lens.size(); k++) {
+                Random generator(seed);
+                const Dataset dataset = make_synthetic_dataset(generator, num_skills, skill_sizes[i], students_per_item[j], seq_lens[k]);
+                BenchWCRP model(&generator, dataset, beta, num_subsamples);
+                run_all_kernels(model, kernels, min_time, skill_sizes[i], students_per_item[j], seq_lens[k]);
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,320 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef WCRP_CHAIN_BENCH_CPP
+#define WCRP_CHAIN_BENCH_CPP
+
+#include "common.hpp"
+#include "Diagnostics.hpp"
+#include "Dataset.hpp"
+#include "MixtureWCRP.hpp"
+
+using namespace std;
+
+// end-to-end benchmark: runs fixed-seed chains and reports how many effective samples they produce per second
+// of wall time (setup + sampling). the effective sample sizes are computed on the post burn-in samples of
+// the training data log likelihood, the number of skills and, if a reference partition is given, the adjusted
+// Rand index to it. with --approximate_top_k, each chain is also run with the exact Gibbs step, and the summary reports how far
+// the approximate chains' posterior drifts from the exact ones'
+
+
+struct chain_result {
+    unsigned int seed;
+    double setup_seconds;
+    double sampling_seconds;
+    vector<double> train_ll_trace;
+    vector<double> num_skills_trace;
+    vector<double> ari_trace;
+    vector<double> coassignment;     // coassignment[i * num_items + j] = fraction of samples seating items i and j together. only with --approximate_top_k
+    double mean_rejection_rate;      // of the approximate Gibbs steps' proposals, averaged over iterations
+    double mean_unscored_fraction;   // of the candidate tables not scored exactly, averaged over iterations
+};
+
+
+// averages the per-sweep rejection rate and fraction of tables not scored exactly
+class SweepStatsObserver : public ChainObserver {
+
+  public:
+
+    SweepStatsObserver() : num_iterations(0), rejection_rate(0.0), unscored_fraction(0.0) {}
+
+    bool after_iteration(const MixtureWCRP & model, const size_t /*iteration*/, const double /*train_ll*/) {
+        num_iterations++;
+        rejection_rate += model.get_rejection_rate();
+        unscored_fraction += model.get_pruned_fraction();
+        return true;
+    }
+
+    size_t num_iterations;
+    double rejection_rate;
+    double unscored_fraction;
+};
+
+
+chain_result run_chain(const Dataset & dataset, const wcrp_config & config, const unsigned int seed, const size_t num_iterations, const size_t burn, const bool infer_beta, const bool infer_alpha_prime, const vector<size_t> & reference_labels, const bool want_coassignment) {
+    chain_result chain;
+    chain.seed = seed;
+    Random generator(chain.seed);
+
+    const double setup_begin = get_wall_time();
+    MixtureWCRP model(&generator, dataset, config);
+    model.set_progress_stream(NULL); // stdout carries only the JSON summary
+    SweepStatsObserver sweep_stats;
+    model.add_observer(&sweep_stats);
+    const CoassignmentCounts * coassignment = want_coassignment ? &model.enable_coassignment() : NULL; // the counts cost time in record_sample
+    const double sampling_begin = get_wall_time();
+    model.run_mcmc(num_iterations, burn, infer_beta, infer_alpha_prime);
+    const double sampling_end = get_wall_time();
+
+    chain.setup_seconds = sampling_begin - setup_begin;
+    chain.sampling_seconds = sampling_end - sampling_begin;
+    chain.mean_rejection_rate = sweep_stats.rejection_rate / max((size_t) 1, sweep_stats.num_iterations);
+    chain.mean_unscored_fraction = sweep_stats.unscored_fraction / max((size_t) 1, sweep_stats.num_iterations);
+    chain.train_ll_trace = model.get_train_ll_samples();
+    const vector< vector<size_t> > skill_samples = model.get_sampled_skill_labels();
+    for (size_t sample = 0; sample < skill_samples.size(); sample++) {
+        chain.num_skills_trace.push_back(num_distinct_labels(skill_samples[sample]));
+        if (!reference_labels.empty()) chain.ari_trace.push_back(adjusted_rand_index(skill_samples[sample], reference_labels));
+    }
+    const size_t num_items = dataset.get_num_items();
+    if (want_coassignment) {
+        chain.coassignment.assign(num_items * num_items, 0.0);
+        for (size_t i = 0; i < num_items; i++) {
+            for (size_t j = 0; j < num_items; j++) chain.coassignment[i * num_items + j] = coassignment->get_probability(i, j);
+        }
+    }
+    return chain;
+}
+
+
+double mean_of(const vector<double> & values) {
+    return values.empty() ? 0.0 : accumulate(values.begin(), values.end(), 0.0) / values.size();
+}
+
+
+// writes "name": {"ess": ..., "ess_per_sec": ..., "mean": ...} summed/averaged over chains
+void write_trace_summary(ostream & out, const string & name, const vector<chain_result> & chains, vector<double> chain_result::* trace, const double wall_seconds) {
+    double ess = 0.0;
+    vector<double> means;
+    for (size_t c = 0; c < chains.size(); c++) {
+        ess += effective_sample_size(chains[c].*trace);
+        means.push_back(mean_of(chains[c].*trace));
+    }
+    out << "    \"" << name << "\": {\"ess\": " << ess << ", \"ess_per_sec\": " << (ess / wall_seconds) << ", \"mean\": " << mean_of(means) << "}";
+}
+
+
+// how far the approximate chains' posterior is from the exact chains': the largest and mean absolute difference between their 
+// co-assignment frequencies (averaged over chains), and the two posterior means of the number of skills and training log likelihood
+void write_drift(ostream & out, const size_t approximate_top_k, const vector<chain_result> & approximate_chains, const vector<chain_result> & exact_chains) {
+    const size_t num_entries = exact_chains[0].coassignment.size();
+    vector<double> exact_coassignment(num_entries, 0.0), approximate_coassignment(num_entries, 0.0);
+    vector<double> num_skills[2], train_ll[2];
+    double exact_seconds = 0.0, approximate_seconds = 0.0, rejection_rate = 0.0, unscored_fraction = 0.0;
+    for (size_t c = 0; c < exact_chains.size(); c++) {
+        for (size_t k = 0; k < num_entries; k++) {
+            exact_coassignment[k] += exact_chains[c].coassignment[k] / exact_chains.size();
+            approximate_coassignment[k] += approximate_chains[c].coassignment[k] / exact_chains.size();
+        }
+        num_skills[0].push_back(mean_of(exact_chains[c].num_skills_trace));
+        num_skills[1].push_back(mean_of(approximate_chains[c].num_skills_trace));
+        train_ll[0].push_back(mean_of(exact_chains[c].train_ll_trace));
+        train_ll[1].push_back(mean_of(approximate_chains[c].train_ll_trace));
+        exact_seconds += exact_chains[c].sampling_seconds;
+        approximate_seconds += approximate_chains[c].sampling_seconds;
+        rejection_rate += approximate_chains[c].mean_rejection_rate / exact_chains.size();
+        unscored_fraction += approximate_chains[c].mean_unscored_fraction / exact_chains.size();
+    }
+    double max_diff = 0.0, mean_diff = 0.0;
+    for (size_t k = 0; k < num_entries; k++) {
+        max_diff = max(max_diff, abs(exact_coassignment[k] - approximate_coassignment[k]));
+        mean_diff += abs(exact_coassignment[k] - approximate_coassignment[k]) / num_entries;
+    }
+
+    out << "  \"drift_vs_exact\": {\"approximate_top_k\": " << approximate_top_k << ", \"max_coassignment_diff\": " << max_diff << ", \"mean_coassignment_diff\": " << mean_diff
+        << ", \"mean_num_skills\": {\"exact\": " << mean_of(num_skills[0]) << ", \"approximate\": " << mean_of(num_skills[1]) << "}"
+        << ", \"mean_train_ll\": {\"exact\": " << mean_of(train_ll[0]) << ", \"approximate\": " << mean_of(train_ll[1]) << "}"
+        << ", \"sampling_seconds\": {\"exact\": " << exact_seconds << ", \"approximate\": " << approximate_seconds << "}"
+        << ", \"rejection_rate\": " << rejection_rate << ", \"unscored_fraction\": " << unscored_fraction << "}," << endl;
+}
+
+
+void write_summary(ostream & out, const string & datafile, const size_t num_students, const size_t num_items, const size_t num_trials, const size_t num_iterations, const size_t burn, const vector<chain_result> & chains, const bool have_reference, const size_t approximate_top_k, const vector<chain_result> & exact_chains) {
+
+    double setup_seconds = 0.0, sampling_seconds = 0.0;
+    for (size_t c = 0; c < chains.size(); c++) {
+        setup_seconds += chains[c].setup_seconds;
+        sampling_seconds += chains[c].sampling_seconds;
+    }
+    const double wall_seconds = setup_seconds + sampling_seconds;
+
+    out << setprecision(6);
+    out << "{" << endl;
+    out << "  \"datafile\": ";
+    write_json_string(out, datafile);
+    out << "," << endl;
+    out << "  \"num_students\": " << num_students << ", \"num_items\": " << num_items << ", \"num_trials\": " << num_trials << "," << endl;
+    out << "  \"iterations\": " << num_iterations << ", \"burn\": " << burn << ", \"num_chains\": " << chains.size() << "," << endl;
+    out << "  \"setup_seconds\": " << setup_seconds << ", \"sampling_seconds\": " << sampling_seconds << ", \"wall_seconds\": " << wall_seconds << "," << endl;
+    out << "  \"iterations_per_sec\": " << (num_iterations * chains.size() / sampling_seconds) << "," << endl;
+    out << "  \"peak_rss_kb\": " << peak_resident_memory_kb() << ", \"peak_vm_kb\": " << peak_virtual_memory_kb() << "," << endl;
+    out << "  \"traces\": {" << endl;
+    write_trace_summary(out, "train_ll", chains, &chain_result::train_ll_trace, wall_seconds);
+    out << "," << endl;
+    write_trace_summary(out, "num_skills", chains, &chain_result::num_skills_trace, wall_seconds);
+    if (have_reference) {
+        out << "," << endl;
+        write_trace_summary(out, "adjusted_rand_index", chains, &chain_result::ari_trace, wall_seconds);
+    }
+    out << endl << "  }," << endl;
+    if (!exact_chains.empty()) write_drift(out, approximate_top_k, chains, exact_chains);
+
+    out << "  \"chains\": [" << endl;
+    for (size_t c = 0; c < chains.size(); c++) {
+        const chain_result & chain = chains[c];
+        out << "    {\"seed\": " << chain.seed << ", \"setup_seconds\": " << chain.setup_seconds << ", \"sampling_seconds\": " << chain.sampling_seconds
+            << ", \"iterations_per_sec\": " << (num_iterations / chain.sampling_seconds)
+            << ", \"ess_train_ll\": " << effective_sample_size(chain.train_ll_trace)
+            << ", \"ess_num_skills\": " << effective_sample_size(chain.num_skills_trace);
+        if (have_reference) out << ", \"ess_adjusted_rand_index\": " << effective_sample_size(chain.ari_trace);
+        out << "}" << (c + 1 < chains.size() ? "," : "") << endl;
+    }
+    out << "  ]" << endl;
+    out << "}" << endl;
+}
+
+
+int main(int argc, char ** argv) {
+
+    namespace po = boost::program_options;
+
+    string datafile, savefile, expertfile, referencefile;
+    int tmp_num_iterations, tmp_burn, tmp_num_subsamples, tmp_num_chains, tmp_approximate_top_k;
+    double init_beta, init_alpha_prime, adaptive_scan_floor;
+    bool infer_beta, infer_alpha_prime;
+    unsigned int seed;
+
+    // parse the command line arguments
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "print help message")
+        ("datafile", po::value<string>(&datafile), "(required) file containing the student recall data")
+        ("savefile", po::value<string>(&savefile), "(optional) file to put the JSON summary. it's always printed to stdout")
+        ("expertfile", po::value<string>(&expertfile), "(optional) file containing the expert-provided skill labels")
+        ("reference", po::value<string>(&referencefile), "(optional) file with a reference skill partition (one line, one label per item) for the adjusted Rand index")
+        ("iterations", po::value<int>(&tmp_num_iterations)->default_value(200), "number of iterations per chain")
+        ("burn", po::value<int>(&tmp_burn)->default_value(100), "number of iterations to discard per chain")
+        ("chains", po::value<int>(&tmp_num_chains)->default_value(1), "number of chains. chain c uses seed + c")
+        ("seed", po::value<unsigned int>(&seed)->default_value(1), "random seed of the first chain")
+        ("fix_alpha_prime", po::value<double>(&init_alpha_prime), "(optional) fix alpha' at the provided value instead of letting the model try to estimate it")
+        ("fix_beta", po::value<double>(&init_beta), "(optional) fix beta at the provided value instead of giving it the Bayesian treatment")
+        ("num_subsamples", po::value<int>(&tmp_num_subsamples)->default_value(2000), "number of auxiliary samples to use when approximating the marginal likelihood of new skills")
+        ("adaptive_scan", po::value<double>(&adaptive_scan_floor)->default_value(0), "(optional) run the chains with find_skills' --adaptive_scan")
+        ("approximate_top_k", po::value<int>(&tmp_approximate_top_k)->default_value(0), "(optional) run the chains with find_skills' --approximate_top_k, and each seed again with the exact Gibbs step to report the posterior drift")
+    ;
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (argc == 1 || vm.count("help") || datafile.empty()) {
+        cout << desc << endl;
+        return EXIT_SUCCESS;
+    }
+
+    if (vm.count("fix_alpha_prime")) {
+        assert(init_alpha_prime >= 0);
+        infer_alpha_prime = false;
+    }
+    else {
+        init_alpha_prime = -1;
+        infer_alpha_prime = true;
+    }
+
+    if (vm.count("fix_beta")) {
+        assert(init_beta >= 0 && init_beta <= 1);
+        infer_beta = false;
+    }
+    else {
+        init_beta = .5;
+        infer_beta = true;
+    }
+
+    assert(tmp_num_chains > 0 && tmp_num_iterations > tmp_burn && tmp_burn >= 0 && tmp_approximate_top_k >= 0);
+    const size_t num_iterations = (size_t) tmp_num_iterations;
+    const size_t burn = (size_t) tmp_burn;
+    const size_t num_subsamples = (size_t) tmp_num_subsamples;
+    const size_t num_chains = (size_t) tmp_num_chains;
+    const size_t approximate_top_k = (size_t) tmp_approximate_top_k;
+
+    // load the dataset. every chain shares it
+    // the loader's status message goes to stderr, so stdout carries only the JSON summary
+    streambuf * stdout_buffer = cout.rdbuf(cerr.rdbuf());
+    const Dataset dataset(datafile.c_str(), expertfile.empty() ? NULL : expertfile.c_str());
+    cout.rdbuf(stdout_buffer);
+    const size_t num_students = dataset.get_num_students(), num_items = dataset.get_num_items(), num_trials = dataset.get_num_trials();
+    if (!dataset.has_expert_labels()) {
+        init_beta = 0.0;
+        infer_beta = false;
+    }
+
+    // the reference partition has the same format as find_skills' --map_estimate output
+    vector<size_t> reference_labels;
+    if (!referencefile.empty()) {
+        ifstream in(referencefile.c_str());
+        if (!in.is_open()) {
+            cerr << "couldn't open " << referencefile << endl;
+            exit(EXIT_FAILURE);
+        }
+        size_t label;
+        while (in >> label) reference_labels.push_back(label);
+        assert(reference_labels.size() == num_items);
+    }
+
+    wcrp_config config;
+    config.beta = init_beta;
+    config.init_alpha_prime = init_alpha_prime;
+    config.num_subsamples = num_subsamples;
+    assert(adaptive_scan_floor >= 0 && adaptive_scan_floor <= 1);
+    config.adaptive_scan_floor = adaptive_scan_floor;
+
+    vector<chain_result> chains, exact_chains;
+    for (size_t c = 0; c < num_chains; c++) {
+        if (approximate_top_k > 0) exact_chains.push_back(run_chain(dataset, config, seed + c, num_iterations, burn, infer_beta, infer_alpha_prime, reference_labels, true));
+        config.approximate_top_k = approximate_top_k;
+        chains.push_back(run_chain(dataset, config, seed + c, num_iterations, burn, infer_beta, infer_alpha_prime, reference_labels, approximate_top_k > 0));
+        config.approximate_top_k = 0;
+    }
+
+    write_summary(cout, datafile, num_students, num_items, num_trials, num_iterations, burn, chains, !reference_labels.empty(), approximate_top_k, exact_chains);
+    if (!savefile.empty()) {
+        ofstream out(savefile.c_str(), ofstream::out);
+        write_summary(out, datafile, num_students, num_items, num_trials, num_iterations, burn, chains, !reference_labels.empty(), approximate_top_k, exact_chains);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#endif
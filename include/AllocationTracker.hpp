@@ -0,0 +1,65 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ALLOCATION_TRACKER_H
+#define ALLOCATION_TRACKER_H
+
+#include <cstddef>
+
+// opt-in counting of heap allocations
+//
+// the counting hooks are in src/hooks/AllocationHooks.cpp, which replaces the global operator new and operator delete. it
+// isn't part of the wcrp library, so programs that link the library keep their allocator; the ones that report allocations 
+// link the wcrp_allocation_hooks object library too. until allocation_tracking_enable is called the hooks only forward to 
+// malloc and free. configuring with -DWCRP_TRACK_MALLOC=ON (glibc only) also counts calls to malloc, calloc, realloc, free 
+// and the aligned allocators made directly, e.g., by GSL
+//
+// the counts are process-wide; callers attribute them to whatever they were doing by differencing snapshots
+
+struct allocation_counts {
+    unsigned long long allocations;
+    unsigned long long deallocations;
+    unsigned long long bytes; // requested bytes, summed over allocations
+};
+
+void allocation_tracking_enable();
+
+bool allocation_tracking_enabled();
+
+// the counts accumulated since allocation_tracking_enable was called
+allocation_counts read_allocation_counts();
+
+// after - before
+allocation_counts allocation_difference(const allocation_counts & after, const allocation_counts & before);
+
+// true if the program linked the hooks. without them nothing is ever counted
+bool allocation_tracking_available();
+
+// called by the hooks
+void allocation_tracking_count_allocation(const size_t size);
+void allocation_tracking_count_deallocation(void * ptr);
+void allocation_tracking_hooks_installed();
+
+#endif
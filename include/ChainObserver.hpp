@@ -0,0 +1,50 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CHAIN_OBSERVER_H
+#define CHAIN_OBSERVER_H
+
+#include "common.hpp"
+
+class MixtureWCRP;
+
+
+class ChainObserver {
+
+ // hands control to the caller of MixtureWCRP::run_mcmc between the steps of the chain (see MixtureWCRP::add_observer). the model is 
+ // read-only here; either method can stop the run by returning false
+ public:
+
+    virtual ~ChainObserver() {}
+
+    // called after each phase of each iteration (numbered from 1). returning false ends the run without the rest of the iteration, 
+    // so it's only recorded if the phase was PHASE_RECORD
+    virtual bool after_phase(const MixtureWCRP & /*model*/, const size_t /*iteration*/, const sampler_phase /*phase*/) { return true; }
+
+    // called at the end of each iteration, after its sample is recorded if it's past burn-in. returning false ends the run
+    virtual bool after_iteration(const MixtureWCRP & /*model*/, const size_t /*iteration*/, const double /*train_ll*/) { return true; }
+};
+
+#endif
@@ -0,0 +1,82 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef COASSIGNMENT_H
+#define COASSIGNMENT_H
+
+#include <stdint.h>
+#include "common.hpp"
+
+
+class CoassignmentCounts {
+
+ // the number of recorded samples that put each pair of items in the same skill, kept sparsely as runs: a pair together in
+ // the latest sample remembers the sample its current run started at, so only the pairs whose co-membership changes between
+ // samples are touched. pairs that were never together take no space
+ public:
+
+    CoassignmentCounts(const size_t num_items);
+
+    // the pair is together from the next recorded sample on, or not. called before add_sample, only on a change
+    void pair_joined(const size_t item_a, const size_t item_b);
+    void pair_separated(const size_t item_a, const size_t item_b);
+
+    // a sample was recorded. the pairs together count it
+    void add_sample();
+
+    size_t get_num_items() const;
+    size_t get_num_samples() const;
+
+    // the number of samples that put the items in the same skill
+    size_t get_count(const size_t item_a, const size_t item_b) const;
+
+    // the fraction of samples that put the items in the same skill, 1 for an item with itself
+    double get_probability(const size_t item_a, const size_t item_b) const;
+
+    // visits every pair that was ever together, item_a < item_b, in no particular order
+    void get_pairs(std::vector< std::pair<size_t, size_t> > & pairs) const;
+
+    // writes "item_a <tab> item_b <tab> probability" for every pair that was ever together, item_a < item_b, sorted, after a 
+    // "num_items <tab> N" and "num_samples <tab> S" header. pairs missing from the file were never together
+    void save(const char * filename) const;
+
+    // forgets every sample
+    void clear(const size_t num_items);
+
+ protected:
+
+    struct pair_run {
+        size_t count;      // samples counted by the pair's finished runs
+        size_t run_start;  // the sample the current run started at, or NOT_TOGETHER
+    };
+
+    uint64_t pair_key(const size_t item_a, const size_t item_b) const;
+
+    boost::unordered_map<uint64_t, struct pair_run> runs;
+    size_t num_items;
+    size_t num_samples;
+};
+
+#endif
@@ -0,0 +1,67 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef COLD_START_H
+#define COLD_START_H
+
+#include "common.hpp"
+#include "Posterior.hpp"
+
+
+class ColdStartPlacer {
+
+ // the WCRP conditional of the skill of a newly authored item under each sample of a saved posterior
+ //
+ // an item without training trials leaves the data terms of the Gibbs conditional (see MixtureWCRP::score_candidate_tables) 
+ // the same with and without it, so what's left is the seating probability: each of the sample's skills in proportion to 
+ // its size and compute_K's agreement with the item's expert-provided skill, and a new skill in proportion to alpha'. 
+ // the expert-provided skills at each skill are tallied once per sample, so placing an item is O(number of samples x skills)
+ public:
+
+    // provided_skill_labels has an entry for every item, the samples' and the new ones
+    // the samples must have their WCRP hyperparameters
+    ColdStartPlacer(const std::vector<posterior_sample> & samples, const std::vector<size_t> & provided_skill_labels);
+
+    size_t get_num_samples() const;
+
+    // fills probs with the probability of each of the sample's skills (indexed by skill id), then of a new skill, 
+    // for a new item with the given expert-provided skill
+    void skill_probabilities(const size_t sample, const size_t expert_label, std::vector<double> & probs) const;
+
+ protected:
+
+    struct skill_tally {
+        size_t num_items;
+        int max_count;
+        boost::unordered_map<size_t, int> counts; // counts[expert skill id] = # of the skill's items with that id
+    };
+
+    std::vector< std::vector<skill_tally> > tallies; // tallies[sample][skill id]
+    std::vector<double> log_alpha_primes;
+    std::vector<double> log_gammas;
+    size_t num_expert_provided_skills;
+};
+
+#endif
@@ -0,0 +1,76 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef DATASET_H
+#define DATASET_H
+
+#include "common.hpp"
+
+
+class Dataset {
+
+ // an owning copy of the student data and the expert-provided skill labels. it can't be changed once it's built, so one
+ // instance can be shared by any number of models, on any number of threads, as long as it outlives them
+ public:
+
+    // loads a datafile in find_skills' format and, if expertfile isn't NULL, the expert-provided skill labels. without them
+    // every item is labelled 0. the expertfile labels the datafile's items, or num_labelled_items items if that's more, so the 
+    // labels can cover items that only appear in data appended later
+    Dataset(const char * datafile, const char * expertfile = NULL, const size_t num_labelled_items = 0);
+
+    // copies the sequences. provided_skill_labels has an entry for at least each item, or is empty if there are no expert labels
+    Dataset(const std::vector< std::vector<bool> > & recall_sequences, const std::vector< std::vector<size_t> > & item_sequences, const std::vector<size_t> & provided_skill_labels, const size_t num_items);
+
+    // the trials of new_trials appended to the dataset's, student by student. students and items beyond the dataset's are new, 
+    // and the dataset's expert labels have to cover them
+    Dataset(const Dataset & dataset, const Dataset & new_trials);
+
+    // recall_sequences[student][trial] = whether the student recalled the item on the trial
+    const std::vector< std::vector<bool> > & get_recall_sequences() const { return recall_sequences; }
+
+    // item_sequences[student][trial] = the item the student studied on the trial
+    const std::vector< std::vector<size_t> > & get_item_sequences() const { return item_sequences; }
+
+    // provided_skill_labels[item] = the expert-provided skill id. all 0 unless has_expert_labels
+    const std::vector<size_t> & get_provided_skill_labels() const { return provided_skill_labels; }
+
+    bool has_expert_labels() const { return expert_labels; }
+    size_t get_num_students() const { return recall_sequences.size(); }
+    size_t get_num_items() const { return num_items; }
+    size_t get_num_trials() const { return num_trials; }
+
+ protected:
+
+    void count_trials();
+
+    std::vector< std::vector<bool> > recall_sequences;
+    std::vector< std::vector<size_t> > item_sequences;
+    std::vector<size_t> provided_skill_labels;
+    bool expert_labels;
+    size_t num_items;
+    size_t num_trials;
+};
+
+#endif
@@ -0,0 +1,52 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <vector>
+#include <cstddef>
+
+// estimates the effective sample size of a single Markov chain's trace
+// uses Geyer's initial monotone sequence estimator of the integrated autocorrelation time
+double effective_sample_size(const std::vector<double> & trace);
+
+// returns the adjusted Rand index between two partitions of the same items
+// labels are arbitrary ids: only which items share a label matters
+double adjusted_rand_index(const std::vector<size_t> & labels_a, const std::vector<size_t> & labels_b);
+
+// returns the number of distinct labels in the partition
+size_t num_distinct_labels(const std::vector<size_t> & labels);
+
+// returns this process's peak resident set size in kilobytes
+size_t peak_resident_memory_kb();
+
+// returns this process's peak virtual memory size in kilobytes, or 0 if it can't be determined
+size_t peak_virtual_memory_kb();
+
+// returns this process's current resident set size in kilobytes, or 0 if it can't be determined
+size_t current_resident_memory_kb();
+
+#endif
@@ -0,0 +1,98 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef FIXED_SKILL_BKT_H
+#define FIXED_SKILL_BKT_H
+
+#include "common.hpp"
+#include "Dataset.hpp"
+#include "Random.hpp"
+
+#define STUDENT_LANES 4      // students whose trials of a skill are stepped together
+#define EM_MAX_STEPS 1000
+#define EM_TOL 1e-9          // fit_em stops once a step improves the log likelihood by less than this fraction of it
+
+// expected (FixedSkillBKT::em_step) or sampled (FixedSkillBKT::sample_step) counts of a skill's knowledge states
+struct bkt_counts {
+    double first_total, first_learned;         // students, and those who'd learned the skill by their first trial of it
+    double unlearned_steps, learned_next;      // transitions from the unlearned state, and how many of them learned the skill
+    double learned_total, learned_correct;     // trials in the learned state, and the correct ones among them
+    double unlearned_total, unlearned_correct; // and in the unlearned state
+};
+
+
+class FixedSkillBKT {
+
+ // BKT fit to a fixed assignment of items to skills, the model with beta = 1. each skill is a two state hidden Markov model of 
+ // the students' trials of its items, so its parameters can be fit by EM (Baum-Welch) on the expected counts forward-backward 
+ // gives, or sampled by drawing the knowledge states with forward filtering backward sampling and then the parameters given 
+ // them. both take a pass over the trials per step instead of the many whole-skill likelihoods of slice sampling.
+ //
+ // the skills are independent, so they're split across threads. within a skill, the students are sorted by their number of 
+ // trials of it and stepped STUDENT_LANES at a time, the shorter sequences padded with masked steps (see skill_blocks)
+ public:
+
+    // skill_labels[item] = the item's skill, 0 ... number of skills - 1. only the trials of train_students are fit
+    FixedSkillBKT(const Dataset & dataset, const std::vector<size_t> & skill_labels, const std::set<size_t> & train_students, const size_t num_threads);
+
+    size_t get_num_skills() const;
+
+    // one EM step on every skill's parameters (parameters[skill]), which maximizes the expected complete-data log likelihood 
+    // subject to the parameters' bounds and pi0 <= pi1. returns the training data log likelihood before the step
+    double em_step(std::vector<struct bkt_parameters> & parameters) const;
+
+    // em_step until the log likelihood improves by less than EM_TOL of itself, at most EM_MAX_STEPS times. returns the number of steps
+    size_t fit_em(std::vector<struct bkt_parameters> & parameters) const;
+
+    // one data augmentation step under the uniform prior of MixtureWCRP: every skill's knowledge states are drawn given its 
+    // parameters, then psi and mu from their Beta conditionals and pi1 and prop0 by slice sampling. each skill draws from its own 
+    // generator, seeded from this one, so the chain doesn't depend on the number of threads. returns the log likelihood before the step
+    double sample_step(Random * generator, std::vector<struct bkt_parameters> & parameters) const;
+
+    // the training data log likelihood
+    double log_likelihood(const std::vector<struct bkt_parameters> & parameters) const;
+
+ protected:
+
+    // the trials of a skill, block by block. block b has the steps block_ends[b-1] ... block_ends[b] (from 0 for b = 0), and
+    // recalls[step * STUDENT_LANES + lane] is whether the lane's student recalled its trial on that step. masks are 0 for the 
+    // steps past the end of a student's sequence, and for every step of a lane without a student
+    struct skill_blocks {
+        std::vector<size_t> block_ends;
+        std::vector<double> recalls, masks;
+    };
+
+    enum skill_update { UPDATE_EM, UPDATE_SAMPLE, UPDATE_NONE };
+
+    // updates the parameters of skills first_skill, first_skill + num_threads, ... of skill_order, and sets their log likelihoods
+    void update_skills(const size_t first_skill, const skill_update update, std::vector<struct bkt_parameters> & parameters, const std::vector<unsigned int> & seeds, std::vector<double> & skill_lls) const;
+    double run_update(const skill_update update, std::vector<struct bkt_parameters> & parameters, const std::vector<unsigned int> & seeds) const;
+
+    std::vector<skill_blocks> skills;
+    std::vector<size_t> skill_order; // the skills by number of steps, descending, so the threads' shares are balanced
+    size_t num_threads;
+};
+
+#endif
@@ -0,0 +1,101 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef KNOWLEDGE_STATES_H
+#define KNOWLEDGE_STATES_H
+
+#include <cstdio>
+#include <stdint.h>
+#include <vector>
+
+// each student's end-of-sequence knowledge state under every retained sample: the probability that the student has
+// learned each skill they practiced, as of their next trial, from the same forward update record_sample uses
+//
+// the file is a sparse, binary, native-endian layout meant to be memory mapped. all offsets are in bytes from the
+// start of the file, and everything is 8 byte aligned:
+//
+//   header: char magic[8] = "WCRPKS01", uint64 num_samples, uint64 index_offset
+//   per sample: uint64 num_students, uint64 num_entries, uint64 row_end[num_students], knowledge_state_entry entries[num_entries]
+//     student s's entries are entries[row_end[s-1] ... row_end[s]) (from 0 for s = 0), sorted by skill id
+//   index (at index_offset): uint64 sample_offset[num_samples]
+//
+// skill ids are the sample's, as in find_skills' samples and posterior file. skills a student never practiced
+// have no entry; their probability is the skill's psi
+
+struct knowledge_state_entry {
+    uint32_t skill;
+    float p_learned;
+};
+
+
+class KnowledgeStateWriter {
+
+ // writes samples as they're recorded. the index and header are written by the destructor
+ public:
+
+    KnowledgeStateWriter(const char * filename);
+
+    ~KnowledgeStateWriter();
+
+    // appends a sample. row_ends[student] = the end of the student's entries
+    void write_sample(const std::vector<uint64_t> & row_ends, const std::vector<knowledge_state_entry> & entries);
+
+ protected:
+
+    FILE * out;
+    std::vector<uint64_t> sample_offsets;
+    uint64_t offset;
+
+};
+
+
+class KnowledgeStateReader {
+
+ // reads a file written by KnowledgeStateWriter through a read-only memory mapping, without copying it
+ public:
+
+    KnowledgeStateReader(const char * filename);
+
+    ~KnowledgeStateReader();
+
+    size_t get_num_samples() const;
+    size_t get_num_students(const size_t sample) const;
+
+    // the student's entries in the sample, sorted by skill id. sets num_entries
+    const knowledge_state_entry * get_entries(const size_t sample, const size_t student, size_t & num_entries) const;
+
+    // the probability the student has learned the skill in the sample, or -1 if the student never practiced it
+    double get_p_learned(const size_t sample, const size_t student, const size_t skill) const;
+
+ protected:
+
+    const char * data;
+    size_t size;
+    size_t num_samples;
+    const uint64_t * sample_offsets;
+
+};
+
+#endif
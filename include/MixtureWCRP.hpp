@@ -28,27 +28,117 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "Random.hpp"
 #include "common.hpp"
+#include "PerfCounters.hpp"
+#include "Trace.hpp"
+#include "AllocationTracker.hpp"
+#include "StatusServer.hpp"
+#include "KnowledgeStates.hpp"
+#include "Dataset.hpp"
+#include "SampleSink.hpp"
+#include "FixedSkillBKT.hpp"
+#include "Coassignment.hpp"
+#include "ChainObserver.hpp"
 
 typedef double(*prior_log_density_fn) (const double x);
 
+// score_candidate_tables scores the tables with at most MAX_BATCHED_TABLE_SIZE items TABLE_LANES at a time, one table per
+// vector lane. larger tables have more trials per student, so lanes would idle waiting on them; they're scored one by one
+#define TABLE_LANES 4
+#define MAX_BATCHED_TABLE_SIZE 64
+
+// the WCRP seating probabilities, shared with code that works from saved samples instead of a running chain
+double log_old_table_probability(const size_t num_seated, const double K, const double log_gamma, const size_t num_expert_provided_skills);
+double log_new_table_probability(const double log_alpha_prime, const double log_gamma, const size_t num_expert_provided_skills);
+double compute_K(const boost::unordered_map<size_t, int> & counts, const int max_count, const size_t item_expert_label, const double gamma, const size_t num_expert_provided_skills);
+
+// the approximate Gibbs step (wcrp_config::approximate_top_k) summarizes each table's responses per bucket of students
+#define SKETCH_BUCKETS 64
+
+// an item's correct and total trials among the students in one bucket
+struct sketch_entry {
+    size_t bucket;
+    int correct;
+    int total;
+};
+
+// a table's correct and total trials per bucket of students, and the logs of the smoothed accuracy and error rate of each
+struct table_sketch {
+    int correct[SKETCH_BUCKETS];
+    int total[SKETCH_BUCKETS];
+    double log_accuracy[SKETCH_BUCKETS];
+    double log_error[SKETCH_BUCKETS];
+};
+
+// what resampling one item's skill assignment has cost, summed over every Gibbs step on the item
+struct item_cost {
+    size_t num_steps;
+    double seconds;
+    size_t tables_scored;     // extant tables scored (the auxiliary new tables are precomputed, so they're not counted)
+    size_t affected_students; // training students who studied the item
+    size_t trials_touched;    // trials read per step: each affected student's prefix by cache_p_hat plus its tail twice (with and without the item)
+};
+
+// how run_mcmc updates the BKT parameters when beta = 1, so the skills are the expert-provided ones
+enum bkt_fit_method {
+    BKT_SLICE_SAMPLING,     // slice sample each parameter given the responses, as with any other beta
+    BKT_EM,                 // maximum likelihood by EM (see FixedSkillBKT). every iteration's sample is the same fit
+    BKT_DATA_AUGMENTATION   // draw the students' knowledge states, then the parameters given them (see FixedSkillBKT)
+};
+
+// "slice", "em" or "augmentation", as the command line tools take it. exits with an error otherwise
+bkt_fit_method parse_bkt_fit_method(const string & name);
+
+// the settings a model is built with. the defaults are find_skills'
+struct wcrp_config {
+    double beta;                // the weight of the expert-provided skills: its starting value, or its value if run_mcmc doesn't infer it. 1 seats the items by them
+    double init_alpha_prime;    // the starting (or fixed) value of alpha'. negative draws it from its prior
+    size_t num_subsamples;      // number of auxiliary samples used to approximate the marginal likelihood of new skills
+    set<size_t> train_students; // the students the model is fit to, which may include ids append_trials adds later. empty means all of them
+    string checkpoint_file;     // if not empty, a file written by save_checkpoint whose chain the model continues. alpha' and beta then come from the file
+    size_t approximate_top_k;   // if not 0, the Gibbs step scores exactly only the k tables whose response sketches best match the item's (see approximate_gibbs_resample_skill)
+    bkt_fit_method bkt_fit;     // only used when beta = 1
+    size_t num_threads;         // threads the BKT_EM and BKT_DATA_AUGMENTATION updates split the skills across
+    double adaptive_scan_floor; // if not 0, the seating sweep draws items in proportion to how often they've recently moved, but at least this often (see resample_seating)
+
+    wcrp_config() : beta(.5), init_alpha_prime(-1), num_subsamples(2000), approximate_top_k(0), bkt_fit(BKT_SLICE_SAMPLING), num_threads(1), adaptive_scan_floor(0) {}
+};
+
 class MixtureWCRP {
 
   public:
 
-    MixtureWCRP(Random * generator,
-                 const set<size_t> & train_students,
-                 const vector< vector<bool> > & recall_sequences,
-                 const vector< vector<size_t> > & item_sequences,
-                 const vector<size_t> & provided_skill_assignments,
-                 const double gamma,
-                 const double init_alpha_prime,
-                 const size_t num_students,
-                 const size_t num_items,
-                 const size_t num_subsamples);
+    // the dataset isn't copied, so it has to outlive the model. neither is the generator, which mustn't be shared with a model on another thread
+    MixtureWCRP(Random * generator, const Dataset & dataset, const wcrp_config & config);
 
     ~MixtureWCRP();
 
-    void run_mcmc(const size_t num_iterations, const size_t burn, const bool infer_gamma, const bool infer_alpha_prime);
+    // returns the number of iterations run, fewer than num_iterations if an observer stopped the chain
+    size_t run_mcmc(const size_t num_iterations, const size_t burn, const bool infer_gamma, const bool infer_alpha_prime);
+
+    // makes run_mcmc record its samples into the sink instead of the model's in-memory one, whose getters below then have nothing 
+    // to return. the sink isn't owned by the model. NULL goes back to the in-memory sink
+    void set_sample_sink(SampleSink * sink);
+
+    // makes run_mcmc call the observer after every phase and iteration. the observer isn't owned by the model
+    void add_observer(ChainObserver * observer);
+
+    // where run_mcmc prints a line per iteration and the phase report (see enable_perf_counters), and append_trials a summary.
+    // NULL silences them
+    void set_progress_stream(ostream * out);
+
+    // the chain's current state, as it would be recorded (iteration and train_ll are left at 0)
+    void get_current_sample(chain_sample & sample) const;
+    size_t get_num_skills() const;
+    // the fraction of candidate tables the latest seating sweep didn't score exactly: the ones that provably couldn't be drawn 
+    // (see score_candidate_tables) and, with approximate_top_k, the ones outside the top k
+    double get_pruned_fraction() const;
+    // the fraction of the latest seating sweep's approximate Gibbs steps whose proposal was rejected
+    double get_rejection_rate() const;
+    double get_alpha_prime() const;
+    double get_beta() const;
+    const Dataset & get_dataset() const;
+
+    // the getters below return what the in-memory sink recorded
 
     // returns the expected posterior probability that the student responds correctly to the trial number
     double get_estimated_recall_prob(const size_t student, const size_t trial) const;
@@ -61,6 +151,53 @@ class MixtureWCRP {
     // the returned vector has one entry per item denoting the skill id
     vector<size_t> get_most_likely_skill_labels() const;
 
+    // returns the BKT parameters of each skill across all samples, indexed by the skill ids of get_sampled_skill_labels
+    vector< vector<struct bkt_parameters> > get_sampled_skill_parameters() const;
+
+    // returns the training data log likelihood of each sample, in the same order as get_sampled_skill_labels
+    vector<double> get_train_ll_samples() const;
+
+    // returns log(alpha') and log(gamma) (gamma = 1 - beta) of each sample, in the same order as get_sampled_skill_labels
+    void get_sampled_wcrp_hyperparameters(vector<double> & log_alpha_primes, vector<double> & log_gammas) const;
+
+    // makes run_mcmc print the wall-clock time and hardware event counts of each phase of every iteration
+    // the counts are reported as NA where perf_event_open isn't permitted or the event doesn't exist
+    void enable_perf_counters();
+
+    // makes run_mcmc print the number of heap allocations, frees and bytes allocated in each phase of every iteration. only
+    // programs linked with the allocation hooks can count them (see AllocationTracker.hpp); others get a warning
+    void enable_allocation_tracking();
+
+    // makes gibbs_resample_skill record the wall time and work of every step, per item
+    void enable_item_profile();
+
+    // prints the top_n items by total time spent resampling them
+    void print_item_profile(ostream & out, const size_t top_n) const;
+
+    // writes the profile of every item as CSV
+    void save_item_profile(const char * filename) const;
+
+    // makes record_sample write each student's end-of-sequence knowledge state for every skill they practiced to the file
+    // (see KnowledgeStates.hpp). the file is complete once the model is destroyed
+    void export_knowledge_states(const char * filename);
+
+    // makes record_sample count how many samples put each pair of items in the same skill (see CoassignmentCounts), and
+    // returns the counts, which the model owns. the samples recorded so far aren't counted
+    const CoassignmentCounts & enable_coassignment();
+
+    // makes run_mcmc publish its progress to the server after every iteration and act on its checkpoint and dump requests
+    // the server isn't owned by the model
+    void set_status_server(StatusServer * server, const string & run_name);
+
+    // writes the chain state: the WCRP hyperparameters, the seating arrangement and each table's BKT parameters
+    // passing the file in the config continues the chain; its alpha', beta and num_items then come from the file
+    void save_checkpoint(const char * filename) const;
+
+    // switches the model to a dataset that extends its current one with new trials (see Dataset's appending constructor),
+    // which has to outlive the model in its place. any new students and items have ids following the existing ones. only the 
+    // structures touched by the new trials are updated, and the samples recorded so far are discarded
+    void append_trials(const Dataset & extended_dataset);
+
 
   protected:
 
@@ -69,14 +206,59 @@ class MixtureWCRP {
     double data_log_likelihood(const size_t student, const size_t first_exposure, size_t & num_trials) const;
 
     bool studied_any_of(const size_t student, const vector<size_t> & items) const;
-    void record_sample(const double train_ll);
+    void record_sample(const size_t iteration, const double train_ll);
+
+    // fills the sample's skill labels and parameters, and maps each table id to its skill id
+    void update_coassignment();
+    void label_skills(chain_sample & sample, boost::unordered_map<size_t, int> & skill_labels) const;
+
+    // calls every observer's after_phase. returns false if any wants the chain stopped
+    bool notify_phase(const size_t iteration, const sampler_phase phase);
 
     double log_seating_prob() const;
 
+    // per-phase instrumentation for run_mcmc. these only do work when enable_perf_counters or enable_allocation_tracking was called or tracing is enabled
+    bool timing_phases() const;
+    void begin_phase();
+    void end_phase(const sampler_phase phase);
+    void print_phase_report(const size_t iter) const;
+    void update_item_work(const size_t item); // item_costs' affected_students and trials_touched
+    void fill_run_status(run_status & status, const size_t iteration, const size_t num_iterations, const size_t burn, const double elapsed_seconds, const vector<double> & recent_train_ll) const;
+    void dump_stats(const string & prefix, const run_status & status) const;
+
+    // one Gibbs step per item: every item in random order or, with adaptive_scan_floor, as many items drawn at random with
+    // probability proportional to max(move rate, adaptive_scan_floor). with adapt, each step updates its item's move rate. run_mcmc 
+    // adapts only during burn-in, so the scan probabilities are fixed while samples are recorded and every step leaves the posterior invariant
+    void resample_seating(const bool adapt);
+
     // resample the skill assignment (table) for this item (customer)
     // see algorithm 8 from http://www.stat.purdue.edu/~rdutta/24.PDF
     void gibbs_resample_skill(const size_t item);
 
+    // scores every extant table plus the auxiliary new tables for an unassigned item, as used by gibbs_resample_skill
+    // given tables, only those extant tables are scored, and none are pruned
+    void score_candidate_tables(const size_t item, vector<size_t> & keys, vector<double> & proportional_log_probs, const vector<size_t> * tables=NULL);
+
+    // a Metropolis-Hastings step that proposes from the Gibbs conditional restricted to the top approximate_top_k tables by 
+    // sketch_log_ratio, and from the sketches elsewhere
+    void approximate_gibbs_resample_skill(const size_t item);
+
+    // the exact score of one table for the unassigned item. score_candidate_tables must have just been called for the item
+    double exact_table_score(const size_t item, const size_t table_id);
+
+    // the approximate data log likelihood ratio of seating the item at the table: the item's responses under the accuracy
+    // of the table's other responses from the same buckets of students
+    double sketch_log_ratio(const size_t item, const size_t table_id) const;
+    void build_sketches();
+    void update_table_sketch(const size_t table_id, const size_t item, const int sign);
+
+    // an upper bound on the data log likelihood ratio of seating an item with these responses at a table with these parameters
+    static double table_log_ratio_bound(const struct bkt_parameters & params, const size_t num_correct, const size_t num_incorrect);
+
+    // the cached skill_log_likelihood of up to TABLE_LANES extant tables at once, with and without the unassigned item seated at
+    // each, written to lp_with_item[events[k]] and lp_without_item[events[k]] for table_ids[k]. the tables aren't modified
+    void score_table_batch(const size_t item, const size_t * table_ids, const size_t * events, const size_t num_tables, const vector< boost::unordered_map<size_t, double> > & init_p_hat, vector<double> & lp_with_item, vector<double> & lp_without_item);
+
     double slice_resample_bkt_parameter(const size_t skill_id, double * param, const vector<size_t> & students_to_include, const vector<size_t> & first_exposures, const double cur_ll);
     double slice_resample_wcrp_param(double * param, const double cur_seating_lp, const double lower_bound, const double upper_bound, const double init_bracket, prior_log_density_fn prior_lp);
 
@@ -86,20 +268,28 @@ class MixtureWCRP {
     double skill_log_likelihood(const size_t skill_id, const vector<size_t> & affected_students, const vector<size_t> & first_exposures, const vector< boost::unordered_map<size_t, double> > & init_p_hat) const;
     double skill_log_likelihood(const size_t skill_id, const vector<size_t> & affected_students, const vector<size_t> & first_exposures) const;
 
+    // dataset indexing, shared by the constructor and append_trials
+    void grow_dataset(const size_t new_num_students, const size_t new_num_items);
+    void index_trial(const size_t student, const size_t trial, const bool is_training); // trials must be indexed in order
+    void compute_singleton_skill_data_lp(const size_t item); // the item must be unassigned
+    void load_checkpoint(const char * filename);
+
     void draw_bkt_param_prior(struct bkt_parameters & params) const;
     double compute_K(const size_t item, const size_t table_id, const bool am_initializing) const;
+    bool is_plain_crp() const; // true when the expert labels can't affect the seating probabilities
+    void update_fixed_skill_parameters();
+    double old_table_seating_lp(const size_t item, const size_t table_id) const; // the item must be unassigned
     bool remove_item_from_table(const size_t item, const size_t table_id);
     void assign_item_to_table(const size_t item, const size_t table_id, const bool is_new_table);
 
     Random * generator;
 
     // constants
-    const set<size_t> & train_students;
-    const vector< vector<bool> > & recall_sequences;
-    const vector< vector<size_t> > & item_sequences;
-    const vector<size_t> & provided_skill_assignments;
-    const size_t num_students;
-    const size_t num_items;
+    const Dataset * dataset; // replaced by append_trials
+    const bool train_all_students;
+    set<size_t> train_students;
+    size_t num_students; // these two grow in append_trials
+    size_t num_items;
     const size_t num_subsamples;
     const bool use_expert_labels;
 
@@ -117,20 +307,79 @@ class MixtureWCRP {
     vector<struct bkt_parameters> prior_samples; // auxiliary variables for the non-conjugate gibbs sampler
     vector< vector<double> > singleton_skill_data_lp;
 
+    // scratch space for gibbs_resample_skill and score_candidate_tables, kept between calls so the sweep doesn't reallocate it
+    vector<size_t> gibbs_keys;
+    vector<double> gibbs_log_probs;
+    vector< boost::unordered_map<size_t, double> > p_hat_scratch;
+    vector<double> scratch_data_lp_with_item, scratch_data_lp_without_item, scratch_seating_lp;
+    vector<double> batch_recalls, batch_with_masks, batch_without_masks; // score_table_batch's steps, [step * TABLE_LANES + lane]
+    size_t max_batched_table_size; // MAX_BATCHED_TABLE_SIZE. 0 scores every table on its own
+    vector<double> table_score_bounds, table_remaining_bounds; // score_candidate_tables' bounds, and the log sum of them from each rank on
+    vector<size_t> table_score_order;
+    vector<bool> table_scored;
+    double prune_log_tolerance;  // tables are pruned once their bounds add up to less than this fraction of the rest (LOG_TOL). -INFINITY scores every table
+    size_t tables_considered;    // extant tables considered by score_candidate_tables, and how many of them it pruned, this sweep
+    size_t tables_pruned;
+
+    // the approximate Gibbs step's state (see approximate_gibbs_resample_skill)
+    const size_t approximate_top_k;
+    vector< vector<sketch_entry> > item_sketches;                   // item_sketches[item] = the nonempty buckets of the item's training trials
+    boost::unordered_map<size_t, struct table_sketch> table_sketches; // kept up to date by assign_item_to_table and remove_item_from_table
+    vector<double> sketch_lps;     // scratch: each extant table's approximate score
+    vector<size_t> sketch_order, exact_tables;
+    boost::unordered_map<size_t, double> sketch_proposal_lps;
+    size_t approximate_steps;      // this sweep's approximate Gibbs steps, and how many of their proposals were rejected
+    size_t approximate_rejections;
+
+    // the adaptive scan's state (see resample_seating)
+    const double adaptive_scan_floor;
+    vector<double> scan_move_rates; // scan_move_rates[item] = the exponentially weighted fraction of the item's Gibbs steps that changed the partition
+    vector<double> scan_cumulative; // scratch: the running sum of the items' scan weights
+    vector<size_t> scan_items;      // scratch: the sweep's items
+
+    // the BKT_EM and BKT_DATA_AUGMENTATION updates' state (see update_fixed_skill_parameters)
+    const bkt_fit_method bkt_fit;
+    const size_t num_threads;
+    FixedSkillBKT * fixed_skill_fitter;                  // built on first use, and again after append_trials
+    vector<size_t> fixed_skill_tables;                   // fixed_skill_tables[FixedSkillBKT skill] = its table id
+    vector<struct bkt_parameters> fixed_skill_parameters; // scratch, indexed like fixed_skill_tables
+
     // dataset helper variables
     vector< vector<bool> > ever_studied;				// ever_studied[student][item] = true if at any time the student studied the item (and is in the training set)
     vector<size_t> all_items;
     vector< vector<size_t> > students_who_studied;  	// students_who_studied[item] = list of TRAINING students who at any time studied the item
     vector< vector<size_t> > all_first_encounters;		// all_first_encounters[item]....
-    vector< vector<size_t> > first_encounter; 			// first_encounter[student][item] = trial index the student first studied the item. ='s -1 if they never did
+    vector< vector<size_t> > first_encounter; 			// first_encounter[student][item] = trial index the student first studied the item. ='s (size_t) -1 if they never did
     vector< vector< vector<size_t> > > trials_studied;  // trials_studied[student][item] = list of all trials where the student studied the item
     size_t num_expert_provided_skills;
     vector< vector<pair<size_t, bool> > > item_and_recall_sequences; // student, trial, (item, recall)
 
-    // these variables record the sampler state for later reporting
-    vector< vector< vector<double> > > pRT_samples; // pRT_samples[student][trial][sample number]
-    vector< vector<size_t> > skill_label_samples;   // skill_label_samples[sample number][item] = skill id  (note: skill ids are sample-specific)
-    vector<double> train_ll_samples; // train_ll[sample number] = the training data log likelihood of that sample
+    // where the sampler state is recorded for later reporting
+    InMemorySampleSink memory_sink;
+    SampleSink * sample_sink;                 // &memory_sink unless set_sample_sink was called
+    chain_sample recorded_sample;             // scratch space for record_sample
+    vector< vector<double> > sample_predictions; // sample_predictions[student][trial], filled by record_sample if the sink wants them
+    vector<ChainObserver *> observers;
+    ostream * progress_stream;
+
+    // per-phase instrumentation state (see enable_perf_counters and enable_allocation_tracking)
+    PerfCounters * perf_counters;
+    bool track_allocations;
+    double phase_begin_time;
+    perf_counts phase_begin_counts;
+    allocation_counts phase_begin_allocations;
+    double phase_seconds[NUM_SAMPLER_PHASES];   // phase_seconds[phase] = wall-clock seconds spent in the phase this iteration
+    perf_counts phase_counts[NUM_SAMPLER_PHASES];
+    allocation_counts phase_allocations[NUM_SAMPLER_PHASES];
+    vector<struct item_cost> item_costs; // item_costs[item], empty unless enable_item_profile was called
+    StatusServer * status_server;
+    string status_run_name;
+    KnowledgeStateWriter * knowledge_state_writer; // NULL unless export_knowledge_states was called
+    vector<uint64_t> knowledge_state_row_ends;      // one sample's knowledge states, reused across samples
+    vector<knowledge_state_entry> knowledge_state_entries;
+    CoassignmentCounts * coassignment;                  // NULL unless enable_coassignment was called
+    vector<size_t> coassignment_tables;                 // each item's table as of the last recorded sample
+    boost::unordered_map<size_t, vector<size_t> > coassignment_members, current_members; // the items at each table then, and now (scratch)
 
 };
 
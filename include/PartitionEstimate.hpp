@@ -0,0 +1,71 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef PARTITION_ESTIMATE_H
+#define PARTITION_ESTIMATE_H
+
+#include "common.hpp"
+#include "Coassignment.hpp"
+
+// the loss a point estimate of the skill partition is chosen to minimize in expectation over the posterior
+enum partition_loss {BINDER_LOSS, VI_LOSS};
+
+// "binder" or "vi"
+partition_loss parse_partition_loss(const std::string & name);
+
+
+class PartitionEstimator {
+
+ // summarizes the posterior over skill partitions with the single partition that minimizes an expected loss, using only the
+ // co-assignment probabilities. the binder loss counts the pairs of items the partitions disagree on; its expectation is exact.
+ // for the variation of information, the lower bound of Wade & Ghahramani (2018) is used, which needs only the pairwise 
+ // probabilities too. the search moves one item at a time, and an item only ever joins a skill holding an item it was sampled 
+ // with, so a sweep costs time linear in the number of pairs that were ever together
+ public:
+
+    PartitionEstimator(const CoassignmentCounts & counts);
+
+    // a partition no single item's move improves. the search starts from initial_labels, if given, and from every item on its
+    // own, and the better of the two is returned, labelled 0, 1, ... in the order the skills first appear
+    std::vector<size_t> minimize(const partition_loss loss, const std::vector<size_t> & initial_labels) const;
+
+    // the expected number of disagreeing pairs, or the lower bound on the expected variation of information (in bits)
+    double expected_loss(const partition_loss loss, const std::vector<size_t> & labels) const;
+
+ protected:
+
+    // improves labels, numbered below num_items, in place until no move helps or after max_sweeps
+    void local_search(const partition_loss loss, std::vector<size_t> & labels, const size_t max_sweeps) const;
+
+    // the items each item was ever together with, and how often, as compressed rows
+    std::vector<size_t> row_starts;
+    std::vector<size_t> neighbors;
+    std::vector<double> neighbor_probs;
+    std::vector<double> row_sums; // including the item itself
+    double total_prob;            // over the pairs, each counted once
+    size_t num_items;
+};
+
+#endif
@@ -0,0 +1,75 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <vector>
+#include <string>
+
+// the hardware events we count
+enum perf_event_kind { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_L1D_MISSES, PERF_LLC_MISSES, PERF_BRANCH_MISSES, NUM_PERF_EVENTS };
+
+extern const char * perf_event_names[NUM_PERF_EVENTS];
+
+// event counts over some span of execution. a count is negative if that event couldn't be measured
+struct perf_counts {
+    long long values[NUM_PERF_EVENTS];
+};
+
+
+class PerfCounters {
+
+ // counts hardware events for the calling thread, and the threads it starts later, using linux's perf_event_open. a
+ // thread's counts are only added once it exits, so a span that starts threads should join them before reading
+ // each event is opened separately so that a machine missing one event (virtual machines often lack cache events) still
+ // reports the others. if none can be opened (non-linux, perf_event_paranoid too strict, a container without the syscall),
+ // available() returns false and every count reads as -1
+ public:
+
+    PerfCounters();
+
+    ~PerfCounters();
+
+    // true if at least one event is being counted
+    bool available() const;
+
+    // the counts accumulated since construction. when the kernel time-shares the hardware counters among more events than
+    // it has, each count is scaled by the fraction of the time its event was actually counted
+    void read(perf_counts & counts) const;
+
+    // after - before, keeping unmeasured events negative
+    static perf_counts difference(const perf_counts & after, const perf_counts & before);
+
+    // a + b, keeping unmeasured events negative
+    static perf_counts sum(const perf_counts & a, const perf_counts & b);
+
+ protected:
+
+    int fds[NUM_PERF_EVENTS];
+
+};
+
+#endif
@@ -0,0 +1,105 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef POSTERIOR_H
+#define POSTERIOR_H
+
+#include "common.hpp"
+
+// one retained MCMC sample: a partition of the items into skills plus each skill's BKT parameters
+struct posterior_sample {
+    std::vector<size_t> skill_labels;                  // skill_labels[item] = skill id, 0 ... skill_parameters.size() - 1
+    std::vector<struct bkt_parameters> skill_parameters; // skill_parameters[skill id]
+    double log_alpha_prime;                            // the WCRP hyperparameters. NAN if the file predates them
+    double log_gamma;                                  // gamma = 1 - beta
+    double weight;                                     // the sample's share of posterior averages, relative to the other samples'. 1 unless the posterior was condensed
+};
+
+// writes the samples as text:
+//   wcrp_posterior <tab> 3
+//   num_items <tab> N
+//   num_samples <tab> S
+// then for each sample, a line "sample <tab> <number of skills> <tab> <log alpha'> <tab> <log gamma> <tab> <weight>", a line with the 
+// N skill labels and a line per skill with psi, mu, pi1, prop0. version 1 files lack the hyperparameters and version 2 files the weight
+void save_posterior(const char * filename, const std::vector<posterior_sample> & samples);
+
+// the two parts of save_posterior's output, for writers that add samples as they go. a num_samples_width left-pads the count 
+// with zeros so it can be rewritten in place
+void write_posterior_header(std::ostream & out, const size_t num_items, const size_t num_samples, const int num_samples_width = 0);
+void write_posterior_sample(std::ostream & out, const posterior_sample & sample);
+
+// reads a file written by save_posterior
+void load_posterior(const char * filename, std::vector<posterior_sample> & samples, size_t & num_items);
+
+// condenses the samples into a few weighted ones for serving. every sample is forward filtered over the validation students,
+// and kernel herding greedily picks samples (with replacement) so that the picks' average per-trial recall probabilities track
+// the full posterior's. a sample picked c times out of n gets weight c / n. picks are made until the condensed posterior's
+// validation cross-entropy is within the tolerance of the full posterior's or max_samples picks have been made, and the
+// return value says which. a progress stream gets a line per pick
+bool condense_posterior(const std::vector<posterior_sample> & samples, const size_t num_items, const std::vector< std::vector<bool> > & recall_sequences,
+                        const std::vector< std::vector<size_t> > & item_sequences, const size_t max_samples, const double tolerance,
+                        std::vector<posterior_sample> & condensed, double & full_cross_entropy, double & condensed_cross_entropy, std::ostream * progress = NULL);
+
+
+class PosteriorPredictor {
+
+ // posterior predictive recall probabilities for a student, given the trials seen so far
+ //
+ // a student's state is one BKT forward variable (probability the skill is learned) per sample and skill, stored
+ // flat in a vector. observing a trial updates one entry per sample and predicting reads one per sample, using
+ // the same updates as MixtureWCRP::record_sample, so both are O(number of samples)
+ public:
+
+    PosteriorPredictor(const std::vector<posterior_sample> & samples, const size_t num_items);
+
+    size_t get_num_items() const;
+    size_t get_num_samples() const;
+
+    // the state of a student with no trials
+    void init_state(std::vector<double> & state) const;
+
+    // returns the probability, averaged over samples by their weights, that the student responds correctly to the item
+    double predict(const std::vector<double> & state, const size_t item) const;
+
+    // sets probs[sample] to the probability under each sample
+    void predict_each(const std::vector<double> & state, const size_t item, double * probs) const;
+
+    // updates the state with the student's response to the item
+    void observe(std::vector<double> & state, const size_t item, const bool recalled) const;
+
+ protected:
+
+    size_t num_items;
+    size_t num_samples;
+    std::vector<double> weight;  // weight[sample], normalized to sum to 1
+    std::vector<size_t> slot;    // slot[sample * num_items + item] = index into the state and parameter arrays of the item's skill in that sample
+    std::vector<double> psi;     // indexed by slot
+    std::vector<double> mu;
+    std::vector<double> pi0;
+    std::vector<double> pi1;
+
+};
+
+#endif
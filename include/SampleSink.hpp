@@ -0,0 +1,151 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef SAMPLE_SINK_H
+#define SAMPLE_SINK_H
+
+#include "common.hpp"
+
+// one post burn-in sample of the chain. skill ids are the sample's own: 0, 1, ... in order of the items' first appearance
+struct chain_sample {
+    size_t iteration;                                    // as numbered by run_mcmc's progress output
+    double train_ll;                                     // training data log likelihood
+    double log_alpha_prime;
+    double log_gamma;                                    // gamma = 1 - beta
+    std::vector<size_t> skill_labels;                    // skill_labels[item] = skill id
+    std::vector<struct bkt_parameters> skill_parameters; // skill_parameters[skill id]
+};
+
+
+class SampleSink {
+
+ // where MixtureWCRP::run_mcmc puts its post burn-in samples (see MixtureWCRP::set_sample_sink)
+ public:
+
+    virtual ~SampleSink() {}
+
+    // true if add_sample needs the sample's predictions. running every student's trials through the sample is most of the 
+    // cost of recording it, and is skipped for sinks that don't
+    virtual bool wants_predictions() const = 0;
+
+    // predictions[student][trial] = the sample's probability that the student recalls the trial's item. empty unless wants_predictions
+    virtual void add_sample(const chain_sample & sample, const std::vector< std::vector<double> > & predictions) = 0;
+
+    // forgets the samples so far. the model calls it when its data changes
+    virtual void clear() = 0;
+};
+
+
+class InMemorySampleSink : public SampleSink {
+
+ // keeps every sample and every prediction. this is what a model records into unless it's given another sink
+ public:
+
+    bool wants_predictions() const { return true; }
+    void add_sample(const chain_sample & sample, const std::vector< std::vector<double> > & predictions);
+    void clear();
+
+    size_t get_num_samples() const { return train_ll_samples.size(); }
+
+    // returns the expected posterior probability that the student responds correctly to the trial number
+    double get_estimated_recall_prob(const size_t student, const size_t trial) const;
+
+    // see the MixtureWCRP getters of the same names
+    std::vector< std::vector<size_t> > get_sampled_skill_labels() const;
+    std::vector<size_t> get_most_likely_skill_labels() const;
+    std::vector< std::vector<struct bkt_parameters> > get_sampled_skill_parameters() const;
+    std::vector<double> get_train_ll_samples() const;
+    void get_sampled_wcrp_hyperparameters(std::vector<double> & log_alpha_primes, std::vector<double> & log_gammas) const;
+
+ protected:
+
+    std::vector< std::vector< std::vector<double> > > pRT_samples; // pRT_samples[student][trial][sample number]
+    std::vector< std::vector<size_t> > skill_label_samples;        // skill_label_samples[sample number][item] = skill id  (note: skill ids are sample-specific)
+    std::vector<double> train_ll_samples;                           // train_ll[sample number] = the training data log likelihood of that sample
+    std::vector< std::vector<struct bkt_parameters> > skill_parameter_samples; // skill_parameter_samples[sample number][skill id] = BKT parameters, using skill_label_samples' ids
+    std::vector<double> log_alpha_prime_samples, log_gamma_samples; // the WCRP hyperparameters of each sample
+};
+
+
+class StreamingSampleSink : public SampleSink {
+
+ // appends each sample to a posterior file (see Posterior.hpp) as it's recorded, so memory use doesn't grow with the number of samples. 
+ // the sample count in the header is rewritten after every sample, so the file can be loaded at any point of the run
+ public:
+
+    StreamingSampleSink(const char * filename);
+
+    bool wants_predictions() const { return false; }
+    void add_sample(const chain_sample & sample, const std::vector< std::vector<double> > & predictions);
+    void clear();
+
+    size_t get_num_samples() const { return num_samples; }
+
+ protected:
+
+    void write_header();
+
+    const std::string filename;
+    std::ofstream out;
+    size_t num_samples;
+    size_t num_items;
+};
+
+
+class SummarySampleSink : public SampleSink {
+
+ // keeps running summaries instead of the samples: the mean and variance of the training data log likelihood and of the number of 
+ // skills, the most likely sample, and, if asked to, the mean prediction of every trial. memory use doesn't grow with the number of samples
+ public:
+
+    SummarySampleSink(const bool keep_predictions);
+
+    bool wants_predictions() const { return keep_predictions; }
+    void add_sample(const chain_sample & sample, const std::vector< std::vector<double> > & predictions);
+    void clear();
+
+    size_t get_num_samples() const { return num_samples; }
+    double get_mean_train_ll() const { return mean_train_ll; }
+    double get_train_ll_variance() const;
+    double get_mean_num_skills() const { return mean_num_skills; }
+    double get_num_skills_variance() const;
+
+    // the sample with the highest training data log likelihood
+    const chain_sample & get_most_likely_sample() const;
+
+    // returns the expected posterior probability that the student responds correctly to the trial number. needs keep_predictions
+    double get_estimated_recall_prob(const size_t student, const size_t trial) const;
+
+ protected:
+
+    const bool keep_predictions;
+    size_t num_samples;
+    double mean_train_ll, train_ll_m2;     // Welford's running mean and sum of squared deviations
+    double mean_num_skills, num_skills_m2;
+    chain_sample most_likely_sample;
+    std::vector< std::vector<double> > prediction_sums; // prediction_sums[student][trial]
+};
+
+#endif
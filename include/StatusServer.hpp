@@ -0,0 +1,106 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef STATUS_SERVER_H
+#define STATUS_SERVER_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#include "common.hpp"
+
+// what a running sampler reports about itself
+struct run_status {
+    std::string run_name;           // e.g., "replication 0, fold 3"
+    size_t iteration;               // iterations completed
+    size_t num_iterations;
+    size_t burn;
+    double elapsed_seconds;         // since run_mcmc started
+    double phase_seconds[NUM_SAMPLER_PHASES]; // of the last completed iteration
+    size_t num_skills;
+    double beta;
+    double alpha_prime;
+    double pruned_fraction;         // of the candidate tables in the last seating sweep
+    std::vector<double> recent_train_ll; // training data log likelihoods of the last few iterations, oldest first
+};
+
+
+class StatusServer {
+
+ // answers queries about a running sampler on a Unix domain socket, from a background thread
+ //
+ // a client connects, writes one command line and reads back one line of JSON:
+ //   status               the latest published run_status, plus ETA and memory use
+ //   checkpoint [file]    asks the sampler to save its chain state at the end of the current iteration
+ //   dump [prefix]        asks the sampler to write its stats (status JSON, trace snapshot, item profile) at the end of the current iteration
+ // e.g., echo status | nc -U /tmp/wcrp.sock
+ //
+ // the sampler publishes with try_lock and skips the update if a reader holds the lock, so readers never stall sampling
+ public:
+
+    // checkpoint_file and dump_prefix are the defaults for requests that don't name a file
+    StatusServer(const std::string & socket_path, const std::string & checkpoint_file, const std::string & dump_prefix);
+
+    // stops the thread and removes the socket file
+    ~StatusServer();
+
+    // called by the sampler between iterations
+    void publish(const run_status & status);
+
+    // returns true (once) if a checkpoint was requested since the last call, and where to write it
+    bool take_checkpoint_request(std::string & filename);
+
+    // returns true (once) if a stats dump was requested since the last call, and the prefix of the files to write
+    bool take_dump_request(std::string & prefix);
+
+    // formats a status as JSON on one line
+    static std::string status_json(const run_status & status);
+
+ protected:
+
+    void serve();
+    std::string handle_command(const std::string & line);
+
+    const std::string socket_path;
+    const std::string default_checkpoint_file;
+    const std::string default_dump_prefix;
+    int listen_fd;
+    std::thread server_thread;
+    std::atomic<bool> stopping;
+
+    std::mutex status_lock; // guards latest_status and the request fields
+    run_status latest_status;
+    bool have_status;
+    bool checkpoint_requested;
+    std::string checkpoint_request_file;
+    bool dump_requested;
+    std::string dump_request_prefix;
+
+};
+
+#endif
@@ -0,0 +1,76 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+
+// optional Chrome trace event recording (load the output in chrome://tracing or https://ui.perfetto.dev)
+//
+// each thread appends complete ("X") events to its own fixed-size ring buffer, so the oldest events are
+// overwritten on long runs. the buffers are written out as Chrome trace JSON when the process exits and,
+// as a snapshot, whenever the process receives SIGUSR1. the signal handler only raises a flag; the snapshot
+// is written the next time the sampler calls trace_poll (once per iteration), since writing a file isn't
+// async-signal-safe
+//
+// while tracing is disabled, a TraceScope costs one branch
+
+// starts recording. events_per_thread is the capacity of each thread's ring buffer
+void trace_enable(const std::string & filename, const size_t events_per_thread);
+
+bool trace_enabled();
+
+// writes every thread's buffered events to the trace file, replacing what's there
+void trace_dump();
+
+// writes a snapshot if SIGUSR1 arrived since the last call
+void trace_poll();
+
+// records an event that started at begin_time and ended at end_time (both from get_wall_time)
+// name, category and arg_name must be string literals or otherwise outlive the process
+void trace_complete(const char * name, const char * category, const double begin_time, const double end_time, const char * arg_name = NULL, const long long arg = 0);
+
+
+class TraceScope {
+
+ // records an event spanning this object's lifetime
+ public:
+
+    TraceScope(const char * name, const char * category, const char * arg_name = NULL, const long long arg = 0);
+
+    ~TraceScope();
+
+ protected:
+
+    const char * name;
+    const char * category;
+    const char * arg_name;
+    const long long arg;
+    double begin_time; // negative if tracing was disabled at construction
+
+};
+
+#endif
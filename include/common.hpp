@@ -39,6 +39,7 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <map>
 #include <ctime>
 #include <string>
+#include <sys/time.h>
 
 #include <boost/program_options.hpp>
 #include <boost/algorithm/string.hpp>
@@ -54,6 +55,10 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define HYPER_AP1 1.0	// shape
 #define HYPER_AP2 100.0	// scale
 
+// the phases of one MCMC iteration, in the order run_mcmc executes them
+enum sampler_phase { PHASE_HYPERPARAMETERS, PHASE_BKT_PARAMETERS, PHASE_SEATING, PHASE_LIKELIHOOD, PHASE_RECORD, NUM_SAMPLER_PHASES };
+extern const char * sampler_phase_names[NUM_SAMPLER_PHASES];
+
 struct bkt_parameters {
     double mu;	// probability of transitioning from unlearned to learned state
     double psi;	// probability of starting in the learned state
@@ -72,5 +77,11 @@ void load_expert_labels(const char * filename, std::vector<size_t> & provided_sk
 // reads the K-fold cross validation assignments
 void load_splits(const char * filename, std::vector<std::vector<size_t> > & fold_nums, size_t & num_folds, const size_t num_students);
 
+// returns the current wall-clock time in seconds. unlike clock(), this includes time spent blocked or in other threads
+double get_wall_time();
+
+// writes a string as a JSON string literal, quotes included
+void write_json_string(std::ostream & out, const std::string & value);
+
 
 #endif
@@ -27,6 +27,7 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define CROSS_VALIDATION_CPP
 
 #include "common.hpp"
+#include "Dataset.hpp"
 #include "MixtureWCRP.hpp"
 
 using namespace std;
@@ -36,8 +37,8 @@ int main(int argc, char ** argv) {
 
     namespace po = boost::program_options;
 
-    string datafile, savefile, foldfile, expertfile;
-    int tmp_num_iterations, tmp_burn, tmp_num_subsamples;
+    string datafile, savefile, foldfile, expertfile, tracefile, status_socket, checkpoint_file, bkt_fit;
+    int tmp_num_iterations, tmp_burn, tmp_num_subsamples, tmp_trace_buffer_events, tmp_num_threads;
     double init_beta, init_alpha_prime;
     bool infer_beta, infer_alpha_prime;
 
@@ -54,6 +55,14 @@ int main(int argc, char ** argv) {
             ("fix_alpha_prime", po::value<double>(&init_alpha_prime), "(optional) fix alpha' at the provided value instead of letting the model try to estimate it")
             ("fix_beta", po::value<double>(&init_beta), "(optional) fix beta at the provided value instead of giving it the Bayesian treatment")
             ("num_subsamples", po::value<int>(&tmp_num_subsamples)->default_value(2000), "number of samples to use when approximating marginal likelihood of new tables")
+            ("bkt_fit", po::value<string>(&bkt_fit)->default_value("slice"), "(optional, with --fix_beta 1) how to fit the expert-provided skills' BKT parameters: slice (slice sampling), em (maximum likelihood, in seconds. every sample is the same fit) or augmentation (sampling the students' knowledge states along with the parameters)")
+            ("threads", po::value<int>(&tmp_num_threads)->default_value(1), "(optional) number of threads to split the skills across with --bkt_fit em or augmentation")
+            ("perf_counters", "(optional) report the wall-clock time and hardware counters (cycles, instructions, cache and branch misses) of each phase of every iteration")
+            ("track_allocations", "(optional) report the number of heap allocations, frees and bytes allocated in each phase of every iteration")
+            ("trace_file", po::value<string>(&tracefile), "(optional) record a Chrome trace of the sampler's activity to this file. it's written at exit and whenever the process receives SIGUSR1")
+            ("trace_buffer_events", po::value<int>(&tmp_trace_buffer_events)->default_value(1000000), "number of trace events kept per thread. older events are overwritten")
+            ("status_socket", po::value<string>(&status_socket), "(optional) answer status queries as JSON on this Unix domain socket. see the README")
+            ("checkpoint_file", po::value<string>(&checkpoint_file), "(optional) where checkpoints requested over the status socket are written. defaults to the savefile with .checkpoint appended")
     ;
 
     po::variables_map vm;
@@ -65,6 +74,17 @@ int main(int argc, char ** argv) {
         return EXIT_SUCCESS;
     }
 
+    if (!tracefile.empty()) {
+        assert(tmp_trace_buffer_events > 0);
+        trace_enable(tracefile, (size_t) tmp_trace_buffer_events);
+    }
+
+    StatusServer * status_server = NULL;
+    if (!status_socket.empty()) {
+        if (checkpoint_file.empty()) checkpoint_file = savefile + ".checkpoint";
+        status_server = new StatusServer(status_socket, checkpoint_file, savefile);
+    }
+
     if (vm.count("fix_alpha_prime")) {
         assert(init_alpha_prime >= 0);
         infer_alpha_prime = false;
@@ -93,18 +113,13 @@ int main(int argc, char ** argv) {
     assert(init_beta >= 0 && init_beta <= 1);
     assert(num_iterations >= 0);
     assert(num_iterations > burn);
+    assert(tmp_num_threads > 0);
 
-    // load the dataset
-    vector< vector<bool> > recall_sequences; // recall_sequences[student][trial # i]  = recall success or failure of the ith trial we have for the student
-    vector< vector<size_t> > item_sequences; // item_sequences[student][trial # i] = item corresponding to the ith trial we have for the student
-    size_t num_students, num_items, num_skills_dataset;
-    load_student_data(datafile.c_str(), recall_sequences, item_sequences, num_students, num_items, num_skills_dataset);
-    assert(num_students > 0 && num_items > 0);
-
-    // load the expert-provided skill labels if possible
-    vector<size_t> provided_skill_labels(num_items, 0);
-    if (!expertfile.empty()) load_expert_labels(expertfile.c_str(), provided_skill_labels, num_items);
-    else {
+    // load the dataset and the expert-provided skill labels if possible. every fold's model shares it
+    const Dataset dataset(datafile.c_str(), expertfile.empty() ? NULL : expertfile.c_str());
+    const vector< vector<bool> > & recall_sequences = dataset.get_recall_sequences();
+    const size_t num_students = dataset.get_num_students();
+    if (!dataset.has_expert_labels()) {
         // tell the model to ignore provided_skill_labels:
         init_beta = 0.0;
         infer_beta = false;
@@ -125,23 +140,36 @@ int main(int argc, char ** argv) {
             cout << "running replication " << replication << ", test fold " << test_fold << endl;
 
             // figure out which students are in the training set for this replication-fold
-            set<size_t> train_students;
+            wcrp_config config;
+            config.beta = init_beta;
+            config.init_alpha_prime = init_alpha_prime;
+            config.num_subsamples = num_subsamples;
+            config.bkt_fit = parse_bkt_fit_method(bkt_fit);
+            config.num_threads = (size_t) tmp_num_threads;
             for (size_t s = 0; s < num_students; s++) {
-                if (fold_nums.at(replication).at(s) != test_fold || num_folds<=1) train_students.insert(s);
+                if (fold_nums.at(replication).at(s) != test_fold || num_folds<=1) config.train_students.insert(s);
             }
-            assert(!train_students.empty());
+            assert(!config.train_students.empty());
+            const set<size_t> & train_students = config.train_students;
+
+            // create the model. only the mean prediction of each trial is needed, so the samples aren't kept
+            MixtureWCRP model(generator, dataset, config);
+            SummarySampleSink summary(true);
+            model.set_sample_sink(&summary);
 
-            // create the model
-            MixtureWCRP model(generator, train_students, recall_sequences, item_sequences, provided_skill_labels, init_beta, init_alpha_prime, num_students, num_items, num_subsamples);
+            if (vm.count("perf_counters")) model.enable_perf_counters();
+            if (vm.count("track_allocations")) model.enable_allocation_tracking();
+            if (status_server) model.set_status_server(status_server, "replication " + boost::lexical_cast<string>(replication) + ", fold " + boost::lexical_cast<string>(test_fold));
 
             // run the sampler
             model.run_mcmc(num_iterations, burn, infer_beta, infer_alpha_prime);
 
             // write the posterior expected recall probability for each student-trial to the output file
+            TraceScope save_scope("save_predictions", "io");
             for (size_t student = 0; student < num_students; student++) {
                 const bool was_heldout = !train_students.count(student);
                 for (size_t trial = 0; trial < recall_sequences.at(student).size(); trial++) {
-                    const double mean_prob = model.get_estimated_recall_prob(student, trial);
+                    const double mean_prob = summary.get_estimated_recall_prob(student, trial);
                     out_predictions << replication << "\t" << test_fold << "\t" << was_heldout << "\t" << recall_sequences.at(student).at(trial) << "\t" << mean_prob << endl;
                 }
             }
@@ -150,6 +178,7 @@ int main(int argc, char ** argv) {
         }
     }
 
+    delete status_server;
     delete generator;
     return EXIT_SUCCESS;
 }
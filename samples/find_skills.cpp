@@ -27,7 +27,10 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define FIND_SKILLS_CPP
 
 #include "common.hpp"
+#include "Dataset.hpp"
 #include "MixtureWCRP.hpp"
+#include "Posterior.hpp"
+#include "PartitionEstimate.hpp"
 
 using namespace std;
 
@@ -36,9 +39,9 @@ int main(int argc, char ** argv) {
 
     namespace po = boost::program_options;
 
-    string datafile, savefile, expertfile;
-    int tmp_num_iterations, tmp_burn, tmp_num_subsamples;
-    double init_beta, init_alpha_prime;
+    string datafile, savefile, expertfile, tracefile, status_socket, checkpoint_file, posteriorfile, item_profile_file, resume_file, append_datafile, knowledge_state_file, bkt_fit, coassignment_file, point_estimate;
+    int tmp_num_iterations, tmp_burn, tmp_num_subsamples, tmp_trace_buffer_events, tmp_item_profile_top, tmp_approximate_top_k, tmp_num_threads;
+    double init_beta, init_alpha_prime, adaptive_scan_floor;
     bool infer_beta, infer_alpha_prime, map_estimate;
 
     // parse the command line arguments
@@ -49,11 +52,29 @@ int main(int argc, char ** argv) {
         ("savefile", po::value<string>(&savefile), "(required) file to put the skill labels")
         ("expertfile", po::value<string>(&expertfile), "(optional) file containing the expert-provided skill labels")
         ("map_estimate", "(optional) save the MAP skill labels instead of all sampled skill labels")
+        ("point_estimate", po::value<string>(&point_estimate), "(optional) save the skill labels that minimize the posterior expected loss instead of all sampled skill labels. binder or vi")
+        ("posterior_file", po::value<string>(&posteriorfile), "(optional) file to put every sample's skill labels and BKT parameters, for wcrp_serve and wcrp_predict")
+        ("knowledge_state_file", po::value<string>(&knowledge_state_file), "(optional) binary file to put every student's end-of-sequence probability of having learned each skill they practiced, for every sample. see KnowledgeStates.hpp")
+        ("coassignment_file", po::value<string>(&coassignment_file), "(optional) file to put the fraction of samples that put each pair of items in the same skill, for the pairs that ever were")
         ("iterations", po::value<int>(&tmp_num_iterations)->default_value(1000), "(optional but highly recommended) number of iterations to run. if you're not sure how to set it, use a large value")
         ("burn", po::value<int>(&tmp_burn)->default_value(500), "(optional but highly recommended) number of iterations to discard. if you're not sure how to set it, use a large value (less than iterations)")
         ("fix_alpha_prime", po::value<double>(&init_alpha_prime), "(optional) fix alpha' at the provided value instead of letting the model try to estimate it")
         ("fix_beta", po::value<double>(&init_beta), "(optional) fix beta at the provided value instead of giving it the Bayesian treatment")
         ("num_subsamples", po::value<int>(&tmp_num_subsamples)->default_value(2000), "number of auxiliary samples to use when approximating the marginal likelihood of new skills")
+        ("bkt_fit", po::value<string>(&bkt_fit)->default_value("slice"), "(optional, with --fix_beta 1) how to fit the expert-provided skills' BKT parameters: slice (slice sampling), em (maximum likelihood, in seconds. every sample is the same fit) or augmentation (sampling the students' knowledge states along with the parameters)")
+        ("threads", po::value<int>(&tmp_num_threads)->default_value(1), "(optional) number of threads to split the skills across with --bkt_fit em or augmentation")
+        ("adaptive_scan", po::value<double>(&adaptive_scan_floor)->default_value(0), "(optional) instead of resampling every item's skill each iteration, resample items drawn in proportion to how often they moved during burn-in, but at least this often (e.g., .05). 0 visits every item")
+        ("approximate_top_k", po::value<int>(&tmp_approximate_top_k)->default_value(0), "(optional) for datasets with thousands of skills: only score the k skills whose students' responses best match each item's exactly, and correct for the rest with a Metropolis-Hastings step. 0 scores every skill")
+        ("perf_counters", "(optional) report the wall-clock time and hardware counters (cycles, instructions, cache and branch misses) of each phase of every iteration")
+        ("track_allocations", "(optional) report the number of heap allocations, frees and bytes allocated in each phase of every iteration")
+        ("trace_file", po::value<string>(&tracefile), "(optional) record a Chrome trace of the sampler's activity to this file. it's written at exit and whenever the process receives SIGUSR1")
+        ("trace_buffer_events", po::value<int>(&tmp_trace_buffer_events)->default_value(1000000), "number of trace events kept per thread. older events are overwritten")
+        ("status_socket", po::value<string>(&status_socket), "(optional) answer status queries as JSON on this Unix domain socket. see the README")
+        ("checkpoint_file", po::value<string>(&checkpoint_file), "(optional) where the chain state is saved after sampling and when requested over the status socket. for the latter, defaults to the savefile with .checkpoint appended")
+        ("resume_checkpoint", po::value<string>(&resume_file), "(optional) continue the chain saved in this checkpoint instead of starting from the expert labels. the datafile must be the data the chain was run on")
+        ("append_datafile", po::value<string>(&append_datafile), "(optional, needs resume_checkpoint) file with new trials, in the datafile's format, to add to the data before sampling. the trials of existing students follow their earlier ones")
+        ("item_profile", po::value<int>(&tmp_item_profile_top), "(optional) after sampling, print this many of the items that were most expensive to resample, with the work each Gibbs step on them did")
+        ("item_profile_file", po::value<string>(&item_profile_file), "(optional) file to put the per-item Gibbs step costs of every item, as CSV")
     ;
 
     po::variables_map vm;
@@ -65,7 +86,23 @@ int main(int argc, char ** argv) {
         return EXIT_SUCCESS;
     }
 
+    if (!tracefile.empty()) {
+        assert(tmp_trace_buffer_events > 0);
+        trace_enable(tracefile, (size_t) tmp_trace_buffer_events);
+    }
+
+    StatusServer * status_server = NULL;
+    if (!status_socket.empty()) {
+        if (checkpoint_file.empty()) checkpoint_file = savefile + ".checkpoint";
+        status_server = new StatusServer(status_socket, checkpoint_file, savefile);
+    }
+
     map_estimate = vm.count("map_estimate");
+    if (map_estimate && !point_estimate.empty()) {
+        cerr << "choose one of --map_estimate and --point_estimate" << endl;
+        exit(EXIT_FAILURE);
+    }
+    const partition_loss loss = point_estimate.empty() ? BINDER_LOSS : parse_partition_loss(point_estimate);
 
     if (vm.count("fix_alpha_prime")) {
         assert(init_alpha_prime >= 0);
@@ -95,56 +132,122 @@ int main(int argc, char ** argv) {
     assert(num_iterations >= 0);
     assert(num_iterations > burn);
 
-    // load the dataset
-    vector< vector<bool> > recall_sequences; // recall_sequences[student][trial # i]  = recall success or failure of the ith trial we have for the student
-    vector< vector<size_t> > item_sequences; // item_sequences[student][trial # i] = item corresponding to the ith trial we have for the student
-    size_t num_students, num_items, num_skills_dataset;
-    load_student_data(datafile.c_str(), recall_sequences, item_sequences, num_students, num_items, num_skills_dataset);
-    assert(num_students > 0 && num_items > 0);
+    // load the trials to add to the resumed chain. students and items beyond the datafile's are new
+    Dataset * new_trials = NULL;
+    if (!append_datafile.empty()) {
+        assert(!resume_file.empty());
+        new_trials = new Dataset(append_datafile.c_str());
+    }
 
-    // load the expert-provided skill labels if possible
-    vector<size_t> provided_skill_labels(num_items, 0);
-    if (!expertfile.empty()) load_expert_labels(expertfile.c_str(), provided_skill_labels, num_items);
-    else {
+    // load the dataset and the expert-provided skill labels if possible. the labels cover any new items too
+    const size_t num_labelled_items = new_trials ? new_trials->get_num_items() : 0;
+    const Dataset dataset(datafile.c_str(), expertfile.empty() ? NULL : expertfile.c_str(), num_labelled_items);
+    if (!dataset.has_expert_labels()) {
         // tell the model to ignore provided_skill_labels:
         init_beta = 0.0;
         infer_beta = false;
     }
 
-    // we'll let the model use all the students as training data:
-    set<size_t> train_students;
-    for (size_t s = 0; s < num_students; s++) train_students.insert(s);
+    // we'll let the model use all the students as training data
+    wcrp_config config;
+    config.beta = init_beta;
+    config.init_alpha_prime = init_alpha_prime;
+    config.num_subsamples = num_subsamples;
+    config.checkpoint_file = resume_file;
+    assert(tmp_approximate_top_k >= 0);
+    config.approximate_top_k = (size_t) tmp_approximate_top_k;
+    assert(adaptive_scan_floor >= 0 && adaptive_scan_floor <= 1);
+    config.adaptive_scan_floor = adaptive_scan_floor;
+    assert(tmp_num_threads > 0);
+    config.bkt_fit = parse_bkt_fit_method(bkt_fit);
+    config.num_threads = (size_t) tmp_num_threads;
+
+    const Dataset * extended_dataset = NULL;
+    { // the model points to the generator, the status server and the extended dataset, so it has to be destroyed before they're deleted
+        // create the model
+        MixtureWCRP model(generator, dataset, config);
+
+        if (new_trials) {
+            extended_dataset = new Dataset(dataset, *new_trials);
+            delete new_trials;
+            model.append_trials(*extended_dataset);
+        }
+        const size_t num_items = extended_dataset ? extended_dataset->get_num_items() : dataset.get_num_items();
 
-    // create the model
-    MixtureWCRP model(generator, train_students, recall_sequences, item_sequences, provided_skill_labels, init_beta, init_alpha_prime, num_students, num_items, num_subsamples);
+        if (vm.count("perf_counters")) model.enable_perf_counters();
+        if (vm.count("track_allocations")) model.enable_allocation_tracking();
+        if (vm.count("item_profile") || !item_profile_file.empty()) model.enable_item_profile();
+        if (status_server) model.set_status_server(status_server, "find_skills");
+        if (!knowledge_state_file.empty()) model.export_knowledge_states(knowledge_state_file.c_str());
+        const CoassignmentCounts * coassignment = coassignment_file.empty() && point_estimate.empty() ? NULL : &model.enable_coassignment();
 
-    // run the sampler
-    model.run_mcmc(num_iterations, burn, infer_beta, infer_alpha_prime);
+        // run the sampler
+        model.run_mcmc(num_iterations, burn, infer_beta, infer_alpha_prime);
 
-    ofstream out_skills(savefile.c_str(), ofstream::out);
-    if (map_estimate) { // save the most likely skill label
-        vector<size_t> map_estimate = model.get_most_likely_skill_labels();
-        assert(map_estimate.size() == num_items);
-        for (size_t item = 0; item < num_items; item++) {
-            out_skills << map_estimate.at(item);
-            if (item == num_items - 1) out_skills << endl;
-            else out_skills << " ";
+        if (vm.count("item_profile")) {
+            assert(tmp_item_profile_top > 0);
+            model.print_item_profile(cout, (size_t) tmp_item_profile_top);
         }
-    }
-    else { // save all sampled skill labels
-        vector< vector<size_t> > skill_samples = model.get_sampled_skill_labels();
-        assert(!skill_samples.empty());
-        for (size_t sample = 0; sample < skill_samples.size(); sample++) {
-            assert(skill_samples.at(sample).size() == num_items);
+        if (!item_profile_file.empty()) model.save_item_profile(item_profile_file.c_str());
+        if (vm.count("checkpoint_file")) model.save_checkpoint(checkpoint_file.c_str());
+        if (!coassignment_file.empty()) coassignment->save(coassignment_file.c_str());
+
+        TraceScope save_scope("save_skill_labels", "io");
+        ofstream out_skills(savefile.c_str(), ofstream::out);
+        if (map_estimate) { // save the most likely skill label
+            vector<size_t> map_estimate = model.get_most_likely_skill_labels();
+            assert(map_estimate.size() == num_items);
             for (size_t item = 0; item < num_items; item++) {
-                out_skills << skill_samples.at(sample).at(item);
+                out_skills << map_estimate.at(item);
                 if (item == num_items - 1) out_skills << endl;
                 else out_skills << " ";
             }
         }
+        else if (!point_estimate.empty()) { // save the partition with the least expected loss, searching from the most likely sample
+            const PartitionEstimator estimator(*coassignment);
+            const vector<size_t> most_likely = model.get_most_likely_skill_labels();
+            const vector<size_t> labels = estimator.minimize(loss, most_likely);
+            assert(labels.size() == num_items);
+            cout << "expected " << point_estimate << " loss " << estimator.expected_loss(loss, labels) << " (most likely sample: " << estimator.expected_loss(loss, most_likely) << ")" << endl;
+            for (size_t item = 0; item < num_items; item++) {
+                out_skills << labels.at(item);
+                if (item == num_items - 1) out_skills << endl;
+                else out_skills << " ";
+            }
+        }
+        else { // save all sampled skill labels
+            vector< vector<size_t> > skill_samples = model.get_sampled_skill_labels();
+            assert(!skill_samples.empty());
+            for (size_t sample = 0; sample < skill_samples.size(); sample++) {
+                assert(skill_samples.at(sample).size() == num_items);
+                for (size_t item = 0; item < num_items; item++) {
+                    out_skills << skill_samples.at(sample).at(item);
+                    if (item == num_items - 1) out_skills << endl;
+                    else out_skills << " ";
+                }
+            }
+        }
+
+        if (!posteriorfile.empty()) {
+            const vector< vector<size_t> > skill_samples = model.get_sampled_skill_labels();
+            const vector< vector<struct bkt_parameters> > parameter_samples = model.get_sampled_skill_parameters();
+            vector<double> log_alpha_primes, log_gammas;
+            model.get_sampled_wcrp_hyperparameters(log_alpha_primes, log_gammas);
+            vector<posterior_sample> samples(skill_samples.size());
+            for (size_t sample = 0; sample < samples.size(); sample++) {
+                samples[sample].skill_labels = skill_samples[sample];
+                samples[sample].skill_parameters = parameter_samples[sample];
+                samples[sample].log_alpha_prime = log_alpha_primes[sample];
+                samples[sample].log_gamma = log_gammas[sample];
+                samples[sample].weight = 1.0;
+            }
+            save_posterior(posteriorfile.c_str(), samples);
+        }
     }
 
+    delete status_server;
     delete generator;
+    delete extended_dataset;
     return EXIT_SUCCESS;
 }
 
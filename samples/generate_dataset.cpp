@@ -0,0 +1,329 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef GENERATE_DATASET_CPP
+#define GENERATE_DATASET_CPP
+
+#include <cstdio>
+#include "common.hpp"
+#include "Random.hpp"
+#include "MixtureWCRP.hpp"
+
+using namespace std;
+
+// simulates a dataset from the generative model: a skill partition drawn from the WCRP prior, BKT parameters
+// drawn per skill, and students practicing random items. it writes the same files the other executables read
+
+
+// returns an integer uniformly sampled on [0, n)
+// (Random::sampleUniformDiscrete builds a lookup table per n, which is wasteful for the many different n used here)
+inline size_t sample_index(Random & generator, const size_t n) {
+    return min(n - 1, (size_t) (n * generator.sampleUniform01()));
+}
+
+
+// draws a skill label for every item from the WCRP prior (equations 1 and 2 in the NIPS paper)
+// with beta = 0 this is a plain Chinese restaurant process. as beta approaches 1 the partition approaches the expert labels
+void sample_wcrp_partition(Random & generator, const vector<size_t> & expert_labels, const double beta, const double alpha_prime, vector<size_t> & skill_labels) {
+
+    const size_t num_items = expert_labels.size();
+    const size_t num_expert_skills = 1 + *max_element(expert_labels.begin(), expert_labels.end());
+    const double gamma = 1.0 - beta, log_gamma = log(gamma);
+
+    vector<size_t> table_sizes;
+    vector< boost::unordered_map<size_t, int> > label_counts; // label_counts[table][expert label] = # items at the table with that label
+    vector<int> max_counts;
+    skill_labels.resize(num_items);
+
+    for (size_t item = 0; item < num_items; item++) {
+        const size_t item_label = expert_labels.at(item);
+        vector<double> log_probs;
+        log_probs.reserve(table_sizes.size() + 1);
+
+        for (size_t table = 0; table < table_sizes.size(); table++) {
+            const double K = compute_K(label_counts.at(table), max_counts.at(table), item_label, gamma, num_expert_skills);
+            log_probs.push_back(log_old_table_probability(table_sizes.at(table), K, log_gamma, num_expert_skills));
+        }
+        // unlike the sampler, a new table keeps a little probability at beta = 1 so the draw never fails
+        log_probs.push_back(log_new_table_probability(log(alpha_prime), log(max(gamma, TOL)), num_expert_skills));
+
+        const size_t table = generator.sampleUnnormalizedDiscrete(log_probs);
+        if (table == table_sizes.size()) {
+            table_sizes.push_back(0);
+            label_counts.push_back(boost::unordered_map<size_t, int>());
+            max_counts.push_back(0);
+        }
+        table_sizes[table]++;
+        max_counts[table] = max(max_counts.at(table), ++label_counts[table][item_label]);
+        skill_labels[item] = table;
+    }
+}
+
+
+// draws one skill's BKT parameters. the priors are loose but favor realistic values: students usually start unlearned,
+// learn slowly, rarely slip, and guess correctly less often than they respond correctly once the skill is learned
+void sample_bkt_parameters(Random & generator, struct bkt_parameters & params) {
+    params.psi = generator.sampleBeta(2.0, 5.0);
+    params.mu = generator.sampleBeta(2.0, 10.0);
+    params.pi1 = generator.sampleBeta(10.0, 2.0);
+    params.prop0 = generator.sampleBeta(2.0, 2.0);
+}
+
+
+// returns a copy of the labels with each entry replaced by a uniformly drawn label with probability noise
+vector<size_t> perturb_labels(Random & generator, const vector<size_t> & labels, const double noise) {
+    const size_t num_labels = 1 + *max_element(labels.begin(), labels.end());
+    vector<size_t> noisy_labels(labels);
+    for (size_t item = 0; item < labels.size(); item++) {
+        if (generator.sampleUniform01() < noise) noisy_labels[item] = sample_index(generator, num_labels);
+    }
+    return noisy_labels;
+}
+
+
+// draws the number of trials for one student
+size_t sample_sequence_length(Random & generator, const string & distribution, const double mean_length, const size_t min_length, const size_t max_length) {
+    size_t length;
+    if (distribution == "fixed") length = (size_t) mean_length;
+    else if (distribution == "geometric") length = generator.sampleGeometric(1.0 / max(1.0, mean_length));
+    else if (distribution == "uniform") length = min_length + sample_index(generator, max_length - min_length + 1);
+    else {
+        cerr << "unknown sequence length distribution " << distribution << endl;
+        exit(EXIT_FAILURE);
+    }
+    return max(min_length, min(max_length, length));
+}
+
+
+// buffered writer for the dataset file. formatting integers by hand is several times faster than ostream for billions of rows
+class TrialWriter {
+
+  public:
+
+    TrialWriter(const string & filename) {
+        out = fopen(filename.c_str(), "w");
+        if (out == NULL) {
+            cerr << "couldn't open " << filename << endl;
+            exit(EXIT_FAILURE);
+        }
+        buffer.resize(1 << 22);
+        used = 0;
+    }
+
+    ~TrialWriter() {
+        flush();
+        fclose(out);
+    }
+
+    void write(const size_t student, const size_t item, const bool recall) {
+        if (used + 64 > buffer.size()) flush();
+        append(student);
+        buffer[used++] = ' ';
+        append(item);
+        buffer[used++] = ' ';
+        buffer[used++] = recall ? '1' : '0';
+        buffer[used++] = '\n';
+    }
+
+  protected:
+
+    void append(size_t value) {
+        char digits[24];
+        size_t n = 0;
+        do {
+            digits[n++] = '0' + (value % 10);
+            value /= 10;
+        } while (value > 0);
+        while (n > 0) buffer[used++] = digits[--n];
+    }
+
+    void flush() {
+        if (used > 0 && fwrite(&buffer[0], 1, used, out) != used) {
+            cerr << "error writing the dataset" << endl;
+            exit(EXIT_FAILURE);
+        }
+        used = 0;
+    }
+
+    FILE * out;
+    vector<char> buffer;
+    size_t used;
+};
+
+
+// writes one label per item, either one per line (expert label format) or space-delimited on one line (skill label format)
+void write_labels(ostream & out, const vector<size_t> & labels, const bool one_per_line) {
+    for (size_t item = 0; item < labels.size(); item++) {
+        out << labels.at(item);
+        if (one_per_line || item == labels.size() - 1) out << endl;
+        else out << " ";
+    }
+}
+
+
+void write_labels(const string & filename, const vector<size_t> & labels, const bool one_per_line) {
+    ofstream out(filename.c_str(), ofstream::out);
+    if (!out.is_open()) {
+        cerr << "couldn't open " << filename << endl;
+        exit(EXIT_FAILURE);
+    }
+    write_labels(out, labels, one_per_line);
+}
+
+
+int main(int argc, char ** argv) {
+
+    namespace po = boost::program_options;
+
+    string outprefix, expertfile, length_distribution;
+    size_t num_students, num_items, min_length, max_length, items_per_student, num_folds, num_replications;
+    double beta, alpha_prime, mean_length, label_noise;
+    unsigned int seed;
+
+    // parse the command line arguments
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "print help message")
+        ("outprefix", po::value<string>(&outprefix), "(required) prefix of the files to write: _dataset.txt, _expert_labels.txt, _splits.txt, _true_skills.txt, _true_parameters.txt")
+        ("num_students", po::value<size_t>(&num_students)->default_value(1000), "number of students (one practice sequence each)")
+        ("num_items", po::value<size_t>(&num_items)->default_value(200), "number of items. ignored if --expertfile is given")
+        ("expertfile", po::value<string>(&expertfile), "(optional) expert-provided skill labels the true partition should be drawn near. use with --beta")
+        ("beta", po::value<double>(&beta)->default_value(0.0), "WCRP beta. how strongly the true partition is pulled toward the expert labels")
+        ("alpha_prime", po::value<double>(&alpha_prime)->default_value(5.0), "WCRP concentration alpha'")
+        ("label_noise", po::value<double>(&label_noise)->default_value(.1), "when generating expert labels, the fraction of items whose expert label is replaced at random")
+        ("length_distribution", po::value<string>(&length_distribution)->default_value("geometric"), "distribution of trials per student: fixed, geometric or uniform")
+        ("mean_length", po::value<double>(&mean_length)->default_value(100), "mean trials per student for fixed and geometric lengths")
+        ("min_length", po::value<size_t>(&min_length)->default_value(1), "minimum trials per student")
+        ("max_length", po::value<size_t>(&max_length)->default_value(100000), "maximum trials per student")
+        ("items_per_student", po::value<size_t>(&items_per_student)->default_value(0), "sparsity: number of distinct items each student practices, drawn at random. 0 means all items")
+        ("num_folds", po::value<size_t>(&num_folds)->default_value(5), "number of cross validation folds in the split file")
+        ("num_replications", po::value<size_t>(&num_replications)->default_value(1), "number of rows in the split file")
+        ("seed", po::value<unsigned int>(&seed)->default_value(1), "random seed")
+    ;
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (argc == 1 || vm.count("help") || outprefix.empty()) {
+        cout << desc << endl;
+        return EXIT_SUCCESS;
+    }
+
+    assert(num_students > 0 && num_folds > 0);
+    assert(beta >= 0 && beta <= 1 && alpha_prime > 0);
+    assert(min_length <= max_length);
+
+    Random generator(seed);
+    const double begin = get_wall_time();
+
+    // expert labels: either provided or a noisy copy of the true partition (generated below)
+    vector<size_t> expert_labels;
+    if (!expertfile.empty()) {
+        ifstream in(expertfile.c_str());
+        if (!in.is_open()) {
+            cerr << "couldn't open " << expertfile << endl;
+            exit(EXIT_FAILURE);
+        }
+        size_t label;
+        while (in >> label) expert_labels.push_back(label);
+        num_items = expert_labels.size();
+    }
+    assert(num_items > 0);
+    if (items_per_student == 0 || items_per_student > num_items) items_per_student = num_items;
+
+    // draw the true skill partition
+    vector<size_t> true_skills;
+    if (!expert_labels.empty()) sample_wcrp_partition(generator, expert_labels, beta, alpha_prime, true_skills);
+    else {
+        sample_wcrp_partition(generator, vector<size_t>(num_items, 0), 0.0, alpha_prime, true_skills);
+        expert_labels = perturb_labels(generator, true_skills, label_noise);
+    }
+    const size_t num_skills = 1 + *max_element(true_skills.begin(), true_skills.end());
+
+    // draw each skill's BKT parameters
+    vector<struct bkt_parameters> skill_params(num_skills);
+    for (size_t skill = 0; skill < num_skills; skill++) sample_bkt_parameters(generator, skill_params[skill]);
+
+    // simulate the students
+    TrialWriter * writer = new TrialWriter(outprefix + "_dataset.txt");
+    vector<size_t> all_items(num_items);
+    for (size_t item = 0; item < num_items; item++) all_items[item] = item;
+    vector<signed char> knows_skill(num_skills, -1); // -1 = not yet encountered by this student
+    vector<size_t> skills_touched;
+    size_t num_trials = 0;
+
+    for (size_t student = 0; student < num_students; student++) {
+
+        // choose the items this student practices (a partial fisher-yates shuffle)
+        for (size_t i = 0; i < items_per_student; i++) swap(all_items[i], all_items[i + sample_index(generator, num_items - i)]);
+
+        const size_t length = sample_sequence_length(generator, length_distribution, mean_length, min_length, max_length);
+        for (size_t trial = 0; trial < length; trial++) {
+            const size_t item = all_items[sample_index(generator, items_per_student)];
+            const size_t skill = true_skills[item];
+            const struct bkt_parameters & params = skill_params[skill];
+
+            if (knows_skill[skill] < 0) {
+                knows_skill[skill] = generator.sampleUniform01() < params.psi;
+                skills_touched.push_back(skill);
+            }
+
+            // respond, then possibly learn (the same order of events as the model's forward update)
+            const double p_correct = knows_skill[skill] ? params.pi1 : params.pi1 * params.prop0;
+            writer->write(student, item, generator.sampleUniform01() < p_correct);
+            if (!knows_skill[skill] && generator.sampleUniform01() < params.mu) knows_skill[skill] = 1;
+        }
+        num_trials += length;
+
+        for (size_t i = 0; i < skills_touched.size(); i++) knows_skill[skills_touched[i]] = -1;
+        skills_touched.clear();
+    }
+    delete writer; // flushes
+
+    // write the cross validation splits: each replication deals a random permutation of the students into the folds
+    ofstream out_splits((outprefix + "_splits.txt").c_str(), ofstream::out);
+    vector<size_t> order(num_students);
+    for (size_t replication = 0; replication < num_replications; replication++) {
+        for (size_t student = 0; student < num_students; student++) order[student] = student;
+        for (size_t i = 0; i + 1 < num_students; i++) swap(order[i], order[i + sample_index(generator, num_students - i)]);
+        vector<size_t> fold_nums(num_students);
+        for (size_t i = 0; i < num_students; i++) fold_nums[order[i]] = i % num_folds;
+        write_labels(out_splits, fold_nums, false);
+    }
+    out_splits.close();
+
+    write_labels(outprefix + "_expert_labels.txt", expert_labels, true);
+    write_labels(outprefix + "_true_skills.txt", true_skills, false);
+
+    ofstream out_params((outprefix + "_true_parameters.txt").c_str(), ofstream::out);
+    out_params << "skill\tpsi\tmu\tpi1\tprop0" << endl;
+    for (size_t skill = 0; skill < num_skills; skill++) out_params << skill << "\t" << skill_params[skill].psi << "\t" << skill_params[skill].mu << "\t" << skill_params[skill].pi1 << "\t" << skill_params[skill].prop0 << endl;
+
+    cout << "wrote " << num_trials << " trials from " << num_students << " students on " << num_items << " items (" << num_skills << " true skills) in " << setprecision(3) << (get_wall_time() - begin) << " seconds" << endl;
+    return EXIT_SUCCESS;
+}
+
+#endif
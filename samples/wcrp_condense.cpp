@@ -0,0 +1,103 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef WCRP_CONDENSE_CPP
+#define WCRP_CONDENSE_CPP
+
+#include "common.hpp"
+#include "Posterior.hpp"
+
+using namespace std;
+
+// condenses a saved posterior into a few weighted samples for serving (see condense_posterior). if max_samples picks don't
+// bring the validation cross-entropy within the tolerance, the achieved difference is reported and nothing is saved unless
+// --allow_inexact is given
+
+
+int main(int argc, char ** argv) {
+
+    namespace po = boost::program_options;
+
+    string datafile, posteriorfile, savefile;
+    int tmp_max_samples;
+    double tolerance;
+
+    // parse the command line arguments
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "print help message")
+        ("posterior_file", po::value<string>(&posteriorfile), "(required) posterior samples written by find_skills --posterior_file")
+        ("datafile", po::value<string>(&datafile), "(required) validation students' recall data, in find_skills' format")
+        ("savefile", po::value<string>(&savefile), "(required) file to put the condensed posterior")
+        ("max_samples", po::value<int>(&tmp_max_samples)->default_value(10), "maximum number of herding picks, and so of distinct samples kept")
+        ("tolerance", po::value<double>(&tolerance)->default_value(.001), "stop once the validation cross-entropy (nats per trial) is within this much of the full posterior's")
+        ("allow_inexact", "save the condensed posterior even if max_samples picks don't reach the tolerance")
+    ;
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (argc == 1 || vm.count("help") || datafile.empty() || posteriorfile.empty() || savefile.empty()) {
+        cout << desc << endl;
+        return EXIT_SUCCESS;
+    }
+
+    if (tmp_max_samples <= 0 || tolerance < 0) {
+        cerr << "--max_samples must be positive and --tolerance nonnegative" << endl;
+        exit(EXIT_FAILURE);
+    }
+    const size_t max_samples = (size_t) tmp_max_samples;
+
+    vector<posterior_sample> samples;
+    size_t num_items;
+    load_posterior(posteriorfile.c_str(), samples, num_items);
+
+    vector< vector<bool> > recall_sequences;
+    vector< vector<size_t> > item_sequences;
+    size_t num_students, num_data_items, num_skills_dataset;
+    load_student_data(datafile.c_str(), recall_sequences, item_sequences, num_students, num_data_items, num_skills_dataset);
+    if (num_data_items > num_items) {
+        cerr << datafile << " has items that aren't in the posterior" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    vector<posterior_sample> condensed;
+    double full_cross_entropy, condensed_cross_entropy;
+    const bool reached = condense_posterior(samples, num_items, recall_sequences, item_sequences, max_samples, tolerance, condensed, full_cross_entropy, condensed_cross_entropy, &cerr);
+    if (!reached) {
+        cerr << max_samples << " picks left the validation cross-entropy " << condensed_cross_entropy - full_cross_entropy << " from the full posterior's, outside the tolerance of " << tolerance << endl;
+        if (!vm.count("allow_inexact")) {
+            cerr << "not saving " << savefile << ". raise --max_samples or --tolerance, or pass --allow_inexact" << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    save_posterior(savefile.c_str(), condensed);
+    cerr << "saved " << condensed.size() << " weighted samples to " << savefile << endl;
+
+    return EXIT_SUCCESS;
+}
+
+#endif
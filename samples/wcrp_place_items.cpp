@@ -0,0 +1,198 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef WCRP_PLACE_ITEMS_CPP
+#define WCRP_PLACE_ITEMS_CPP
+
+#include "common.hpp"
+#include "Posterior.hpp"
+#include "ColdStart.hpp"
+
+#include <thread>
+
+using namespace std;
+
+// provisional skill assignments for newly authored items, from a saved posterior and the new items' expert-provided
+// skills, without rerunning MCMC. the new items are the expertfile's entries beyond the posterior's items.
+//
+// for each new item, the WCRP conditional over each sample's skills and a new skill is averaged into the probability
+// that the item gets a skill of its own and, for each existing item, the probability that the new item shares its skill
+
+
+struct item_placement {
+    size_t item;
+    double new_skill_prob;
+    vector< pair<double, size_t> > co_assigned; // (probability, existing item), most probable first
+    string sample_probs; // lines of the --sample_file, if it was given
+};
+
+
+void place_items(const ColdStartPlacer & placer, const vector<posterior_sample> & samples, const vector<size_t> & provided_skill_labels, const size_t top_n, const bool keep_sample_probs, vector<item_placement> & placements, const size_t begin, const size_t end) {
+    const size_t num_items = samples[0].skill_labels.size();
+    vector<double> probs, co_assignment(num_items);
+    for (size_t idx = begin; idx < end; idx++) {
+        item_placement & placement = placements[idx];
+        const size_t expert_label = provided_skill_labels.at(placement.item);
+
+        placement.new_skill_prob = 0.0;
+        fill(co_assignment.begin(), co_assignment.end(), 0.0);
+        double total_weight = 0.0;
+        for (size_t sample = 0; sample < samples.size(); sample++) {
+            placer.skill_probabilities(sample, expert_label, probs);
+            const double weight = samples[sample].weight;
+            total_weight += weight;
+            placement.new_skill_prob += weight * probs.back();
+            const vector<size_t> & labels = samples[sample].skill_labels;
+            for (size_t item = 0; item < num_items; item++) co_assignment[item] += weight * probs[labels[item]];
+
+            if (keep_sample_probs) {
+                placement.sample_probs += boost::lexical_cast<string>(placement.item) + "\t" + boost::lexical_cast<string>(sample);
+                for (size_t event = 0; event < probs.size(); event++) placement.sample_probs += "\t" + boost::lexical_cast<string>(probs[event]);
+                placement.sample_probs += "\n";
+            }
+        }
+        placement.new_skill_prob /= total_weight;
+
+        placement.co_assigned.clear();
+        for (size_t item = 0; item < num_items; item++) placement.co_assigned.push_back(make_pair(co_assignment[item] / total_weight, item));
+        const size_t num_kept = min(top_n, num_items);
+        partial_sort(placement.co_assigned.begin(), placement.co_assigned.begin() + num_kept, placement.co_assigned.end(), greater< pair<double, size_t> >());
+        placement.co_assigned.resize(num_kept);
+    }
+}
+
+
+int main(int argc, char ** argv) {
+
+    namespace po = boost::program_options;
+
+    string posteriorfile, expertfile, savefile, samplefile;
+    int tmp_num_threads, tmp_top_n;
+    double alpha_prime, beta;
+
+    // parse the command line arguments
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "print help message")
+        ("posterior_file", po::value<string>(&posteriorfile), "(required) posterior samples written by find_skills --posterior_file")
+        ("expertfile", po::value<string>(&expertfile), "(required) expert-provided skill labels of the posterior's items followed by those of the new items")
+        ("savefile", po::value<string>(&savefile), "(optional) file to put each new item's placement. defaults to stdout")
+        ("sample_file", po::value<string>(&samplefile), "(optional) file to put, for each new item and sample, the probability of each of the sample's skills and then of a new skill")
+        ("top_items", po::value<int>(&tmp_top_n)->default_value(10), "number of existing items, most likely to share the new item's skill first, to list per new item")
+        ("threads", po::value<int>(&tmp_num_threads)->default_value(max(1, (int) thread::hardware_concurrency())), "number of threads")
+        ("alpha_prime", po::value<double>(&alpha_prime), "(optional) alpha' to use if the posterior file doesn't record it (files from before it did)")
+        ("beta", po::value<double>(&beta), "(optional) beta to use if the posterior file doesn't record it")
+    ;
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (argc == 1 || vm.count("help") || posteriorfile.empty() || expertfile.empty()) {
+        cout << desc << endl;
+        return EXIT_SUCCESS;
+    }
+
+    assert(tmp_num_threads > 0 && tmp_top_n >= 0);
+    const size_t num_threads = (size_t) tmp_num_threads;
+    const size_t top_n = (size_t) tmp_top_n;
+
+    vector<posterior_sample> samples;
+    size_t num_items;
+    load_posterior(posteriorfile.c_str(), samples, num_items);
+    for (size_t sample = 0; sample < samples.size(); sample++) {
+        if (std::isnan(samples[sample].log_alpha_prime)) {
+            if (!vm.count("alpha_prime") || !vm.count("beta")) {
+                cerr << posteriorfile << " doesn't record alpha' and beta. pass --alpha_prime and --beta" << endl;
+                exit(EXIT_FAILURE);
+            }
+            assert(alpha_prime > 0 && beta >= 0 && beta <= 1);
+            samples[sample].log_alpha_prime = log(alpha_prime);
+            samples[sample].log_gamma = log(1.0 - beta);
+        }
+    }
+
+    // the expert labels have the same format as find_skills', with the new items' appended
+    vector<size_t> provided_skill_labels;
+    ifstream in(expertfile.c_str());
+    if (!in.is_open()) {
+        cerr << "couldn't open " << expertfile << endl;
+        exit(EXIT_FAILURE);
+    }
+    size_t label;
+    while (in >> label) provided_skill_labels.push_back(label);
+    in.close();
+    if (provided_skill_labels.size() <= num_items) {
+        cerr << expertfile << " has no items beyond the posterior's " << num_items << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    const double begin_time = get_wall_time();
+    const ColdStartPlacer placer(samples, provided_skill_labels);
+    vector<item_placement> placements(provided_skill_labels.size() - num_items);
+    for (size_t idx = 0; idx < placements.size(); idx++) placements[idx].item = num_items + idx;
+
+    vector<thread> workers;
+    const size_t share = (placements.size() + num_threads - 1) / num_threads;
+    for (size_t t = 0; t < num_threads; t++) {
+        const size_t share_begin = min(placements.size(), t * share), share_end = min(placements.size(), (t + 1) * share);
+        if (share_begin < share_end) workers.push_back(thread(place_items, cref(placer), cref(samples), cref(provided_skill_labels), top_n, !samplefile.empty(), ref(placements), share_begin, share_end));
+    }
+    for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+    const double seconds = get_wall_time() - begin_time;
+
+    ofstream out_file;
+    if (!savefile.empty()) {
+        out_file.open(savefile.c_str(), ofstream::out);
+        if (!out_file.is_open()) {
+            cerr << "couldn't open " << savefile << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    ostream & out = savefile.empty() ? cout : out_file;
+    out << "item\tnew_skill_prob\tco_assigned_items" << endl;
+    for (size_t idx = 0; idx < placements.size(); idx++) {
+        const item_placement & placement = placements[idx];
+        out << placement.item << "\t" << placement.new_skill_prob << "\t";
+        for (size_t rank = 0; rank < placement.co_assigned.size(); rank++) out << (rank ? "," : "") << placement.co_assigned[rank].second << ":" << placement.co_assigned[rank].first;
+        out << endl;
+    }
+
+    if (!samplefile.empty()) {
+        ofstream sample_out(samplefile.c_str(), ofstream::out);
+        if (!sample_out.is_open()) {
+            cerr << "couldn't open " << samplefile << endl;
+            exit(EXIT_FAILURE);
+        }
+        for (size_t idx = 0; idx < placements.size(); idx++) sample_out << placements[idx].sample_probs;
+    }
+
+    cerr << "placed " << placements.size() << " new items against " << samples.size() << " samples in " << setprecision(3) << seconds << " seconds ("
+         << (1000.0 * seconds / placements.size()) << " ms per item)" << endl;
+
+    return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,255 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef WCRP_PREDICT_CPP
+#define WCRP_PREDICT_CPP
+
+#include "common.hpp"
+#include "Posterior.hpp"
+
+#include <cstdio>
+#include <thread>
+
+using namespace std;
+
+// scores new students against a saved posterior without rerunning MCMC: each student's trials are forward
+// filtered under every retained sample, giving the same per-trial recall probabilities as get_estimated_recall_prob
+// gives for heldout students
+//
+// the datafile has the same format as the other tools' but must list each student's trials contiguously, which
+// lets it be streamed: students are read, scored across threads and written out a batch at a time
+
+
+struct student_trials {
+    size_t student;
+    vector<size_t> items;
+    vector<bool> recalls;
+};
+
+
+class StudentReader {
+
+ // reads the datafile one student at a time
+ public:
+
+    StudentReader(const char * filename, const size_t num_items) : filename(filename), num_items(num_items), have_line(false) {
+        in = fopen(filename, "r");
+        if (!in) {
+            cerr << "couldn't open " << string(filename) << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    ~StudentReader() {
+        fclose(in);
+    }
+
+    // returns false once the file is exhausted
+    bool next(student_trials & trials) {
+        if (!have_line && !read_line()) return false;
+        trials.student = line_student;
+        trials.items.clear();
+        trials.recalls.clear();
+        if (line_student < finished_students.size() && finished_students[line_student]) {
+            cerr << string(filename) << ": the trials of student " << line_student << " aren't contiguous" << endl;
+            exit(EXIT_FAILURE);
+        }
+        do {
+            trials.items.push_back(line_item);
+            trials.recalls.push_back(line_recall);
+        } while (read_line() && line_student == trials.student);
+        if (trials.student >= finished_students.size()) finished_students.resize(2 * trials.student + 1, false);
+        finished_students[trials.student] = true;
+        return true;
+    }
+
+ protected:
+
+    // reads the next whitespace-separated unsigned integer. returns 0 at the end of the file, 1 on success and -1 on anything else
+    int read_number(size_t & value) {
+        int c;
+        do c = getc_unlocked(in); while (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+        if (c == EOF) return 0;
+        if (c < '0' || c > '9') return -1;
+        value = 0;
+        for (; c >= '0' && c <= '9'; c = getc_unlocked(in)) value = 10 * value + (c - '0');
+        if (c != EOF) ungetc(c, in);
+        return 1;
+    }
+
+    bool read_line() {
+        size_t student, item, recall;
+        const int status = read_number(student);
+        if (status == 0) {
+            have_line = false;
+            return false;
+        }
+        if (status < 0 || read_number(item) != 1 || read_number(recall) != 1) {
+            cerr << string(filename) << " is malformed" << endl;
+            exit(EXIT_FAILURE);
+        }
+        if (item >= num_items) {
+            cerr << string(filename) << " has item " << item << ", which isn't in the posterior" << endl;
+            exit(EXIT_FAILURE);
+        }
+        line_student = student;
+        line_item = item;
+        line_recall = recall != 0;
+        have_line = true;
+        return true;
+    }
+
+    const string filename;
+    const size_t num_items;
+    FILE * in;
+    bool have_line; // true if line_* hold a trial that hasn't been returned yet
+    size_t line_student, line_item;
+    bool line_recall;
+    vector<bool> finished_students;
+
+};
+
+
+// appends the decimal digits of value
+static void append_number(string & out, size_t value) {
+    char digits[24];
+    size_t length = 0;
+    do {
+        digits[length++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    while (length > 0) out += digits[--length];
+}
+
+
+// appends "student <tab> trial <tab> recalled <tab> probability" lines for each of the students' trials
+// (formatted by hand; snprintf would take about as long as the scoring)
+void score_students(const PosteriorPredictor & predictor, const vector<student_trials> & students, const size_t begin, const size_t end, string & out) {
+    vector<double> state;
+    for (size_t s = begin; s < end; s++) {
+        const student_trials & trials = students[s];
+        predictor.init_state(state);
+        for (size_t trial = 0; trial < trials.items.size(); trial++) {
+            const double prob = predictor.predict(state, trials.items[trial]);
+            append_number(out, trials.student);
+            out += '\t';
+            append_number(out, trial);
+            out += trials.recalls[trial] ? "\t1\t" : "\t0\t";
+
+            // six decimal places, like %.6f for a probability
+            const size_t millionths = (size_t) llround(min(1.0, max(0.0, prob)) * 1e6);
+            out += millionths >= 1000000 ? '1' : '0';
+            out += '.';
+            const size_t fraction = millionths % 1000000;
+            for (size_t place = 100000; place > 0; place /= 10) out += '0' + (fraction / place) % 10;
+            out += '\n';
+
+            predictor.observe(state, trials.items[trial], trials.recalls[trial]);
+        }
+    }
+}
+
+
+int main(int argc, char ** argv) {
+
+    namespace po = boost::program_options;
+
+    string datafile, posteriorfile, savefile;
+    int tmp_num_threads, tmp_batch_size;
+
+    // parse the command line arguments
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "print help message")
+        ("datafile", po::value<string>(&datafile), "(required) file containing the new students' recall data, each student's trials on consecutive lines")
+        ("posterior_file", po::value<string>(&posteriorfile), "(required) posterior samples written by find_skills --posterior_file")
+        ("savefile", po::value<string>(&savefile), "(optional) file to put the per-trial recall probabilities. defaults to stdout")
+        ("threads", po::value<int>(&tmp_num_threads)->default_value(max(1, (int) thread::hardware_concurrency())), "number of scoring threads")
+        ("batch_students", po::value<int>(&tmp_batch_size)->default_value(20000), "number of students read, scored and written at a time")
+    ;
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (argc == 1 || vm.count("help") || datafile.empty() || posteriorfile.empty()) {
+        cout << desc << endl;
+        return EXIT_SUCCESS;
+    }
+
+    assert(tmp_num_threads > 0 && tmp_batch_size > 0);
+    const size_t num_threads = (size_t) tmp_num_threads;
+    const size_t batch_size = (size_t) tmp_batch_size;
+
+    vector<posterior_sample> samples;
+    size_t num_items;
+    load_posterior(posteriorfile.c_str(), samples, num_items);
+    const PosteriorPredictor predictor(samples, num_items);
+    samples.clear();
+
+    FILE * out = savefile.empty() ? stdout : fopen(savefile.c_str(), "w");
+    if (!out) {
+        cerr << "couldn't open " << savefile << endl;
+        exit(EXIT_FAILURE);
+    }
+    fprintf(out, "student\ttrial\tstudent_recalled\tprob_recall\n");
+
+    const double begin_time = get_wall_time();
+    size_t num_students = 0, num_trials = 0;
+    StudentReader reader(datafile.c_str(), num_items);
+    vector<student_trials> batch(batch_size);
+    vector<string> outputs(num_threads);
+    bool more = true;
+    while (more) {
+        size_t batch_count = 0;
+        while (batch_count < batch_size && (more = reader.next(batch[batch_count]))) {
+            num_trials += batch[batch_count].items.size();
+            batch_count++;
+        }
+        if (batch_count == 0) break;
+        num_students += batch_count;
+
+        // each thread scores a contiguous share of the batch so the output stays in input order
+        vector<thread> workers;
+        const size_t share = (batch_count + num_threads - 1) / num_threads;
+        for (size_t t = 0; t < num_threads; t++) {
+            outputs[t].clear();
+            const size_t share_begin = min(batch_count, t * share), share_end = min(batch_count, (t + 1) * share);
+            if (share_begin < share_end) workers.push_back(thread(score_students, cref(predictor), cref(batch), share_begin, share_end, ref(outputs[t])));
+        }
+        for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+        for (size_t t = 0; t < num_threads; t++) fwrite(outputs[t].data(), 1, outputs[t].size(), out);
+    }
+
+    if (out != stdout) fclose(out);
+    else fflush(out);
+    const double seconds = get_wall_time() - begin_time;
+    cerr << "scored " << num_trials << " trials of " << num_students << " students against " << predictor.get_num_samples() << " samples in "
+         << setprecision(3) << seconds << " seconds" << endl;
+
+    return EXIT_SUCCESS;
+}
+
+#endif
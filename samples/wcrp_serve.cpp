@@ -0,0 +1,336 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef WCRP_SERVE_CPP
+#define WCRP_SERVE_CPP
+
+#include "common.hpp"
+#include "Posterior.hpp"
+
+#include <csignal>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+// online knowledge tracing: keeps each student's forward state under every posterior sample and answers
+// one-line requests, either on stdin/stdout or from any number of clients on a Unix domain socket:
+//   observe <student> <item> <0 or 1>     records a trial and replies "ok"
+//   predict <student> <item> [<item> ...] replies with the probability of a correct response to each item on the next trial
+//   reset <student>                       forgets the student
+//   stats                                 replies with the number of requests and the p50/p99 latencies
+// students are arbitrary strings; items are the dataset's item ids. errors are replied as "error <message>"
+//
+// in socket mode, every request that arrives while the previous batch is being answered is handled as one batch,
+// and each client's replies go out in a single write
+
+#define MAX_LATENCIES 100000 // latency percentiles are computed over the most recent requests
+#define MAX_LINE_LENGTH 65536
+#define MAX_QUEUED_REPLY_BYTES (1 << 20) // a client that lets more replies than this pile up unread is dropped
+
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_stop_signal(int) {
+    stop_requested = 1;
+}
+
+
+class LatencyStats {
+
+ // a window of the most recent request latencies
+ public:
+
+    LatencyStats() : num_requests(0) {}
+
+    void add(const double seconds) {
+        if (latencies.size() < MAX_LATENCIES) latencies.push_back(seconds);
+        else latencies[num_requests % MAX_LATENCIES] = seconds;
+        num_requests++;
+    }
+
+    // returns the q quantile (0 <= q <= 1) of the window, in microseconds
+    double quantile_us(const double q) const {
+        if (latencies.empty()) return 0.0;
+        vector<double> sorted(latencies);
+        const size_t rank = min(sorted.size() - 1, (size_t) (q * sorted.size()));
+        nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+        return 1e6 * sorted[rank];
+    }
+
+    string report() const {
+        ostringstream out;
+        out << fixed << setprecision(1) << "requests\t" << num_requests << "\tp50_us\t" << quantile_us(.5) << "\tp99_us\t" << quantile_us(.99);
+        return out.str();
+    }
+
+ protected:
+
+    vector<double> latencies;
+    size_t num_requests;
+
+};
+
+
+class PredictionService {
+
+ public:
+
+    PredictionService(const PosteriorPredictor & predictor) : predictor(predictor) {}
+
+    // answers one request line. the reply has no trailing newline
+    string handle(const string & line) {
+        vector<string> words;
+        const string trimmed = boost::trim_copy(line);
+        if (!trimmed.empty()) boost::split(words, trimmed, boost::is_any_of(" \t"), boost::token_compress_on);
+        if (words.empty()) return "error empty request";
+
+        const string & command = words[0];
+        try {
+            if (command == "observe" && words.size() == 4) {
+                const size_t item = parse_item(words[2]);
+                const int response = boost::lexical_cast<int>(words[3]);
+                if (response != 0 && response != 1) return "error the response must be 0 or 1";
+                predictor.observe(student_state(words[1]), item, response == 1);
+                return "ok";
+            }
+            if (command == "predict" && words.size() >= 3) {
+                const vector<double> & state = student_state(words[1]);
+                ostringstream out;
+                out << fixed << setprecision(6);
+                for (size_t w = 2; w < words.size(); w++) out << (w > 2 ? "\t" : "") << predictor.predict(state, parse_item(words[w]));
+                return out.str();
+            }
+            if (command == "reset" && words.size() == 2) {
+                students.erase(words[1]);
+                return "ok";
+            }
+            if (command == "stats" && words.size() == 1) return latency.report() + "\tstudents\t" + boost::lexical_cast<string>(students.size());
+        }
+        catch (const boost::bad_lexical_cast &) {
+            return "error couldn't parse " + trimmed;
+        }
+        catch (const out_of_range & e) {
+            return string("error ") + e.what();
+        }
+        return "error unknown request. use observe <student> <item> <0 or 1>, predict <student> <item> ..., reset <student> or stats";
+    }
+
+    LatencyStats latency;
+
+ protected:
+
+    size_t parse_item(const string & word) const {
+        const size_t item = boost::lexical_cast<size_t>(word);
+        if (item >= predictor.get_num_items()) throw out_of_range("item " + word + " isn't in the posterior");
+        return item;
+    }
+
+    vector<double> & student_state(const string & student) {
+        boost::unordered_map<string, vector<double> >::iterator itr = students.find(student);
+        if (itr != students.end()) return itr->second;
+        vector<double> & state = students[student];
+        predictor.init_state(state);
+        return state;
+    }
+
+    const PosteriorPredictor & predictor;
+    boost::unordered_map<string, vector<double> > students; // students[id] = forward state
+
+};
+
+
+void serve_stdin(PredictionService & service) {
+    string line;
+    while (!stop_requested && getline(cin, line)) {
+        const double begin = get_wall_time();
+        cout << service.handle(line) << '\n';
+        if (cin.rdbuf()->in_avail() == 0) cout.flush(); // only flush once a batch of piped requests has been answered
+        service.latency.add(get_wall_time() - begin);
+    }
+    cout.flush();
+}
+
+
+struct client_connection {
+    int fd;
+    string pending;  // bytes read but not yet terminated by a newline
+    string outgoing; // replies the client hasn't taken yet
+};
+
+
+// sends as much of the client's queued replies as its socket takes without blocking. returns false if the client is gone
+bool flush_replies(client_connection & client) {
+    size_t written = 0;
+    while (written < client.outgoing.size()) {
+        const ssize_t result = send(client.fd, client.outgoing.data() + written, client.outgoing.size() - written, MSG_NOSIGNAL);
+        if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (result <= 0) return false;
+        written += result;
+    }
+    client.outgoing.erase(0, written);
+    return true;
+}
+
+
+void serve_socket(PredictionService & service, const string & socket_path) {
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        cerr << "socket path " << socket_path << " is too long" << endl;
+        exit(EXIT_FAILURE);
+    }
+    strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    unlink(socket_path.c_str());
+    const int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(listen_fd, 64) != 0) {
+        cerr << "couldn't listen on " << socket_path << ": " << strerror(errno) << endl;
+        exit(EXIT_FAILURE);
+    }
+    cerr << "listening on " << socket_path << endl;
+
+    vector<client_connection> clients;
+    vector<struct pollfd> fds;
+    char buffer[65536];
+
+    while (!stop_requested) {
+        fds.resize(clients.size() + 1);
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        for (size_t c = 0; c < clients.size(); c++) {
+            fds[c+1].fd = clients[c].fd;
+            fds[c+1].events = POLLIN | (clients[c].outgoing.empty() ? 0 : POLLOUT);
+        }
+        if (poll(&fds[0], fds.size(), 200) <= 0) continue;
+        const double batch_begin = get_wall_time();
+
+        // answer every complete request from every ready client, then queue each client's replies at once and send what 
+        // its socket takes. the sockets don't block, so a client that stops reading can't stall the others
+        vector<bool> closed(clients.size(), false);
+        for (size_t c = 0; c < clients.size(); c++) {
+            if ((fds[c+1].revents & POLLOUT) && !flush_replies(clients[c])) {
+                closed[c] = true;
+                continue;
+            }
+            if (!(fds[c+1].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            const ssize_t num_read = read(clients[c].fd, buffer, sizeof(buffer));
+            if (num_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+            if (num_read <= 0) {
+                closed[c] = true;
+                continue;
+            }
+            clients[c].pending.append(buffer, num_read);
+
+            string replies;
+            size_t line_begin = 0, newline;
+            size_t num_requests = 0;
+            while ((newline = clients[c].pending.find('\n', line_begin)) != string::npos) {
+                replies += service.handle(clients[c].pending.substr(line_begin, newline - line_begin));
+                replies += '\n';
+                line_begin = newline + 1;
+                num_requests++;
+            }
+            clients[c].pending.erase(0, line_begin);
+            if (clients[c].pending.size() > MAX_LINE_LENGTH) closed[c] = true;
+
+            clients[c].outgoing += replies;
+            if (!flush_replies(clients[c]) || clients[c].outgoing.size() > MAX_QUEUED_REPLY_BYTES) closed[c] = true;
+
+            // every request in the batch waited for the whole batch up to its client's write
+            const double latency = get_wall_time() - batch_begin;
+            for (size_t r = 0; r < num_requests; r++) service.latency.add(latency);
+        }
+
+        for (size_t c = clients.size(); c-- > 0; ) {
+            if (!closed[c]) continue;
+            close(clients[c].fd);
+            clients.erase(clients.begin() + c);
+        }
+
+        if (fds[0].revents & POLLIN) {
+            const int client_fd = accept(listen_fd, NULL, NULL);
+            if (client_fd >= 0) {
+                fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL) | O_NONBLOCK);
+                client_connection client;
+                client.fd = client_fd;
+                clients.push_back(client);
+            }
+        }
+    }
+
+    for (size_t c = 0; c < clients.size(); c++) close(clients[c].fd);
+    close(listen_fd);
+    unlink(socket_path.c_str());
+}
+
+
+int main(int argc, char ** argv) {
+
+    namespace po = boost::program_options;
+
+    string posteriorfile, socket_path;
+
+    // parse the command line arguments
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "print help message")
+        ("posterior_file", po::value<string>(&posteriorfile), "(required) posterior samples written by find_skills --posterior_file")
+        ("socket", po::value<string>(&socket_path), "(optional) serve clients on this Unix domain socket instead of reading requests from stdin")
+    ;
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (argc == 1 || vm.count("help") || posteriorfile.empty()) {
+        cout << desc << endl;
+        return EXIT_SUCCESS;
+    }
+
+    vector<posterior_sample> samples;
+    size_t num_items;
+    load_posterior(posteriorfile.c_str(), samples, num_items);
+    const PosteriorPredictor predictor(samples, num_items);
+    cerr << posteriorfile << " has " << predictor.get_num_samples() << " samples of " << num_items << " items" << endl;
+
+    signal(SIGINT, handle_stop_signal);
+    signal(SIGTERM, handle_stop_signal);
+
+    PredictionService service(predictor);
+    if (socket_path.empty()) serve_stdin(service);
+    else serve_socket(service, socket_path);
+
+    cerr << service.latency.report() << endl;
+    return EXIT_SUCCESS;
+}
+
+#endif
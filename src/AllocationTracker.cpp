@@ -0,0 +1,92 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ALLOCATION_TRACKER_CPP
+#define ALLOCATION_TRACKER_CPP
+
+#include "AllocationTracker.hpp"
+
+#include <atomic>
+
+using namespace std;
+
+static atomic<bool> tracking(false);
+static atomic<unsigned long long> num_allocations(0);
+static atomic<unsigned long long> num_deallocations(0);
+static atomic<unsigned long long> num_bytes(0);
+static bool hooks_installed = false; // set before main by AllocationHooks.cpp, if the program links it
+
+
+void allocation_tracking_enable() {
+    tracking.store(true);
+}
+
+
+bool allocation_tracking_enabled() {
+    return tracking.load(memory_order_relaxed);
+}
+
+
+allocation_counts read_allocation_counts() {
+    allocation_counts counts;
+    counts.allocations = num_allocations.load(memory_order_relaxed);
+    counts.deallocations = num_deallocations.load(memory_order_relaxed);
+    counts.bytes = num_bytes.load(memory_order_relaxed);
+    return counts;
+}
+
+
+allocation_counts allocation_difference(const allocation_counts & after, const allocation_counts & before) {
+    allocation_counts diff;
+    diff.allocations = after.allocations - before.allocations;
+    diff.deallocations = after.deallocations - before.deallocations;
+    diff.bytes = after.bytes - before.bytes;
+    return diff;
+}
+
+
+void allocation_tracking_count_allocation(const size_t size) {
+    if (!tracking.load(memory_order_relaxed)) return;
+    num_allocations.fetch_add(1, memory_order_relaxed);
+    num_bytes.fetch_add(size, memory_order_relaxed);
+}
+
+
+void allocation_tracking_count_deallocation(void * ptr) {
+    if (!ptr || !tracking.load(memory_order_relaxed)) return;
+    num_deallocations.fetch_add(1, memory_order_relaxed);
+}
+
+
+void allocation_tracking_hooks_installed() {
+    hooks_installed = true;
+}
+
+
+bool allocation_tracking_available() {
+    return hooks_installed;
+}
+
+#endif
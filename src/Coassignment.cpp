@@ -0,0 +1,130 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef COASSIGNMENT_CPP
+#define COASSIGNMENT_CPP
+
+#include "Coassignment.hpp"
+
+using namespace std;
+
+#define NOT_TOGETHER ((size_t) -1)
+
+
+CoassignmentCounts::CoassignmentCounts(const size_t num_items) : num_items(num_items), num_samples(0) {}
+
+
+uint64_t CoassignmentCounts::pair_key(const size_t item_a, const size_t item_b) const {
+    assert(item_a != item_b && item_a < num_items && item_b < num_items);
+    return (uint64_t) min(item_a, item_b) * num_items + max(item_a, item_b);
+}
+
+
+void CoassignmentCounts::pair_joined(const size_t item_a, const size_t item_b) {
+    const uint64_t key = pair_key(item_a, item_b);
+    boost::unordered_map<uint64_t, struct pair_run>::iterator run_itr = runs.find(key);
+    if (run_itr == runs.end()) {
+        struct pair_run run = {0, num_samples};
+        runs[key] = run;
+    }
+    else {
+        assert(run_itr->second.run_start == NOT_TOGETHER);
+        run_itr->second.run_start = num_samples;
+    }
+}
+
+
+void CoassignmentCounts::pair_separated(const size_t item_a, const size_t item_b) {
+    struct pair_run & run = runs.at(pair_key(item_a, item_b));
+    assert(run.run_start != NOT_TOGETHER);
+    run.count += num_samples - run.run_start;
+    run.run_start = NOT_TOGETHER;
+}
+
+
+void CoassignmentCounts::add_sample() {
+    num_samples++;
+}
+
+
+size_t CoassignmentCounts::get_num_items() const {
+    return num_items;
+}
+
+
+size_t CoassignmentCounts::get_num_samples() const {
+    return num_samples;
+}
+
+
+size_t CoassignmentCounts::get_count(const size_t item_a, const size_t item_b) const {
+    if (item_a == item_b) return num_samples;
+    boost::unordered_map<uint64_t, struct pair_run>::const_iterator run_itr = runs.find(pair_key(item_a, item_b));
+    if (run_itr == runs.end()) return 0;
+    return run_itr->second.count + (run_itr->second.run_start == NOT_TOGETHER ? 0 : num_samples - run_itr->second.run_start);
+}
+
+
+double CoassignmentCounts::get_probability(const size_t item_a, const size_t item_b) const {
+    assert(num_samples > 0);
+    return get_count(item_a, item_b) / (double) num_samples;
+}
+
+
+void CoassignmentCounts::get_pairs(vector< pair<size_t, size_t> > & pairs) const {
+    pairs.clear();
+    for (boost::unordered_map<uint64_t, struct pair_run>::const_iterator run_itr = runs.begin(); run_itr != runs.end(); run_itr++) {
+        pairs.push_back(make_pair((size_t) (run_itr->first / num_items), (size_t) (run_itr->first % num_items)));
+    }
+}
+
+
+void CoassignmentCounts::save(const char * filename) const {
+    ofstream out(filename, ofstream::out);
+    if (!out.is_open()) {
+        cerr << "couldn't open " << filename << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    vector< pair<size_t, size_t> > pairs;
+    get_pairs(pairs);
+    sort(pairs.begin(), pairs.end());
+    out << "num_items\t" << num_items << endl;
+    out << "num_samples\t" << num_samples << endl;
+    out << setprecision(10);
+    for (size_t idx = 0; idx < pairs.size(); idx++) {
+        const size_t count = get_count(pairs[idx].first, pairs[idx].second);
+        if (count > 0) out << pairs[idx].first << "\t" << pairs[idx].second << "\t" << count / (double) num_samples << endl;
+    }
+}
+
+
+void CoassignmentCounts::clear(const size_t num_items) {
+    runs.clear();
+    this->num_items = num_items;
+    num_samples = 0;
+}
+
+#endif
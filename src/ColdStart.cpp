@@ -0,0 +1,106 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef COLD_START_CPP
+#define COLD_START_CPP
+
+#include "ColdStart.hpp"
+#include "MixtureWCRP.hpp"
+
+using namespace std;
+
+
+ColdStartPlacer::ColdStartPlacer(const vector<posterior_sample> & samples, const vector<size_t> & provided_skill_labels) {
+
+    assert(!samples.empty() && !provided_skill_labels.empty());
+    num_expert_provided_skills = 1 + *max_element(provided_skill_labels.begin(), provided_skill_labels.end());
+
+    tallies.resize(samples.size());
+    for (size_t sample = 0; sample < samples.size(); sample++) {
+        const posterior_sample & cur = samples[sample];
+        assert(cur.skill_labels.size() <= provided_skill_labels.size());
+        assert(!std::isnan(cur.log_alpha_prime) && !std::isnan(cur.log_gamma));
+        log_alpha_primes.push_back(cur.log_alpha_prime);
+        log_gammas.push_back(cur.log_gamma);
+
+        vector<skill_tally> & sample_tallies = tallies[sample];
+        sample_tallies.resize(cur.skill_parameters.size());
+        for (size_t skill = 0; skill < sample_tallies.size(); skill++) {
+            sample_tallies[skill].num_items = 0;
+            sample_tallies[skill].max_count = 0;
+        }
+        for (size_t item = 0; item < cur.skill_labels.size(); item++) {
+            skill_tally & tally = sample_tallies.at(cur.skill_labels[item]);
+            tally.num_items++;
+            const int count = ++tally.counts[provided_skill_labels[item]];
+            tally.max_count = max(tally.max_count, count);
+        }
+    }
+}
+
+
+size_t ColdStartPlacer::get_num_samples() const {
+    return tallies.size();
+}
+
+
+void ColdStartPlacer::skill_probabilities(const size_t sample, const size_t expert_label, vector<double> & probs) const {
+    const vector<skill_tally> & sample_tallies = tallies.at(sample);
+    const double log_gamma = log_gammas[sample];
+    const double gamma = exp(log_gamma);
+
+    // the log seating probabilities, as in MixtureWCRP::score_candidate_tables. (it splits the new skill's among the 
+    // auxiliary prior samples, which adds back up to this.) skills no item is seated at in the sample are left out
+    probs.resize(sample_tallies.size() + 1);
+    double max_lp = -INFINITY;
+    for (size_t skill = 0; skill < sample_tallies.size(); skill++) {
+        const skill_tally & tally = sample_tallies[skill];
+        if (tally.num_items == 0) {
+            probs[skill] = -INFINITY;
+            continue;
+        }
+        const double K = compute_K(tally.counts, tally.max_count, expert_label, gamma, num_expert_provided_skills);
+        probs[skill] = log_old_table_probability(tally.num_items, K, log_gamma, num_expert_provided_skills);
+        max_lp = max(max_lp, probs[skill]);
+    }
+    probs.back() = log_new_table_probability(log_alpha_primes[sample], log_gamma, num_expert_provided_skills);
+    max_lp = max(max_lp, probs.back());
+
+    // with beta = 1 an expert-provided skill no skill has yet can only go to a new skill, whose probability is 0 too
+    if (max_lp == -INFINITY) {
+        fill(probs.begin(), probs.end(), 0.0);
+        probs.back() = 1.0;
+        return;
+    }
+
+    double total = 0.0;
+    for (size_t event = 0; event < probs.size(); event++) {
+        probs[event] = exp(probs[event] - max_lp);
+        total += probs[event];
+    }
+    for (size_t event = 0; event < probs.size(); event++) probs[event] /= total;
+}
+
+#endif
@@ -0,0 +1,92 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef DATASET_CPP
+#define DATASET_CPP
+
+#include "Dataset.hpp"
+
+using namespace std;
+
+
+Dataset::Dataset(const char * datafile, const char * expertfile, const size_t num_labelled_items) : expert_labels(expertfile != NULL) {
+    size_t num_students, num_skills;
+    load_student_data(datafile, recall_sequences, item_sequences, num_students, num_items, num_skills);
+    assert(num_students > 0 && num_items > 0);
+
+    provided_skill_labels.resize(max(num_items, num_labelled_items), 0);
+    if (expertfile) load_expert_labels(expertfile, provided_skill_labels, provided_skill_labels.size());
+    count_trials();
+}
+
+
+Dataset::Dataset(const vector< vector<bool> > & recall_sequences, const vector< vector<size_t> > & item_sequences, const vector<size_t> & provided_skill_labels, const size_t num_items) :
+    recall_sequences(recall_sequences),
+    item_sequences(item_sequences),
+    provided_skill_labels(provided_skill_labels),
+    expert_labels(!provided_skill_labels.empty()),
+    num_items(num_items) {
+
+    assert(recall_sequences.size() == item_sequences.size() && num_items > 0);
+    if (!expert_labels) this->provided_skill_labels.resize(num_items, 0);
+    assert(this->provided_skill_labels.size() >= num_items);
+    for (size_t student = 0; student < item_sequences.size(); student++) {
+        assert(recall_sequences[student].size() == item_sequences[student].size());
+        for (size_t trial = 0; trial < item_sequences[student].size(); trial++) assert(item_sequences[student][trial] < num_items);
+    }
+    count_trials();
+}
+
+
+Dataset::Dataset(const Dataset & dataset, const Dataset & new_trials) :
+    recall_sequences(dataset.recall_sequences),
+    item_sequences(dataset.item_sequences),
+    provided_skill_labels(dataset.provided_skill_labels),
+    expert_labels(dataset.expert_labels),
+    num_items(max(dataset.num_items, new_trials.num_items)) {
+
+    const size_t num_students = max(dataset.get_num_students(), new_trials.get_num_students());
+    recall_sequences.resize(num_students);
+    item_sequences.resize(num_students);
+    for (size_t student = 0; student < new_trials.get_num_students(); student++) {
+        recall_sequences[student].insert(recall_sequences[student].end(), new_trials.recall_sequences[student].begin(), new_trials.recall_sequences[student].end());
+        item_sequences[student].insert(item_sequences[student].end(), new_trials.item_sequences[student].begin(), new_trials.item_sequences[student].end());
+    }
+
+    if (!expert_labels) provided_skill_labels.resize(num_items, 0);
+    if (provided_skill_labels.size() < num_items) {
+        cerr << "the expert labels cover " << provided_skill_labels.size() << " items but the appended data has " << num_items << endl;
+        exit(EXIT_FAILURE);
+    }
+    count_trials();
+}
+
+
+void Dataset::count_trials() {
+    num_trials = 0;
+    for (size_t student = 0; student < item_sequences.size(); student++) num_trials += item_sequences[student].size();
+}
+
+#endif
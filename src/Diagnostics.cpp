@@ -0,0 +1,144 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef DIAGNOSTICS_CPP
+#define DIAGNOSTICS_CPP
+
+#include <sys/resource.h>
+#include "common.hpp"
+#include "Diagnostics.hpp"
+
+using namespace std;
+
+
+// estimates the effective sample size of a single Markov chain's trace
+// uses Geyer's initial monotone sequence estimator of the integrated autocorrelation time
+double effective_sample_size(const vector<double> & trace) {
+
+    const size_t n = trace.size();
+    if (n < 4) return n;
+
+    const double mean = accumulate(trace.begin(), trace.end(), 0.0) / n;
+    double variance = 0.0;
+    for (size_t t = 0; t < n; t++) variance += (trace[t] - mean) * (trace[t] - mean);
+    variance /= n;
+    if (variance <= 0.0) return n; // a constant trace. there's no autocorrelation to correct for
+
+    // autocovariance at lag k
+    vector<double> rho;
+    for (size_t lag = 0; lag < n; lag++) {
+        double acov = 0.0;
+        for (size_t t = 0; t + lag < n; t++) acov += (trace[t] - mean) * (trace[t + lag] - mean);
+        rho.push_back(acov / n / variance);
+
+        // sums of adjacent pairs of autocorrelations must be positive and decreasing. stop once a pair isn't positive
+        if (lag % 2 == 1 && rho[lag - 1] + rho[lag] <= 0.0) break;
+    }
+
+    double tau = -1.0;
+    double prev_pair = rho[0] + (rho.size() > 1 ? rho[1] : 0.0);
+    for (size_t lag = 0; lag + 1 < rho.size(); lag += 2) {
+        const double pair = min(prev_pair, rho[lag] + rho[lag + 1]);
+        if (pair <= 0.0) break;
+        tau += 2.0 * pair;
+        prev_pair = pair;
+    }
+
+    return n / max(tau, 1.0 / log10(1.0 * n)); // cap the ESS for antithetic chains, as Stan does
+}
+
+
+// returns the adjusted Rand index between two partitions of the same items
+double adjusted_rand_index(const vector<size_t> & labels_a, const vector<size_t> & labels_b) {
+
+    assert(labels_a.size() == labels_b.size());
+    const size_t n = labels_a.size();
+    if (n < 2) return 1.0;
+
+    // contingency table and its marginals
+    boost::unordered_map<pair<size_t, size_t>, size_t> joint_counts;
+    boost::unordered_map<size_t, size_t> counts_a, counts_b;
+    for (size_t item = 0; item < n; item++) {
+        joint_counts[make_pair(labels_a[item], labels_b[item])]++;
+        counts_a[labels_a[item]]++;
+        counts_b[labels_b[item]]++;
+    }
+
+    double index = 0.0, sum_a = 0.0, sum_b = 0.0;
+    for (boost::unordered_map<pair<size_t, size_t>, size_t>::const_iterator itr = joint_counts.begin(); itr != joint_counts.end(); itr++) index += itr->second * (itr->second - 1.0) / 2.0;
+    for (boost::unordered_map<size_t, size_t>::const_iterator itr = counts_a.begin(); itr != counts_a.end(); itr++) sum_a += itr->second * (itr->second - 1.0) / 2.0;
+    for (boost::unordered_map<size_t, size_t>::const_iterator itr = counts_b.begin(); itr != counts_b.end(); itr++) sum_b += itr->second * (itr->second - 1.0) / 2.0;
+
+    const double num_pairs = n * (n - 1.0) / 2.0;
+    const double expected_index = sum_a * sum_b / num_pairs;
+    const double max_index = (sum_a + sum_b) / 2.0;
+    if (max_index == expected_index) return 1.0; // both partitions are all-singletons or all-one-cluster
+    return (index - expected_index) / (max_index - expected_index);
+}
+
+
+// returns the number of distinct labels in the partition
+size_t num_distinct_labels(const vector<size_t> & labels) {
+    set<size_t> distinct(labels.begin(), labels.end());
+    return distinct.size();
+}
+
+
+// returns this process's peak resident set size in kilobytes
+size_t peak_resident_memory_kb() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss; // kilobytes on linux
+}
+
+
+// returns the value of a "Name:   1234 kB" line of /proc/self/status, or 0 if there isn't one
+static size_t proc_status_kb(const string & field) {
+    ifstream in("/proc/self/status");
+    string line;
+    while (getline(in, line)) {
+        if (line.compare(0, field.size(), field) == 0) {
+            vector<string> fields;
+            boost::trim(line);
+            boost::split(fields, line, boost::is_any_of(" \t"), boost::token_compress_on);
+            if (fields.size() >= 2) return boost::lexical_cast<size_t>(fields[1]);
+        }
+    }
+    return 0;
+}
+
+
+// returns this process's peak virtual memory size in kilobytes, or 0 if it can't be determined
+size_t peak_virtual_memory_kb() {
+    return proc_status_kb("VmPeak:");
+}
+
+
+// returns this process's current resident set size in kilobytes, or 0 if it can't be determined
+size_t current_resident_memory_kb() {
+    return proc_status_kb("VmRSS:");
+}
+
+#endif
@@ -0,0 +1,383 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef FIXED_SKILL_BKT_CPP
+#define FIXED_SKILL_BKT_CPP
+
+#include <thread>
+#include <functional>
+#include "FixedSkillBKT.hpp"
+
+using namespace std;
+
+// every step's normalizer is at least about TOL, so a product of this many can't underflow
+#define LIKELIHOOD_FOLD_STEPS 16
+
+
+static bool longer(const vector<bool> & a, const vector<bool> & b) {
+    return a.size() > b.size();
+}
+
+
+static inline double clip_parameter(const double x) {
+    return min(ONEMINUSTOL, max(TOL, x));
+}
+
+
+// the probability of the step's response in the unlearned and learned states. masked steps have no response, so both are 1.
+// blended with 0/1 multiplications like MixtureWCRP's bkt_lane_step, so the lane loops vectorize
+static inline void emissions(const double recall, const double mask, const double pi0, const double pi1, double & e0, double & e1) {
+    e0 = mask * (recall * pi0 + (1.0 - recall) * (1.0 - pi0)) + (1.0 - mask);
+    e1 = mask * (recall * pi1 + (1.0 - recall) * (1.0 - pi1)) + (1.0 - mask);
+}
+
+
+// the forward pass over a block: alpha0 and alpha1[step * STUDENT_LANES + lane] are the probabilities of the unlearned and 
+// learned states given the lane's responses up to and including the step, and scales the probability of the step's response 
+// given the earlier ones. returns the block's log likelihood. the filter is the one MixtureWCRP's likelihoods run
+static double forward_block(const struct bkt_parameters & params, const double * recalls, const double * masks, const size_t num_steps, double * alpha0, double * alpha1, double * scales) {
+    const double pi1 = params.pi1, pi0 = params.pi1 * params.prop0, mu = params.mu, psi = params.psi;
+    double likelihood[STUDENT_LANES], ll = 0.0;
+    for (size_t lane = 0; lane < STUDENT_LANES; lane++) {
+        double e0, e1;
+        emissions(recalls[lane], masks[lane], pi0, pi1, e0, e1);
+        const double a0 = (1.0 - psi) * e0, a1 = psi * e1;
+        scales[lane] = likelihood[lane] = a0 + a1;
+        alpha0[lane] = a0 / scales[lane];
+        alpha1[lane] = a1 / scales[lane];
+    }
+    for (size_t step = 1; step < num_steps; step++) {
+        const size_t offset = step * STUDENT_LANES;
+        for (size_t lane = 0; lane < STUDENT_LANES; lane++) {
+            double e0, e1;
+            emissions(recalls[offset + lane], masks[offset + lane], pi0, pi1, e0, e1);
+            const double prev0 = alpha0[offset - STUDENT_LANES + lane], prev1 = alpha1[offset - STUDENT_LANES + lane];
+            const double a0 = prev0 * (1.0 - mu) * e0, a1 = (prev0 * mu + prev1) * e1;
+            const double scale = a0 + a1;
+            scales[offset + lane] = scale;
+            alpha0[offset + lane] = a0 / scale;
+            alpha1[offset + lane] = a1 / scale;
+            likelihood[lane] *= scale;
+        }
+        if ((step + 1) % LIKELIHOOD_FOLD_STEPS == 0) {
+            for (size_t lane = 0; lane < STUDENT_LANES; lane++) {
+                ll += log(likelihood[lane]);
+                likelihood[lane] = 1.0;
+            }
+        }
+    }
+    for (size_t lane = 0; lane < STUDENT_LANES; lane++) ll += log(likelihood[lane]);
+    return ll;
+}
+
+
+
+// the backward pass over a block after forward_block, adding the expected counts of its knowledge states. with scaled forward
+// probabilities, a step's state probabilities are alpha * beta, and beta stays 1 over the padding
+static void add_expected_counts(const struct bkt_parameters & params, const double * recalls, const double * masks, const size_t num_steps, const double * alpha0, const double * alpha1, const double * scales, struct bkt_counts & counts) {
+    const double pi1 = params.pi1, pi0 = params.pi1 * params.prop0, mu = params.mu;
+    double beta0[STUDENT_LANES], beta1[STUDENT_LANES];
+    double unlearned_steps[STUDENT_LANES] = {0.0}, learned_next[STUDENT_LANES] = {0.0};
+    double learned_total[STUDENT_LANES] = {0.0}, learned_correct[STUDENT_LANES] = {0.0}, unlearned_total[STUDENT_LANES] = {0.0}, unlearned_correct[STUDENT_LANES] = {0.0};
+    for (size_t lane = 0; lane < STUDENT_LANES; lane++) beta0[lane] = beta1[lane] = 1.0;
+
+    for (size_t step = num_steps - 1; step > 0; step--) {
+        const size_t offset = step * STUDENT_LANES;
+        for (size_t lane = 0; lane < STUDENT_LANES; lane++) {
+            const double recall = recalls[offset + lane], mask = masks[offset + lane];
+            const double gamma0 = alpha0[offset + lane] * beta0[lane], gamma1 = alpha1[offset + lane] * beta1[lane];
+            learned_total[lane] += mask * gamma1;
+            learned_correct[lane] += mask * recall * gamma1;
+            unlearned_total[lane] += mask * gamma0;
+            unlearned_correct[lane] += mask * recall * gamma0;
+
+            // the transition into this step from the unlearned state
+            double e0, e1;
+            emissions(recall, mask, pi0, pi1, e0, e1);
+            const double prev0 = alpha0[offset - STUDENT_LANES + lane];
+            const double to0 = (1.0 - mu) * e0 * beta0[lane] / scales[offset + lane], to1 = mu * e1 * beta1[lane] / scales[offset + lane];
+            unlearned_steps[lane] += mask * prev0 * (to0 + to1);
+            learned_next[lane] += mask * prev0 * to1;
+            beta0[lane] = to0 + to1;
+            beta1[lane] = e1 * beta1[lane] / scales[offset + lane];
+        }
+    }
+
+    for (size_t lane = 0; lane < STUDENT_LANES; lane++) {
+        const double recall = recalls[lane], mask = masks[lane];
+        const double gamma0 = alpha0[lane] * beta0[lane], gamma1 = alpha1[lane] * beta1[lane];
+        counts.first_total += mask;
+        counts.first_learned += mask * gamma1;
+        counts.learned_total += learned_total[lane] + mask * gamma1;
+        counts.learned_correct += learned_correct[lane] + mask * recall * gamma1;
+        counts.unlearned_total += unlearned_total[lane] + mask * gamma0;
+        counts.unlearned_correct += unlearned_correct[lane] + mask * recall * gamma0;
+        counts.unlearned_steps += unlearned_steps[lane];
+        counts.learned_next += learned_next[lane];
+    }
+}
+
+
+// draws the knowledge states of each lane after forward_block, last step first (forward filtering backward sampling), and adds
+// their counts. a student who has learned the skill can't unlearn it, so only a learned state has a choice of predecessor
+static void add_sampled_counts(Random * generator, const struct bkt_parameters & params, const double * recalls, const double * masks, const size_t num_steps, const double * alpha0, const double * alpha1, struct bkt_counts & counts) {
+    for (size_t lane = 0; lane < STUDENT_LANES; lane++) {
+        bool learned = generator->sampleBernoulli(alpha1[(num_steps - 1) * STUDENT_LANES + lane]);
+        for (size_t step = num_steps - 1; ; step--) {
+            const size_t idx = step * STUDENT_LANES + lane;
+            const bool is_trial = masks[idx] > 0.0;
+            if (is_trial && learned) {
+                counts.learned_total++;
+                counts.learned_correct += recalls[idx];
+            }
+            else if (is_trial) {
+                counts.unlearned_total++;
+                counts.unlearned_correct += recalls[idx];
+            }
+            if (step == 0) {
+                if (is_trial) {
+                    counts.first_total++;
+                    counts.first_learned += learned;
+                }
+                break;
+            }
+
+            const bool next_learned = learned;
+            if (next_learned) {
+                const double prev0 = alpha0[idx - STUDENT_LANES], prev1 = alpha1[idx - STUDENT_LANES];
+                learned = generator->sampleBernoulli(prev1 / (prev1 + prev0 * params.mu));
+            }
+            if (is_trial && !learned) {
+                counts.unlearned_steps++;
+                counts.learned_next += next_learned;
+            }
+        }
+    }
+}
+
+
+// the EM update: psi, mu, pi1 and pi0 = prop0 * pi1 are the expected proportions. if that puts pi0 above pi1, the constrained
+// maximum has pi0 = pi1, at the pooled accuracy of both states. a parameter the counts say nothing about is left as it is
+static void maximize_parameters(const struct bkt_counts & counts, struct bkt_parameters & params) {
+    if (counts.first_total > 0.0) params.psi = clip_parameter(counts.first_learned / counts.first_total);
+    if (counts.unlearned_steps > 0.0) params.mu = clip_parameter(counts.learned_next / counts.unlearned_steps);
+    if (counts.learned_total + counts.unlearned_total <= 0.0) return;
+
+    double pi1 = (counts.learned_total > 0.0) ? counts.learned_correct / counts.learned_total : params.pi1;
+    double pi0 = (counts.unlearned_total > 0.0) ? counts.unlearned_correct / counts.unlearned_total : params.pi1 * params.prop0;
+    if (pi0 > pi1) pi0 = pi1 = (counts.learned_correct + counts.unlearned_correct) / (counts.learned_total + counts.unlearned_total);
+    params.pi1 = clip_parameter(pi1);
+    params.prop0 = clip_parameter(pi0 / params.pi1);
+}
+
+
+// the log likelihood of the counted responses
+static double emission_log_likelihood(const struct bkt_parameters & params, const struct bkt_counts & counts) {
+    const double pi1 = params.pi1, pi0 = params.pi1 * params.prop0;
+    return counts.learned_correct * log(pi1) + (counts.learned_total - counts.learned_correct) * log(1.0 - pi1) 
+        + counts.unlearned_correct * log(pi0) + (counts.unlearned_total - counts.unlearned_correct) * log(1.0 - pi0);
+}
+
+
+// a slice sampling update of pi1 or prop0 given the knowledge states, as MixtureWCRP::slice_resample_bkt_parameter does given 
+// the responses alone. with the counts, each evaluation is O(1)
+static void slice_resample_emission(Random * generator, struct bkt_parameters & params, double * param, const struct bkt_counts & counts) {
+
+    const double lower_bound = TOL;
+    const double upper_bound = ONEMINUSTOL;
+    const double initial_bracket_width = (upper_bound - lower_bound) / 10.0;
+    const double cur_val = *param;
+    const double jittered_cur_ll = emission_log_likelihood(params, counts) + log(generator->sampleUniform01());
+    const double split_location = generator->sampleUniform01();
+    double x_l = max(lower_bound, cur_val - split_location * initial_bracket_width);
+    double x_r = min(upper_bound, cur_val + (1.0 - split_location) * initial_bracket_width);
+
+    *param = x_l;
+    while (x_l >= lower_bound && emission_log_likelihood(params, counts) > jittered_cur_ll) {
+        x_l -= initial_bracket_width;
+        *param = x_l;
+    }
+    x_l = max(x_l, lower_bound);
+
+    *param = x_r;
+    while (x_r <= upper_bound && emission_log_likelihood(params, counts) > jittered_cur_ll) {
+        x_r += initial_bracket_width;
+        *param = x_r;
+    }
+    x_r = min(x_r, upper_bound);
+
+    while (true) {
+        *param = x_l + (x_r - x_l) * generator->sampleUniform01();
+        if (emission_log_likelihood(params, counts) > jittered_cur_ll) return;
+        if (*param > cur_val) x_r = *param;
+        else if (*param < cur_val) x_l = *param;
+        else return;
+    }
+}
+
+
+// the data augmentation update: with the knowledge states known and uniform priors, psi and mu have Beta conditionals (clipped 
+// to the prior's bounds) and pi1 and prop0 are slice sampled
+static void sample_parameters(Random * generator, const struct bkt_counts & counts, struct bkt_parameters & params) {
+    params.psi = clip_parameter(generator->sampleBeta(1.0 + counts.first_learned, 1.0 + counts.first_total - counts.first_learned));
+    params.mu = clip_parameter(generator->sampleBeta(1.0 + counts.learned_next, 1.0 + counts.unlearned_steps - counts.learned_next));
+    slice_resample_emission(generator, params, &params.pi1, counts);
+    slice_resample_emission(generator, params, &params.prop0, counts);
+}
+
+
+FixedSkillBKT::FixedSkillBKT(const Dataset & dataset, const vector<size_t> & skill_labels, const set<size_t> & train_students, const size_t num_threads) :
+    num_threads(num_threads) {
+
+    assert(num_threads > 0);
+    assert(skill_labels.size() >= dataset.get_num_items());
+    const size_t num_skills = 1 + *max_element(skill_labels.begin(), skill_labels.begin() + dataset.get_num_items());
+
+    // each training student's responses to each skill's items, in order
+    vector< vector< vector<bool> > > sequences(num_skills); // sequences[skill][k] = the k-th student's responses
+    for (size_t student = 0; student < dataset.get_num_students(); student++) {
+        if (!train_students.count(student)) continue;
+        boost::unordered_map<size_t, vector<bool> > student_sequences;
+        const vector<size_t> & item_sequence = dataset.get_item_sequences().at(student);
+        for (size_t trial = 0; trial < item_sequence.size(); trial++) student_sequences[skill_labels.at(item_sequence[trial])].push_back(dataset.get_recall_sequences()[student][trial]);
+        for (boost::unordered_map<size_t, vector<bool> >::iterator itr = student_sequences.begin(); itr != student_sequences.end(); itr++) sequences[itr->first].push_back(itr->second);
+    }
+
+    // lay them out in blocks of STUDENT_LANES students of similar lengths
+    skills.resize(num_skills);
+    for (size_t skill = 0; skill < num_skills; skill++) {
+        vector< vector<bool> > & skill_sequences = sequences[skill];
+        sort(skill_sequences.begin(), skill_sequences.end(), longer);
+        skill_blocks & blocks = skills[skill];
+        size_t num_steps = 0;
+        for (size_t first = 0; first < skill_sequences.size(); first += STUDENT_LANES) {
+            num_steps += skill_sequences[first].size();
+            blocks.block_ends.push_back(num_steps);
+        }
+        blocks.recalls.assign(num_steps * STUDENT_LANES, 0.0);
+        blocks.masks.assign(num_steps * STUDENT_LANES, 0.0);
+        size_t block_begin = 0;
+        for (size_t block = 0; block < blocks.block_ends.size(); block++) {
+            for (size_t lane = 0; lane < STUDENT_LANES && block * STUDENT_LANES + lane < skill_sequences.size(); lane++) {
+                const vector<bool> & sequence = skill_sequences[block * STUDENT_LANES + lane];
+                for (size_t step = 0; step < sequence.size(); step++) {
+                    blocks.recalls[(block_begin + step) * STUDENT_LANES + lane] = sequence[step];
+                    blocks.masks[(block_begin + step) * STUDENT_LANES + lane] = 1.0;
+                }
+            }
+            block_begin = blocks.block_ends[block];
+        }
+        skill_order.push_back(skill);
+    }
+
+    // the threads take every num_threads-th skill, from the longest down
+    vector< pair<size_t, size_t> > sizes;
+    for (size_t skill = 0; skill < num_skills; skill++) sizes.push_back(make_pair(skills[skill].recalls.size(), skill));
+    sort(sizes.rbegin(), sizes.rend());
+    for (size_t idx = 0; idx < num_skills; idx++) skill_order[idx] = sizes[idx].second;
+}
+
+
+size_t FixedSkillBKT::get_num_skills() const {
+    return skills.size();
+}
+
+
+void FixedSkillBKT::update_skills(const size_t first_skill, const skill_update update, vector<struct bkt_parameters> & parameters, const vector<unsigned int> & seeds, vector<double> & skill_lls) const {
+    vector<double> alpha0, alpha1, scales; // the thread's scratch, grown to its longest block
+    for (size_t idx = first_skill; idx < skill_order.size(); idx += num_threads) {
+        const size_t skill = skill_order[idx];
+        const skill_blocks & blocks = skills[skill];
+        struct bkt_parameters & params = parameters.at(skill);
+        Random * skill_generator = (update == UPDATE_SAMPLE) ? new Random(seeds.at(skill)) : NULL;
+
+        struct bkt_counts counts = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+        double ll = 0.0;
+        size_t block_begin = 0;
+        for (size_t block = 0; block < blocks.block_ends.size(); block++) {
+            const size_t num_steps = blocks.block_ends[block] - block_begin;
+            if (alpha0.size() < num_steps * STUDENT_LANES) {
+                alpha0.resize(num_steps * STUDENT_LANES);
+                alpha1.resize(num_steps * STUDENT_LANES);
+                scales.resize(num_steps * STUDENT_LANES);
+            }
+            const double * recalls = &blocks.recalls[block_begin * STUDENT_LANES];
+            const double * masks = &blocks.masks[block_begin * STUDENT_LANES];
+            ll += forward_block(params, recalls, masks, num_steps, &alpha0[0], &alpha1[0], &scales[0]);
+            if (update == UPDATE_EM) add_expected_counts(params, recalls, masks, num_steps, &alpha0[0], &alpha1[0], &scales[0], counts);
+            else if (update == UPDATE_SAMPLE) add_sampled_counts(skill_generator, params, recalls, masks, num_steps, &alpha0[0], &alpha1[0], counts);
+            block_begin = blocks.block_ends[block];
+        }
+        skill_lls[skill] = ll;
+
+        if (update == UPDATE_EM) maximize_parameters(counts, params);
+        else if (update == UPDATE_SAMPLE) sample_parameters(skill_generator, counts, params);
+        delete skill_generator;
+    }
+}
+
+
+double FixedSkillBKT::run_update(const skill_update update, vector<struct bkt_parameters> & parameters, const vector<unsigned int> & seeds) const {
+    assert(parameters.size() >= skills.size());
+    vector<double> skill_lls(skills.size(), 0.0);
+    if (num_threads == 1) update_skills(0, update, parameters, seeds, skill_lls);
+    else {
+        vector<thread> workers;
+        for (size_t t = 0; t < min(num_threads, skills.size()); t++) workers.push_back(thread(&FixedSkillBKT::update_skills, this, t, update, ref(parameters), cref(seeds), ref(skill_lls)));
+        for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+    }
+    return accumulate(skill_lls.begin(), skill_lls.end(), 0.0);
+}
+
+
+double FixedSkillBKT::em_step(vector<struct bkt_parameters> & parameters) const {
+    return run_update(UPDATE_EM, parameters, vector<unsigned int>());
+}
+
+
+size_t FixedSkillBKT::fit_em(vector<struct bkt_parameters> & parameters) const {
+    double prev_ll = -INFINITY;
+    for (size_t step = 0; step < EM_MAX_STEPS; step++) {
+        const double ll = em_step(parameters);
+        if (ll - prev_ll < EM_TOL * abs(ll)) return step + 1;
+        prev_ll = ll;
+    }
+    return EM_MAX_STEPS;
+}
+
+
+double FixedSkillBKT::sample_step(Random * generator, vector<struct bkt_parameters> & parameters) const {
+    vector<unsigned int> seeds(skills.size());
+    for (size_t skill = 0; skill < skills.size(); skill++) seeds[skill] = 1 + (unsigned int) generator->sampleUniform(1e9);
+    return run_update(UPDATE_SAMPLE, parameters, seeds);
+}
+
+
+double FixedSkillBKT::log_likelihood(const vector<struct bkt_parameters> & parameters) const {
+    vector<struct bkt_parameters> unchanged(parameters);
+    return run_update(UPDATE_NONE, unchanged, vector<unsigned int>());
+}
+
+#endif
@@ -0,0 +1,170 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef KNOWLEDGE_STATES_CPP
+#define KNOWLEDGE_STATES_CPP
+
+#include "KnowledgeStates.hpp"
+#include "common.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+#define KNOWLEDGE_STATE_MAGIC "WCRPKS01"
+#define KNOWLEDGE_STATE_HEADER_SIZE 24 // magic, num_samples, index_offset
+
+
+static void write_or_die(const void * buffer, const size_t size, const size_t count, FILE * out) {
+    if (fwrite(buffer, size, count, out) != count) {
+        cerr << "couldn't write the knowledge state file" << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+KnowledgeStateWriter::KnowledgeStateWriter(const char * filename) : offset(KNOWLEDGE_STATE_HEADER_SIZE) {
+    out = fopen(filename, "wb");
+    if (!out) {
+        cerr << "couldn't open " << string(filename) << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // the counts are filled in at the end
+    const uint64_t placeholder[2] = {0, 0};
+    write_or_die(KNOWLEDGE_STATE_MAGIC, 1, 8, out);
+    write_or_die(placeholder, sizeof(uint64_t), 2, out);
+}
+
+
+KnowledgeStateWriter::~KnowledgeStateWriter() {
+    const uint64_t index_offset = offset;
+    if (!sample_offsets.empty()) write_or_die(&sample_offsets[0], sizeof(uint64_t), sample_offsets.size(), out);
+
+    const uint64_t counts[2] = {sample_offsets.size(), index_offset};
+    fseek(out, 8, SEEK_SET);
+    write_or_die(counts, sizeof(uint64_t), 2, out);
+    fclose(out);
+}
+
+
+void KnowledgeStateWriter::write_sample(const vector<uint64_t> & row_ends, const vector<knowledge_state_entry> & entries) {
+    assert(row_ends.empty() ? entries.empty() : row_ends.back() == entries.size());
+    sample_offsets.push_back(offset);
+
+    const uint64_t counts[2] = {row_ends.size(), entries.size()};
+    write_or_die(counts, sizeof(uint64_t), 2, out);
+    if (!row_ends.empty()) write_or_die(&row_ends[0], sizeof(uint64_t), row_ends.size(), out);
+    if (!entries.empty()) write_or_die(&entries[0], sizeof(knowledge_state_entry), entries.size(), out);
+    offset += sizeof(uint64_t) * (2 + row_ends.size()) + sizeof(knowledge_state_entry) * entries.size();
+}
+
+
+// exits with a message naming the file unless the condition holds
+static void check_knowledge_state_file(const bool condition, const char * filename) {
+    if (!condition) {
+        cerr << string(filename) << " isn't a valid knowledge state file" << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+KnowledgeStateReader::KnowledgeStateReader(const char * filename) {
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        cerr << "couldn't open " << string(filename) << endl;
+        exit(EXIT_FAILURE);
+    }
+    struct stat file_stat;
+    check_knowledge_state_file(fstat(fd, &file_stat) == 0 && file_stat.st_size >= KNOWLEDGE_STATE_HEADER_SIZE, filename);
+    size = (size_t) file_stat.st_size;
+
+    void * mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    check_knowledge_state_file(mapping != MAP_FAILED, filename);
+    data = (const char *) mapping;
+
+    const uint64_t * header = (const uint64_t *) (data + 8);
+    num_samples = header[0];
+    const uint64_t index_offset = header[1];
+    check_knowledge_state_file(memcmp(data, KNOWLEDGE_STATE_MAGIC, 8) == 0 && index_offset + num_samples * sizeof(uint64_t) <= size, filename);
+    sample_offsets = (const uint64_t *) (data + index_offset);
+
+    // check each sample's extent once, so the accessors can trust the offsets
+    for (size_t sample = 0; sample < num_samples; sample++) {
+        check_knowledge_state_file(sample_offsets[sample] + 2 * sizeof(uint64_t) <= index_offset, filename);
+        const uint64_t * counts = (const uint64_t *) (data + sample_offsets[sample]);
+        const uint64_t end = sample_offsets[sample] + sizeof(uint64_t) * (2 + counts[0]) + sizeof(knowledge_state_entry) * counts[1];
+        check_knowledge_state_file(end <= index_offset && (counts[0] == 0 ? counts[1] == 0 : counts[2 + counts[0] - 1] == counts[1]), filename);
+    }
+}
+
+
+KnowledgeStateReader::~KnowledgeStateReader() {
+    munmap((void *) data, size);
+}
+
+
+size_t KnowledgeStateReader::get_num_samples() const {
+    return num_samples;
+}
+
+
+size_t KnowledgeStateReader::get_num_students(const size_t sample) const {
+    assert(sample < num_samples);
+    return ((const uint64_t *) (data + sample_offsets[sample]))[0];
+}
+
+
+const knowledge_state_entry * KnowledgeStateReader::get_entries(const size_t sample, const size_t student, size_t & num_entries) const {
+    assert(sample < num_samples);
+    const uint64_t * block = (const uint64_t *) (data + sample_offsets[sample]);
+    const uint64_t num_students = block[0];
+    assert(student < num_students);
+    const uint64_t * row_ends = block + 2;
+    const knowledge_state_entry * entries = (const knowledge_state_entry *) (row_ends + num_students);
+    const uint64_t row_begin = (student == 0) ? 0 : row_ends[student - 1];
+    num_entries = row_ends[student] - row_begin;
+    return entries + row_begin;
+}
+
+
+double KnowledgeStateReader::get_p_learned(const size_t sample, const size_t student, const size_t skill) const {
+    size_t num_entries;
+    const knowledge_state_entry * entries = get_entries(sample, student, num_entries);
+    size_t low = 0, high = num_entries;
+    while (low < high) {
+        const size_t mid = (low + high) / 2;
+        if (entries[mid].skill < skill) low = mid + 1;
+        else high = mid;
+    }
+    return (low < num_entries && entries[low].skill == skill) ? entries[low].p_learned : -1.0;
+}
+
+#endif
@@ -28,6 +28,11 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "MixtureWCRP.hpp"
 
+#define GIBBS_TRACE_BATCH 64 // number of consecutive Gibbs steps grouped into one trace event
+#define NUM_RECENT_TRAIN_LL 20 // number of iterations' training log likelihoods reported to the status server
+#define NEVER_STUDIED ((size_t) -1) // first_encounter of a student-item pair that was never studied
+#define SCAN_RATE_DECAY .2 // weight of an item's latest Gibbs step in its move rate under the adaptive scan
+
 using namespace std;
 
 double vector_sum(const vector<double> & vec) {
@@ -35,9 +40,10 @@ double vector_sum(const vector<double> & vec) {
     else return accumulate(vec.begin(), vec.end(), 0.0);
 }
 
-double vector_mean(const vector<double> & vec) {
-    assert(!vec.empty());
-    return vector_sum(vec) / vec.size();
+// log(exp(a) + exp(b))
+inline double log_add(const double a, const double b) {
+    if (a == -INFINITY) return b;
+    return max(a, b) + log1p(exp(-abs(a - b)));
 }
 
 inline bool equals_zero(const double x) {
@@ -78,6 +84,17 @@ double log_new_table_probability(const double log_alpha_prime, const double log_
 }
 
 
+// the variable K as defined in equation 1 in the NIPS paper, for an item with the given expert label joining a table
+// counts maps each expert skill id that occurs at the table to the number of items at the table with that id, n_k^j, and max_count is the largest of them
+double compute_K(const boost::unordered_map<size_t, int> & counts, const int max_count, const size_t item_expert_label, const double gamma, const size_t num_expert_provided_skills) {
+    const bool has_item_expert_label = (counts.find(item_expert_label) != counts.end());
+    const double numerator_K = (has_item_expert_label) ? pow(gamma, max_count - counts.at(item_expert_label)) : pow(gamma, max_count);
+    double denominator_K =  (num_expert_provided_skills - counts.size()) * pow(gamma, max_count); // the n_k^j == 0 cases
+    for (boost::unordered_map<size_t, int>::const_iterator count_itr = counts.begin(); count_itr != counts.end(); count_itr++) denominator_K += pow(gamma, max_count - count_itr->second); // the n_k^j != 0 cases
+    return numerator_K / denominator_K;
+}
+
+
 // compute the variable K as defined in equation 1 in the NIPS paper
 // when generative_mode = false, this function assumes that the item has not been assigned to a table yet
 double MixtureWCRP::compute_K(const size_t item, const size_t table_id, const bool generative_mode) const {
@@ -85,7 +102,6 @@ double MixtureWCRP::compute_K(const size_t item, const size_t table_id, const bo
     assert(generative_mode || seating_arrangement.at(item) == UNASSIGNED);
     const double gamma = exp(log_gamma);
     const size_t end_idx = (generative_mode) ? item : num_items;
-    const size_t item_expert_label = provided_skill_assignments.at(item);
 
     // for each expert skill id that occurs at this table, count the number of items at this table with that id, n_k^j, for all k
     boost::unordered_map<size_t, int> counts; // mapping b/w expert skill id => # of items at this table with that id
@@ -93,7 +109,7 @@ double MixtureWCRP::compute_K(const size_t item, const size_t table_id, const bo
     int max_count = 0;
     for (size_t other_item = 0; other_item < end_idx; other_item++) {
         if (item != other_item && seating_arrangement.at(other_item) == table_id) { // if customer k is sitting at this table
-            const size_t expert_label = provided_skill_assignments.at(other_item);
+            const size_t expert_label = dataset->get_provided_skill_labels().at(other_item);
             if (counts.find(expert_label) == counts.end()) counts[expert_label] = 1;
             else counts[expert_label]++;
 
@@ -101,11 +117,30 @@ double MixtureWCRP::compute_K(const size_t item, const size_t table_id, const bo
         }
     }
 
-    const bool has_item_expert_label = (counts.find(item_expert_label) != counts.end());
-    const double numerator_K = (has_item_expert_label) ? pow(gamma, max_count - counts.at(item_expert_label)) : pow(gamma, max_count);
-    double denominator_K =  (num_expert_provided_skills - counts.size()) * pow(gamma, max_count); // the n_k^j == 0 cases
-    for (boost::unordered_map<size_t, int>::const_iterator count_itr = counts.begin(); count_itr != counts.end(); count_itr++) denominator_K += pow(gamma, max_count - count_itr->second); // the n_k^j != 0 cases
-    return numerator_K / denominator_K;
+    return ::compute_K(counts, max_count, dataset->get_provided_skill_labels().at(item), gamma, num_expert_provided_skills);
+}
+
+
+// with a single expert-provided skill K is always 1, and with gamma = 1 (beta = 0) K drops out of equation 1. either way the 
+// WCRP is a CRP with concentration alpha' * gamma, which is the case without --expertfile
+bool MixtureWCRP::is_plain_crp() const {
+    return num_expert_provided_skills == 1 || log_gamma == 0.0;
+}
+
+
+// log(proportional to equation 1 in the NIPS paper) for the unassigned item joining the table. in a plain CRP this is 
+// log(n / num_expert_provided_skills), which skips compute_K's scan over all items
+double MixtureWCRP::old_table_seating_lp(const size_t item, const size_t table_id) const {
+    if (is_plain_crp()) return log(1.0 * table_sizes.at(table_id)) - log(1.0 * num_expert_provided_skills);
+    return log_old_table_probability(table_sizes.at(table_id), compute_K(item, table_id, false), log_gamma, num_expert_provided_skills);
+}
+
+bkt_fit_method parse_bkt_fit_method(const string & name) {
+    if (name == "slice") return BKT_SLICE_SAMPLING;
+    if (name == "em") return BKT_EM;
+    if (name == "augmentation") return BKT_DATA_AUGMENTATION;
+    cerr << "unknown BKT fit method " << name << " (expected slice, em or augmentation)" << endl;
+    exit(EXIT_FAILURE);
 }
 
 /////////////////////////////////////////////////
@@ -114,100 +149,83 @@ double MixtureWCRP::compute_K(const size_t item, const size_t table_id, const bo
 
 
 // object constructor
-MixtureWCRP::MixtureWCRP(Random * generator, 
-                         const set<size_t> & train_students, 
-                         const vector< vector<bool> > & recall_sequences, 
-                         const vector< vector<size_t> > & item_sequences, 
-                         const vector<size_t> & provided_skill_assignments, 
-                         const double beta, 
-                         const double init_alpha_prime, 
-                         const size_t num_students, 
-                         const size_t num_items, 
-                         const size_t num_subsamples) :
+MixtureWCRP::MixtureWCRP(Random * generator, const Dataset & dataset, const wcrp_config & config) :
                          
  generator(generator), 
- train_students(train_students), 
- recall_sequences(recall_sequences), 
- item_sequences(item_sequences), 
- provided_skill_assignments(provided_skill_assignments), 
- num_students(num_students), 
- num_items(num_items), 
- num_subsamples(num_subsamples), 
- use_expert_labels(equals_one(beta)), 
- log_gamma(log(1.0 - beta)), 
+ dataset(&dataset), 
+ train_all_students(config.train_students.empty()), 
+ train_students(config.train_students), 
+ num_students(0), 
+ num_items(0), 
+ num_subsamples(config.num_subsamples), 
+ use_expert_labels(equals_one(config.beta)), 
+ log_gamma(log(1.0 - config.beta)), 
  num_used_skills(0), 
- tables_ever_instantiated(UNASSIGNED+1) {
+ tables_ever_instantiated(UNASSIGNED+1), 
+ max_batched_table_size(MAX_BATCHED_TABLE_SIZE), 
+ prune_log_tolerance(LOG_TOL), 
+ tables_considered(0), 
+ tables_pruned(0), 
+ approximate_top_k(config.approximate_top_k), 
+ approximate_steps(0), 
+ approximate_rejections(0), 
+ adaptive_scan_floor(config.adaptive_scan_floor), 
+ bkt_fit(config.bkt_fit), 
+ num_threads(config.num_threads), 
+ fixed_skill_fitter(NULL), 
+ sample_sink(&memory_sink), 
+ progress_stream(&cout), 
+ perf_counters(NULL), 
+ track_allocations(false), 
+ status_server(NULL), 
+ knowledge_state_writer(NULL), 
+ coassignment(NULL) {
 
     // for legacy reasons, i define gamma = 1.0 - beta and do inference on log_gamma
-    const double gamma = 1.0 - beta;
+    const double beta = config.beta;
+    const double init_alpha_prime = config.init_alpha_prime;
+    const size_t num_students = dataset.get_num_students();
+    const size_t num_items = dataset.get_num_items();
 
-    assert(!train_students.empty() );
-    assert(!provided_skill_assignments.empty());
+    assert(num_students > 0 && num_items > 0);
     assert(beta >= 0 && beta <= 1);
+    if (train_all_students) {
+        for (size_t student = 0; student < num_students; student++) train_students.insert(student);
+    }
+    assert(!train_students.empty());
 
-    num_expert_provided_skills = 1 + *max_element(provided_skill_assignments.begin(), provided_skill_assignments.end());
-
-    // the variable all_items will be useful during gibbs sampling
-    all_items.resize(num_items);
-    for (size_t i = 0; i < num_items; i++) all_items[i] = i;
+    num_expert_provided_skills = 1 + *max_element(dataset.get_provided_skill_labels().begin(), dataset.get_provided_skill_labels().begin() + num_items);
 
     // to avoid unnecessary work during MCMC, for each student-item pair, figure out the trial index it was first studied
-    first_encounter.resize(num_students);
-    item_and_recall_sequences.resize(num_students);
-    trials_studied.resize(num_students);
+    // and figure out which students studied which items in the training data
+    grow_dataset(num_students, num_items);
     for (size_t student = 0; student < num_students; student++) {
-        first_encounter[student].resize(num_items, item_sequences.at(student).size());
-        item_and_recall_sequences[student].resize(item_sequences.at(student).size());
-        trials_studied[student].resize(num_items);
-        for (size_t trial = 0; trial < item_sequences.at(student).size(); trial++) {
-            const size_t item = item_sequences.at(student).at(trial);
-            assert(item < num_items);
-            first_encounter[student][item] = min(trial, first_encounter.at(student).at(item));
-            item_and_recall_sequences[student][trial] = make_pair(item, recall_sequences.at(student).at(trial));
-            trials_studied[student][item].push_back(trial);
-        }
+        const bool is_training = train_students.count(student);
+        item_and_recall_sequences[student].reserve(dataset.get_item_sequences().at(student).size());
+        for (size_t trial = 0; trial < dataset.get_item_sequences().at(student).size(); trial++) index_trial(student, trial, is_training);
     }
 
-    // to avoid unnecessary work during MCMC, figure out which students studied which items in the training data
-    ever_studied.resize(num_students); // training students only. sloppy notation
-    pRT_samples.resize(num_students);
-    for (size_t student = 0; student < num_students; student++) {
-        pRT_samples[student].resize(recall_sequences.at(student).size());
-        ever_studied[student].resize(num_items, false);
-        if (train_students.count(student)) {
-            for (size_t trial = 0; trial < item_sequences.at(student).size(); trial++) {
-                const size_t item = item_sequences.at(student).at(trial);
-                ever_studied[student][item] = true;
-            }
-        }
+    seating_arrangement.resize(num_items, UNASSIGNED);
+    if (!config.checkpoint_file.empty()) {
+        // continue the chain saved by save_checkpoint
+        load_checkpoint(config.checkpoint_file.c_str());
     }
-
-    students_who_studied.resize(num_items);
-    all_first_encounters.resize(num_items);
-    for (size_t item = 0; item < num_items; item++) {
-        for (size_t student = 0; student < num_students; student++) {
-            if (ever_studied.at(student).at(item)) { // sloppy notation. this'll only ever be true for training students
-                students_who_studied[item].push_back(student);
-                all_first_encounters[item].push_back(first_encounter.at(student).at(item));
-            }
+    else {
+        // initialize alpha'
+        // if init_alpha_prime < 0, it's a special flag indicating that we should sample it to initialize
+        if (init_alpha_prime < 0) log_alpha_prime = log(generator->sampleGamma(HYPER_AP1, HYPER_AP2)); // sample value
+        else log_alpha_prime = log(init_alpha_prime); // fix value
+
+        // initialize the seating arrangement to the expert provided skills
+        set<size_t> skills_encountered;
+        for (size_t item = 0; item < num_items; item++) {
+            const size_t table_id = 1 + dataset.get_provided_skill_labels().at(item);
+            assign_item_to_table(item, table_id, !skills_encountered.count(table_id));
+            skills_encountered.insert(table_id);
         }
+        tables_ever_instantiated += num_expert_provided_skills + 1; // +1 necessary?
     }
 
-    // initialize alpha'
-    // if init_alpha_prime < 0, it's a special flag indicating that we should sample it to initialize
-    if (init_alpha_prime < 0) log_alpha_prime = log(generator->sampleGamma(HYPER_AP1, HYPER_AP2)); // sample value
-    else log_alpha_prime = log(init_alpha_prime); // fix value
-
-    // initialize the seating arrangement to the expert provided skills
-    seating_arrangement.resize(num_items, UNASSIGNED);
-    set<size_t> skills_encountered;
-    for (size_t item = 0; item < num_items; item++) {
-        const size_t table_id = 1 + provided_skill_assignments.at(item);
-        assign_item_to_table(item, table_id, !skills_encountered.count(table_id));
-        skills_encountered.insert(table_id);
-    }
-    tables_ever_instantiated += num_expert_provided_skills + 1; // +1 necessary?
-
     // sanity check
     size_t num_missing = 0;
     for (size_t item = 0; item < num_items; item++) {
@@ -216,7 +234,8 @@ MixtureWCRP::MixtureWCRP(Random * generator,
     if (num_missing > 0) cerr << "warning: " << num_missing << " of " << num_items << " items have no training data" << endl;
 
     // precompute the marginal likelihood of each item if it were a singleton skill
-    if (!use_expert_labels) {
+    // (a checkpoint may already have provided them)
+    if (!use_expert_labels && singleton_skill_data_lp.empty()) {
         //cout << "precomputing all possible singleton skill marginal likelihoods" << endl;
         singleton_skill_data_lp.resize(num_items);
 
@@ -224,86 +243,665 @@ MixtureWCRP::MixtureWCRP(Random * generator,
         for (size_t subsample = 0; subsample < num_subsamples; subsample++) draw_bkt_param_prior(prior_samples[subsample]);
 
         for (size_t item = 0; item < num_items; item++) {
-            const vector<size_t> & affected_students = students_who_studied.at(item);
-            const vector<size_t> & first_exposures = all_first_encounters.at(item);
             const size_t cur_table_id = seating_arrangement.at(item);
 
             // temporarily unassign the item from its table
             const bool deleted_table = remove_item_from_table(item, cur_table_id);
 
-            // create a singleton skill with this item
-            const size_t tmp_table_id = tables_ever_instantiated++;
-            assign_item_to_table(item, tmp_table_id, true);
-
-            // record the log likelihood for this singleton skill under each draw from the prior
-            singleton_skill_data_lp[item].resize(num_subsamples);
-            for (size_t subsample = 0; subsample < num_subsamples; subsample++) {
-                parameters[tmp_table_id] = prior_samples[subsample];
-                singleton_skill_data_lp[item][subsample] = skill_log_likelihood(tmp_table_id, affected_students, first_exposures);
-            }
-
-            // delete the singleton skill
-            remove_item_from_table(item, tmp_table_id);
+            compute_singleton_skill_data_lp(item);
 
             // reassign the item to its original table
             if (!deleted_table) assign_item_to_table(item, cur_table_id, false);
             else assign_item_to_table(item, tables_ever_instantiated++, true);
         }
     }
+
+    if (approximate_top_k > 0 && !use_expert_labels) build_sketches();
 }
 
 
-// object destructor
 MixtureWCRP::~MixtureWCRP() {
-
+    delete perf_counters;
+    delete knowledge_state_writer;
+    delete fixed_skill_fitter;
+    delete coassignment;
 }
 
 
-// returns the expected posterior probability that the student responds correctly to the trial number 
 double MixtureWCRP::get_estimated_recall_prob(const size_t student, const size_t trial) const {
-    assert(!pRT_samples.at(student).at(trial).empty()); // need to have called run_mcmc first
-    return vector_mean(pRT_samples.at(student).at(trial));
+    return memory_sink.get_estimated_recall_prob(student, trial);
 }
 
 
-// returns the skill assignments for each item across all samples
-// each returned vector has one entry per item denoting the skill id
 vector< vector<size_t> > MixtureWCRP::get_sampled_skill_labels() const {
-    assert(!skill_label_samples.empty()); // need to have called run_mcmc first
-    return skill_label_samples;
+    return memory_sink.get_sampled_skill_labels();
 }
 
 
-// returns the skill assignments which maximized the training data log likelihood 
-// the returned vector has one entry per item denoting the skill id
 vector<size_t> MixtureWCRP::get_most_likely_skill_labels() const {
-    assert(!skill_label_samples.empty()); // need to have called run_mcmc first
-    assert(train_ll_samples.size() == skill_label_samples.size());
+    return memory_sink.get_most_likely_skill_labels();
+}
+
+
+vector< vector<struct bkt_parameters> > MixtureWCRP::get_sampled_skill_parameters() const {
+    return memory_sink.get_sampled_skill_parameters();
+}
+
+
+vector<double> MixtureWCRP::get_train_ll_samples() const {
+    return memory_sink.get_train_ll_samples();
+}
+
+
+void MixtureWCRP::get_sampled_wcrp_hyperparameters(vector<double> & log_alpha_primes, vector<double> & log_gammas) const {
+    memory_sink.get_sampled_wcrp_hyperparameters(log_alpha_primes, log_gammas);
+}
+
+
+void MixtureWCRP::set_sample_sink(SampleSink * sink) {
+    sample_sink = sink ? sink : &memory_sink;
+}
+
+
+void MixtureWCRP::add_observer(ChainObserver * observer) {
+    assert(observer);
+    observers.push_back(observer);
+}
+
+
+void MixtureWCRP::set_progress_stream(ostream * out) {
+    progress_stream = out;
+}
+
+
+void MixtureWCRP::get_current_sample(chain_sample & sample) const {
+    boost::unordered_map<size_t, int> skill_labels;
+    label_skills(sample, skill_labels);
+    sample.iteration = 0;
+    sample.train_ll = 0.0;
+}
+
+
+double MixtureWCRP::get_pruned_fraction() const {
+    return tables_considered == 0 ? 0.0 : 1.0 * tables_pruned / tables_considered;
+}
+
+
+double MixtureWCRP::get_rejection_rate() const {
+    return approximate_steps == 0 ? 0.0 : 1.0 * approximate_rejections / approximate_steps;
+}
+
+
+size_t MixtureWCRP::get_num_skills() const {
+    return extant_tables.size();
+}
+
+
+double MixtureWCRP::get_alpha_prime() const {
+    return exp(log_alpha_prime);
+}
+
+
+double MixtureWCRP::get_beta() const {
+    return 1.0 - exp(log_gamma);
+}
+
+
+const Dataset & MixtureWCRP::get_dataset() const {
+    return *dataset;
+}
+
+
+// makes run_mcmc print the wall-clock time and hardware event counts of each phase of every iteration
+void MixtureWCRP::enable_perf_counters() {
+    if (perf_counters) return;
+    perf_counters = new PerfCounters();
+    if (!perf_counters->available()) cerr << "hardware performance counters are unavailable (see /proc/sys/kernel/perf_event_paranoid). only reporting wall-clock timings" << endl;
+}
+
+
+// makes run_mcmc print the number of heap allocations, frees and bytes allocated in each phase of every iteration
+void MixtureWCRP::enable_allocation_tracking() {
+    if (!allocation_tracking_available()) {
+        cerr << "warning: this program wasn't linked with the allocation hooks, so no allocations will be counted" << endl;
+        return;
+    }
+    allocation_tracking_enable();
+    track_allocations = true;
+}
+
+
+bool MixtureWCRP::timing_phases() const {
+    return perf_counters || track_allocations || status_server || trace_enabled();
+}
+
+
+void MixtureWCRP::begin_phase() {
+    if (perf_counters) perf_counters->read(phase_begin_counts);
+    if (track_allocations) phase_begin_allocations = read_allocation_counts();
+    if (timing_phases()) phase_begin_time = get_wall_time();
+}
+
+
+void MixtureWCRP::end_phase(const sampler_phase phase) {
+    if (!timing_phases()) return;
+    const double phase_end_time = get_wall_time();
+    trace_complete(sampler_phase_names[phase], "phase", phase_begin_time, phase_end_time);
+    phase_seconds[phase] = phase_end_time - phase_begin_time;
+    if (track_allocations) phase_allocations[phase] = allocation_difference(read_allocation_counts(), phase_begin_allocations);
+    if (perf_counters) {
+        perf_counts now;
+        perf_counters->read(now);
+        phase_counts[phase] = PerfCounters::difference(now, phase_begin_counts);
+    }
+}
+
+
+// prints to the progress stream one line per phase of the iteration that just finished, then a line with the iteration's totals:
+// phase, iter, phase name, sec., then each hardware event's count and/or the allocation counts
+void MixtureWCRP::print_phase_report(const size_t iter) const {
+    if (!progress_stream || (!perf_counters && !track_allocations)) return;
+    ostream & out = *progress_stream;
+    if (iter == 0) {
+        out << "phase\titer\tphase\tsec.";
+        if (perf_counters) {
+            for (size_t event = 0; event < NUM_PERF_EVENTS; event++) out << "\t" << perf_event_names[event];
+        }
+        if (track_allocations) out << "\tallocations\tfrees\tbytes_allocated";
+        out << endl;
+    }
+
+    double total_seconds = 0;
+    perf_counts total_counts;
+    allocation_counts total_allocations = {0, 0, 0};
+    for (size_t event = 0; event < NUM_PERF_EVENTS; event++) total_counts.values[event] = 0;
+
+    for (size_t phase = 0; phase <= NUM_SAMPLER_PHASES; phase++) {
+        const bool is_total = phase == NUM_SAMPLER_PHASES;
+        const double seconds = is_total ? total_seconds : phase_seconds[phase];
+        const perf_counts & counts = is_total ? total_counts : phase_counts[phase];
+        const allocation_counts & allocations = is_total ? total_allocations : phase_allocations[phase];
+
+        out << "phase\t" << (iter+1) << "\t" << (is_total ? "total" : sampler_phase_names[phase]) << "\t" << setprecision(4) << seconds;
+        if (perf_counters) {
+            for (size_t event = 0; event < NUM_PERF_EVENTS; event++) {
+                if (counts.values[event] < 0) out << "\tNA";
+                else out << "\t" << counts.values[event];
+            }
+        }
+        if (track_allocations) out << "\t" << allocations.allocations << "\t" << allocations.deallocations << "\t" << allocations.bytes;
+        out << endl;
+
+        if (!is_total) {
+            total_seconds += seconds;
+            if (perf_counters) total_counts = PerfCounters::sum(total_counts, counts);
+            if (track_allocations) {
+                total_allocations.allocations += allocations.allocations;
+                total_allocations.deallocations += allocations.deallocations;
+                total_allocations.bytes += allocations.bytes;
+            }
+        }
+    }
+}
+
+// makes gibbs_resample_skill record the wall time and work of every step, per item
+void MixtureWCRP::enable_item_profile() {
+    item_costs.assign(num_items, item_cost());
+    for (size_t item = 0; item < num_items; item++) {
+        item_costs[item].num_steps = 0;
+        item_costs[item].seconds = 0;
+        item_costs[item].tables_scored = 0;
+        update_item_work(item);
+    }
+}
+
+
+// the work a Gibbs step on the item does, which changes whenever a training student who studied it gets new trials
+void MixtureWCRP::update_item_work(const size_t item) {
+    item_cost & cost = item_costs.at(item);
+    cost.affected_students = students_who_studied.at(item).size();
+    cost.trials_touched = 0;
+    for (size_t student_idx = 0; student_idx < cost.affected_students; student_idx++) {
+        const size_t student = students_who_studied.at(item).at(student_idx);
+        const size_t first_exposure = all_first_encounters.at(item).at(student_idx);
+        cost.trials_touched += first_exposure + 2 * (dataset->get_item_sequences().at(student).size() - first_exposure);
+    }
+}
+
+
+// items sorted by decreasing total time
+static vector<size_t> items_by_cost(const vector<struct item_cost> & item_costs) {
+    vector<pair<double, size_t> > order;
+    for (size_t item = 0; item < item_costs.size(); item++) order.push_back(make_pair(-item_costs[item].seconds, item));
+    sort(order.begin(), order.end());
+    vector<size_t> items;
+    for (size_t i = 0; i < order.size(); i++) items.push_back(order[i].second);
+    return items;
+}
+
+
+// prints the top_n items by total time spent resampling them
+void MixtureWCRP::print_item_profile(ostream & out, const size_t top_n) const {
+    assert(!item_costs.empty()); // need to have called enable_item_profile first
+
+    double total_seconds = 0;
+    for (size_t item = 0; item < num_items; item++) total_seconds += item_costs[item].seconds;
+
+    const vector<size_t> items = items_by_cost(item_costs);
+    out << "top " << min(top_n, num_items) << " of " << num_items << " items by Gibbs step time (" << setprecision(3) << total_seconds << " sec. in total)" << endl;
+    out << "item\tsec.\tshare\tsteps\tusec_per_step\ttables_per_step\tstudents\ttrials_per_step" << endl;
+    for (size_t rank = 0; rank < top_n && rank < num_items; rank++) {
+        const size_t item = items[rank];
+        const item_cost & cost = item_costs[item];
+        const double steps = max((size_t) 1, cost.num_steps);
+        out << item << "\t" << setprecision(4) << cost.seconds << "\t" << setprecision(4) << (total_seconds > 0 ? cost.seconds / total_seconds : 0.0) << "\t" << cost.num_steps
+            << "\t" << setprecision(1) << (1e6 * cost.seconds / steps) << "\t" << setprecision(1) << (cost.tables_scored / steps) << "\t" << cost.affected_students << "\t" << cost.trials_touched << endl;
+    }
+}
+
+
+// writes the profile of every item as CSV, most expensive first
+void MixtureWCRP::save_item_profile(const char * filename) const {
+    assert(!item_costs.empty()); // need to have called enable_item_profile first
+
+    ofstream out(filename, ofstream::out);
+    if (!out.is_open()) {
+        cerr << "couldn't open " << string(filename) << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    const vector<size_t> items = items_by_cost(item_costs);
+    out << "item,seconds,steps,tables_scored,affected_students,trials_per_step" << endl;
+    out << setprecision(9);
+    for (size_t rank = 0; rank < num_items; rank++) {
+        const item_cost & cost = item_costs[items[rank]];
+        out << items[rank] << "," << cost.seconds << "," << cost.num_steps << "," << cost.tables_scored << "," << cost.affected_students << "," << cost.trials_touched << endl;
+    }
+}
+
+
+// starts the file record_sample writes knowledge states to. an earlier file is finished (its index written) and closed first
+void MixtureWCRP::export_knowledge_states(const char * filename) {
+    delete knowledge_state_writer;
+    knowledge_state_writer = new KnowledgeStateWriter(filename);
+}
+
+
+const CoassignmentCounts & MixtureWCRP::enable_coassignment() {
+    if (!coassignment) coassignment = new CoassignmentCounts(num_items);
+    else coassignment->clear(num_items);
+    coassignment_tables.assign(num_items, UNASSIGNED);
+    coassignment_members.clear();
+    return *coassignment;
+}
+
+
+// makes run_mcmc publish its progress to the server after every iteration and act on the server's checkpoint and dump requests
+// the server isn't owned by the model
+void MixtureWCRP::set_status_server(StatusServer * server, const string & run_name) {
+    status_server = server;
+    status_run_name = run_name;
+}
+
+
+void MixtureWCRP::fill_run_status(run_status & status, const size_t iteration, const size_t num_iterations, const size_t burn, const double elapsed_seconds, const vector<double> & recent_train_ll) const {
+    status.run_name = status_run_name;
+    status.iteration = iteration;
+    status.num_iterations = num_iterations;
+    status.burn = burn;
+    status.elapsed_seconds = elapsed_seconds;
+    for (size_t phase = 0; phase < NUM_SAMPLER_PHASES; phase++) status.phase_seconds[phase] = phase_seconds[phase];
+    status.num_skills = extant_tables.size();
+    status.beta = 1.0 - exp(log_gamma);
+    status.alpha_prime = exp(log_alpha_prime);
+    status.pruned_fraction = get_pruned_fraction();
+    status.recent_train_ll = recent_train_ll;
+}
+
+
+// writes prefix.status.json and, when they're being collected, the item profile (prefix.item_profile.csv) and a trace snapshot
+void MixtureWCRP::dump_stats(const string & prefix, const run_status & status) const {
+    const string status_file = prefix + ".status.json";
+    ofstream out(status_file.c_str(), ofstream::out);
+    if (!out.is_open()) {
+        cerr << "couldn't open " << status_file << endl; // don't take down a long run over a bad dump request
+        return;
+    }
+    out << StatusServer::status_json(status) << endl;
+    if (!item_costs.empty()) save_item_profile((prefix + ".item_profile.csv").c_str());
+    trace_dump();
+}
+
+
+// writes the chain state: the WCRP hyperparameters, the seating arrangement and each table's BKT parameters
+// the file is written under a temporary name and then renamed, so an interrupted write never clobbers the last good checkpoint
+void MixtureWCRP::save_checkpoint(const char * filename) const {
+    const string tmp_filename = string(filename) + ".tmp";
+    ofstream out(tmp_filename.c_str(), ofstream::out);
+    if (!out.is_open()) {
+        cerr << "couldn't open " << tmp_filename << endl;
+        return;
+    }
+
+    out << setprecision(17);
+    out << "wcrp_checkpoint\t2" << endl;
+    out << "num_items\t" << num_items << endl;
+    out << "log_alpha_prime\t" << log_alpha_prime << endl;
+    out << "log_gamma\t" << log_gamma << endl;
+    out << "tables_ever_instantiated\t" << tables_ever_instantiated << endl;
+    out << "seating";
+    for (size_t item = 0; item < num_items; item++) out << "\t" << seating_arrangement.at(item);
+    out << endl;
+    out << "num_tables\t" << extant_tables.size() << endl;
+    for (set<size_t>::const_iterator table_itr = extant_tables.begin(); table_itr != extant_tables.end(); table_itr++) {
+        const struct bkt_parameters & params = parameters.at(*table_itr);
+        out << *table_itr << "\t" << params.psi << "\t" << params.mu << "\t" << params.pi1 << "\t" << params.prop0 << endl;
+    }
+
+    // the auxiliary draws from the prior and each item's singleton skill likelihoods under them, so resuming doesn't recompute them
+    out << "prior_samples\t" << prior_samples.size() << endl;
+    for (size_t subsample = 0; subsample < prior_samples.size(); subsample++) {
+        const struct bkt_parameters & params = prior_samples[subsample];
+        out << params.psi << "\t" << params.mu << "\t" << params.pi1 << "\t" << params.prop0 << endl;
+    }
+    if (!prior_samples.empty()) {
+        out << "singleton_skill_data_lp" << endl;
+        for (size_t item = 0; item < num_items; item++) {
+            for (size_t subsample = 0; subsample < num_subsamples; subsample++) out << (subsample ? "\t" : "") << singleton_skill_data_lp.at(item).at(subsample);
+            out << endl;
+        }
+    }
+    out.close();
+
+    if (rename(tmp_filename.c_str(), filename) != 0) cerr << "couldn't move " << tmp_filename << " to " << filename << endl;
+}
+
+
+// reads a double written by ofstream, which (unlike istream) accepts the inf that log(0) produces
+static double parse_checkpoint_double(istream & in) {
+    string token;
+    in >> token;
+    assert(!token.empty());
+    return strtod(token.c_str(), NULL);
+}
+
+
+// expects a line "<name>\t<value>" and returns the value
+static string read_checkpoint_field(istream & in, const char * name) {
+    string field, value;
+    in >> field >> value;
+    if (field != name) {
+        cerr << "malformed checkpoint: expected " << name << " but read " << field << endl;
+        exit(EXIT_FAILURE);
+    }
+    return value;
+}
+
+
+void MixtureWCRP::load_checkpoint(const char * filename) {
+
+    TraceScope scope("load_checkpoint", "io");
+
+    ifstream in(filename);
+    if (!in.is_open()) {
+        cerr << "couldn't open " << filename << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    const size_t version = (size_t) strtoul(read_checkpoint_field(in, "wcrp_checkpoint").c_str(), NULL, 10);
+    assert(version == 1 || version == 2);
+    const size_t checkpoint_num_items = (size_t) strtoul(read_checkpoint_field(in, "num_items").c_str(), NULL, 10);
+    if (checkpoint_num_items != num_items) {
+        cerr << filename << " has " << checkpoint_num_items << " items but the dataset has " << num_items << endl;
+        exit(EXIT_FAILURE);
+    }
+    log_alpha_prime = strtod(read_checkpoint_field(in, "log_alpha_prime").c_str(), NULL);
+    const double checkpoint_log_gamma = strtod(read_checkpoint_field(in, "log_gamma").c_str(), NULL);
+    if (!use_expert_labels) log_gamma = checkpoint_log_gamma; // with the expert labels, gamma stays at 0
+    tables_ever_instantiated = (size_t) strtoul(read_checkpoint_field(in, "tables_ever_instantiated").c_str(), NULL, 10);
+
+    string field;
+    in >> field;
+    assert(field == "seating");
+    vector<size_t> checkpoint_seating(num_items);
+    for (size_t item = 0; item < num_items; item++) {
+        in >> checkpoint_seating[item];
+        assert(checkpoint_seating[item] != UNASSIGNED && checkpoint_seating[item] < tables_ever_instantiated);
+    }
+
+    const size_t num_tables = (size_t) strtoul(read_checkpoint_field(in, "num_tables").c_str(), NULL, 10);
+    boost::unordered_map<size_t, struct bkt_parameters> checkpoint_parameters;
+    for (size_t table = 0; table < num_tables; table++) {
+        size_t table_id;
+        struct bkt_parameters params;
+        in >> table_id;
+        params.psi = parse_checkpoint_double(in);
+        params.mu = parse_checkpoint_double(in);
+        params.pi1 = parse_checkpoint_double(in);
+        params.prop0 = parse_checkpoint_double(in);
+        checkpoint_parameters[table_id] = params;
+    }
+
+    // seat the items, then overwrite the parameters drawn for each new table
+    for (size_t item = 0; item < num_items; item++) {
+        const size_t table_id = checkpoint_seating[item];
+        assign_item_to_table(item, table_id, !table_sizes.count(table_id));
+    }
+    assert(extant_tables.size() == num_tables);
+    for (set<size_t>::const_iterator table_itr = extant_tables.begin(); table_itr != extant_tables.end(); table_itr++) {
+        assert(checkpoint_parameters.count(*table_itr));
+        parameters[*table_itr] = checkpoint_parameters[*table_itr];
+    }
+
+    // version 2 checkpoints also carry the auxiliary draws from the prior and the singleton skill marginal likelihoods
+    // computed from them, which are the expensive part of building the model. they're reused if they match this model
+    if (version < 2) return;
+    const size_t checkpoint_num_subsamples = (size_t) strtoul(read_checkpoint_field(in, "prior_samples").c_str(), NULL, 10);
+    if (use_expert_labels || checkpoint_num_subsamples != num_subsamples) return;
+
+    prior_samples.resize(num_subsamples);
+    for (size_t subsample = 0; subsample < num_subsamples; subsample++) {
+        struct bkt_parameters & params = prior_samples[subsample];
+        params.psi = parse_checkpoint_double(in);
+        params.mu = parse_checkpoint_double(in);
+        params.pi1 = parse_checkpoint_double(in);
+        params.prop0 = parse_checkpoint_double(in);
+    }
+    in >> field;
+    assert(field == "singleton_skill_data_lp");
+    singleton_skill_data_lp.resize(num_items);
+    for (size_t item = 0; item < num_items; item++) {
+        singleton_skill_data_lp[item].resize(num_subsamples);
+        for (size_t subsample = 0; subsample < num_subsamples; subsample++) singleton_skill_data_lp[item][subsample] = parse_checkpoint_double(in);
+    }
+    if (!in) {
+        cerr << "malformed checkpoint: " << filename << " ended early" << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+void MixtureWCRP::grow_dataset(const size_t new_num_students, const size_t new_num_items) {
+    assert(new_num_students >= num_students && new_num_items >= num_items);
+
+    first_encounter.resize(new_num_students);
+    item_and_recall_sequences.resize(new_num_students);
+    trials_studied.resize(new_num_students);
+    ever_studied.resize(new_num_students); // training students only. sloppy notation
+    for (size_t student = 0; student < new_num_students; student++) {
+        first_encounter[student].resize(new_num_items, NEVER_STUDIED);
+        trials_studied[student].resize(new_num_items);
+        ever_studied[student].resize(new_num_items, false);
+    }
+
+    students_who_studied.resize(new_num_items);
+    all_first_encounters.resize(new_num_items);
+
+    // the variable all_items will be useful during gibbs sampling
+    for (size_t item = num_items; item < new_num_items; item++) all_items.push_back(item);
+    scan_move_rates.resize(new_num_items, 1.0); // unsettled until the adaptive scan sees otherwise
+
+    num_students = new_num_students;
+    num_items = new_num_items;
+}
+
+
+void MixtureWCRP::index_trial(const size_t student, const size_t trial, const bool is_training) {
+    const size_t item = dataset->get_item_sequences().at(student).at(trial);
+    assert(item < num_items);
+    assert(item_and_recall_sequences[student].size() == trial); // trials are indexed in order
+
+    item_and_recall_sequences[student].push_back(make_pair(item, dataset->get_recall_sequences().at(student).at(trial)));
+    trials_studied[student][item].push_back(trial);
+    if (first_encounter[student][item] == NEVER_STUDIED) first_encounter[student][item] = trial;
+
+    if (!is_training) return;
+    if (!ever_studied[student][item]) {
+        ever_studied[student][item] = true;
+        students_who_studied[item].push_back(student);
+        all_first_encounters[item].push_back(trial);
+    }
+
+    // trials come after every trial already in the table's lookup, so appending keeps it sorted
+    if (item < seating_arrangement.size() && seating_arrangement[item] != UNASSIGNED) trial_lookup[seating_arrangement[item]][student].push_back(trial);
+}
+
+
+void MixtureWCRP::compute_singleton_skill_data_lp(const size_t item) {
+    assert(seating_arrangement.at(item) == UNASSIGNED);
+    const vector<size_t> & affected_students = students_who_studied.at(item);
+    const vector<size_t> & first_exposures = all_first_encounters.at(item);
+
+    // create a singleton skill with this item
+    const size_t tmp_table_id = tables_ever_instantiated++;
+    assign_item_to_table(item, tmp_table_id, true);
+
+    // record the log likelihood for this singleton skill under each draw from the prior
+    singleton_skill_data_lp[item].resize(num_subsamples);
+    for (size_t subsample = 0; subsample < num_subsamples; subsample++) {
+        parameters[tmp_table_id] = prior_samples[subsample];
+        singleton_skill_data_lp[item][subsample] = skill_log_likelihood(tmp_table_id, affected_students, first_exposures);
+    }
+
+    // delete the singleton skill
+    remove_item_from_table(item, tmp_table_id);
+}
+
+
+void MixtureWCRP::append_trials(const Dataset & extended_dataset) {
+
+    TraceScope scope("append_trials", "sampler");
+
+    // the extended dataset has to start with the current one
+    assert(extended_dataset.get_num_students() >= num_students && extended_dataset.get_num_items() >= num_items);
+    vector<size_t> previous_lengths(num_students);
+    for (size_t student = 0; student < num_students; student++) {
+        previous_lengths[student] = item_and_recall_sequences[student].size();
+        assert(extended_dataset.get_item_sequences()[student].size() >= previous_lengths[student]);
+        for (size_t trial = 0; trial < previous_lengths[student]; trial++) assert(extended_dataset.get_item_sequences()[student][trial] == item_and_recall_sequences[student][trial].first);
+    }
+    dataset = &extended_dataset;
+
+    const size_t old_num_items = num_items;
+    item_sketches.clear(); // the sketches are rebuilt once the new trials are indexed
+    table_sketches.clear();
+    delete fixed_skill_fitter; // and FixedSkillBKT's trials the next time it's used
+    fixed_skill_fitter = NULL;
+    if (train_all_students) {
+        for (size_t student = num_students; student < dataset->get_num_students(); student++) train_students.insert(student);
+    }
+    grow_dataset(dataset->get_num_students(), dataset->get_num_items());
+    seating_arrangement.resize(num_items, UNASSIGNED);
+    num_expert_provided_skills = 1 + *max_element(dataset->get_provided_skill_labels().begin(), dataset->get_provided_skill_labels().begin() + num_items);
+
+    // index the new trials. an item's singleton skill likelihood only depends on the training students' trials of it
+    set<size_t> affected_items;
+    vector<size_t> lengthened_students; // training students with new trials
+    size_t num_new_trials = 0;
+    for (size_t student = 0; student < num_students; student++) {
+        const size_t begin_trial = student < previous_lengths.size() ? previous_lengths[student] : 0;
+        const size_t end_trial = dataset->get_item_sequences().at(student).size();
+        assert(begin_trial <= end_trial && dataset->get_recall_sequences().at(student).size() == end_trial);
+        if (begin_trial == end_trial) continue;
+
+        const bool is_training = train_students.count(student);
+        for (size_t trial = begin_trial; trial < end_trial; trial++) {
+            index_trial(student, trial, is_training);
+            if (is_training) affected_items.insert(dataset->get_item_sequences()[student][trial]);
+        }
+        if (is_training) lengthened_students.push_back(student);
+        num_new_trials += end_trial - begin_trial;
+    }
+
+    // the item profile's work counts cover every trial after an item's first exposure, so every item a lengthened student 
+    // studied needs them recomputed, not only the items in the new trials
+    if (!item_costs.empty()) {
+        item_cost no_steps;
+        no_steps.num_steps = no_steps.tables_scored = 0;
+        no_steps.seconds = 0;
+        item_costs.resize(num_items, no_steps);
+        set<size_t> profile_changed;
+        for (size_t item = old_num_items; item < num_items; item++) profile_changed.insert(item);
+        for (size_t idx = 0; idx < lengthened_students.size(); idx++) {
+            const vector<size_t> & items = dataset->get_item_sequences()[lengthened_students[idx]];
+            profile_changed.insert(items.begin(), items.end());
+        }
+        for (set<size_t>::const_iterator item_itr = profile_changed.begin(); item_itr != profile_changed.end(); item_itr++) update_item_work(*item_itr);
+    }
 
-    double best_ll = 0;
-    size_t best_sample = 0;
+    // the samples recorded so far are of the posterior given the old data
+    memory_sink.clear();
+    sample_sink->clear();
+    if (coassignment) enable_coassignment();
+
+    // every item has to be seated before any likelihood is computed. the new items start at their expert-provided skill,
+    // or at a new skill if the model doesn't use them
+    for (size_t item = old_num_items; item < num_items; item++) {
+        size_t table_id = tables_ever_instantiated++;
+        if (use_expert_labels) {
+            table_id = 1 + dataset->get_provided_skill_labels().at(item);
+            tables_ever_instantiated = max(tables_ever_instantiated, table_id + 1);
+        }
+        assign_item_to_table(item, table_id, !table_sizes.count(table_id));
+    }
 
-    for (size_t sample = 0; sample < train_ll_samples.size(); sample++) {
-        if (sample == 0 || train_ll_samples.at(sample) > best_ll) {
-            best_ll = train_ll_samples.at(sample);
-            best_sample = sample;
+    if (!use_expert_labels) {
+        // recompute the singleton skill likelihoods of the items that got new trials, keeping them at their tables
+        for (size_t item = old_num_items; item < num_items; item++) affected_items.insert(item);
+        singleton_skill_data_lp.resize(num_items);
+        for (set<size_t>::const_iterator item_itr = affected_items.begin(); item_itr != affected_items.end(); item_itr++) {
+            const size_t item = *item_itr;
+            const size_t cur_table_id = seating_arrangement.at(item);
+            const struct bkt_parameters cur_params = parameters.at(cur_table_id);
+            const bool deleted_table = remove_item_from_table(item, cur_table_id);
+            compute_singleton_skill_data_lp(item);
+            assign_item_to_table(item, cur_table_id, deleted_table);
+            parameters[cur_table_id] = cur_params;
         }
+
+        // then give the new items a draw from their Gibbs conditional
+        for (size_t item = old_num_items; item < num_items; item++) gibbs_resample_skill(item);
+        if (approximate_top_k > 0) build_sketches();
     }
 
-    return skill_label_samples.at(best_sample);
+    if (progress_stream) *progress_stream << "appended " << num_new_trials << " trials and " << (num_items - old_num_items) << " new items" << endl;
 }
 
 
+size_t MixtureWCRP::run_mcmc(const size_t num_iterations, const size_t burn, const bool infer_gamma, const bool infer_alpha_prime) {
 
-void MixtureWCRP::run_mcmc(const size_t num_iterations, const size_t burn, const bool infer_gamma, const bool infer_alpha_prime) {
+    const double run_begin_time = get_wall_time();
+    vector<double> recent_train_ll;
 
     for (size_t iter = 0; iter < num_iterations; iter++) {
         //cout << "SAMPLING ITERATION " << (iter+1) << " OF " << num_iterations << endl;
+        TraceScope iteration_scope("iteration", "sampler", "iter", iter+1);
 
-        clock_t begin = clock();
+        const double begin_time = get_wall_time(); // not clock(), which sums the time of FixedSkillBKT's threads
 
         // update alpha' and gamma
         //cout << "  resampling WCRP hyperparameters" << endl;
+        begin_phase();
         double cur_seating_lp = log_seating_prob();
         for (size_t extra_step = 0; extra_step < 1; extra_step++) {
             if (!use_expert_labels && infer_alpha_prime) cur_seating_lp = slice_resample_wcrp_param(&log_alpha_prime, cur_seating_lp, -10, 11, .25, log_logalphaprime_prior_density);
@@ -311,12 +909,18 @@ void MixtureWCRP::run_mcmc(const size_t num_iterations, const size_t burn, const
             // update gamma
             if (infer_gamma) cur_seating_lp = slice_resample_wcrp_param(&log_gamma, cur_seating_lp, -8, 0, .25, log_loggamma_prior_density);
         }
+        end_phase(PHASE_HYPERPARAMETERS);
+        if (!notify_phase(iter+1, PHASE_HYPERPARAMETERS)) return iter;
 
         // update the BKT parameters for each skill
         //cout << "  resampling skill parameters" << endl;
-        for (size_t extra_step = 0; extra_step < 1; extra_step++) {
+        begin_phase();
+        const bool fitting_fixed_skills = use_expert_labels && bkt_fit != BKT_SLICE_SAMPLING;
+        if (fitting_fixed_skills) update_fixed_skill_parameters();
+        for (size_t extra_step = 0; extra_step < (fitting_fixed_skills ? 0 : 1); extra_step++) {
             for (boost::unordered_map<size_t, struct bkt_parameters>::iterator table_itr = parameters.begin(); table_itr != parameters.end(); table_itr++) {
                 const size_t table_id = table_itr->first;
+                TraceScope skill_scope("skill_parameters", "bkt_parameters", "table", table_id);
 
                 // figure out which items are assigned to this skill
                 vector<size_t> items_assigned_to_skill;
@@ -329,7 +933,7 @@ void MixtureWCRP::run_mcmc(const size_t num_iterations, const size_t burn, const
                 for (size_t student = 0; student < num_students; student++) {
                     if (train_students.count(student) && studied_any_of(student, items_assigned_to_skill)) {
                         students_to_include.push_back(student);
-                        size_t min_val = item_sequences.at(student).size();
+                        size_t min_val = dataset->get_item_sequences().at(student).size();
                         for (vector<size_t>::const_iterator item_itr = items_assigned_to_skill.begin(); item_itr != items_assigned_to_skill.end(); item_itr++) {
                             if (first_encounter.at(student).at(*item_itr) < min_val) min_val = first_encounter.at(student).at(*item_itr);
                         }
@@ -350,21 +954,29 @@ void MixtureWCRP::run_mcmc(const size_t num_iterations, const size_t burn, const
                 }
             }
         }
+        end_phase(PHASE_BKT_PARAMETERS);
+        if (!notify_phase(iter+1, PHASE_BKT_PARAMETERS)) return iter;
 
         // update the WCRP seating arrangement
+        begin_phase();
+        tables_considered = tables_pruned = 0;
+        approximate_steps = approximate_rejections = 0;
         if (!use_expert_labels) {
             //cout << "  resampling skill assignments" << endl;
-            generator->shuffle(all_items);
-            for (vector<size_t>::const_iterator item_itr = all_items.begin(); item_itr != all_items.end(); item_itr++) gibbs_resample_skill(*item_itr);
+            resample_seating(iter < burn);
         }
         //else cout << "  skipping resampling the skill assignments because we're using the expert labels" << endl;
+        end_phase(PHASE_SEATING);
+        if (!notify_phase(iter+1, PHASE_SEATING)) return iter;
 
-        clock_t end = clock();
-        double elapsed_ms = (end - begin)/(CLOCKS_PER_SEC/1000.0);
+        const double elapsed_ms = (get_wall_time() - begin_time) * 1000.0;
 
         // print out a status update
         size_t train_n, test_n;
+        begin_phase();
         const double train_ll = full_data_log_likelihood(true, train_n);
+        end_phase(PHASE_LIKELIHOOD);
+        if (!notify_phase(iter+1, PHASE_LIKELIHOOD)) return iter;
         const double beta = 1.0 - exp(log_gamma); // gamma is legacy notation
         /*
         const double test_ll = full_data_log_likelihood(false, test_n);
@@ -376,13 +988,114 @@ void MixtureWCRP::run_mcmc(const size_t num_iterations, const size_t burn, const
         cout << "  current number of skills: " << num_used_skills << endl << endl;
         */
 
-        if (iter == 0) cout << "iter\tsec.\tbeta\tnskills\tdata_ll\tcross_entropy" << endl;
-        cout.setf(ios::fixed);
-        cout << (iter+1) << "\t" << setprecision(2) << (elapsed_ms / 10000.0) << "\t" << setprecision(4) << beta << "\t" << setprecision(0) << extant_tables.size() << "\t" << train_ll << "\t" << setprecision(4) << (-train_ll / train_n) << endl;
+        if (progress_stream) {
+            ostream & out = *progress_stream;
+            if (iter == 0) out << "iter\tsec.\tbeta\tnskills\tdata_ll\tcross_entropy\tpruned" << endl;
+            out.setf(ios::fixed);
+            out << (iter+1) << "\t" << setprecision(2) << (elapsed_ms / 1000.0) << "\t" << setprecision(4) << beta << "\t" << setprecision(0) << extant_tables.size() << "\t" << train_ll << "\t" << setprecision(4) << (-train_ll / train_n) 
+                << "\t" << setprecision(3) << get_pruned_fraction() << endl;
+        }
+
+        begin_phase();
+        if (iter >= burn) record_sample(iter+1, train_ll);
+        end_phase(PHASE_RECORD);
+        if (!notify_phase(iter+1, PHASE_RECORD)) return iter;
+
+        print_phase_report(iter);
+        trace_poll();
+
+        if (status_server) {
+            recent_train_ll.push_back(train_ll);
+            if (recent_train_ll.size() > NUM_RECENT_TRAIN_LL) recent_train_ll.erase(recent_train_ll.begin());
 
-        if (iter >= burn) record_sample(train_ll);
+            run_status status;
+            fill_run_status(status, iter+1, num_iterations, burn, get_wall_time() - run_begin_time, recent_train_ll);
+            status_server->publish(status);
+
+            string filename;
+            if (status_server->take_checkpoint_request(filename)) save_checkpoint(filename.c_str());
+            if (status_server->take_dump_request(filename)) dump_stats(filename, status);
+        }
+
+        bool keep_going = true;
+        for (size_t observer = 0; observer < observers.size(); observer++) keep_going = observers[observer]->after_iteration(*this, iter+1, train_ll) && keep_going;
+        if (!keep_going) return iter+1;
+    }
+
+    return num_iterations;
+}
+
+
+// with the items seated by their expert labels, updates every skill's BKT parameters with FixedSkillBKT: EM to convergence,
+// which later iterations only confirm, or one data augmentation step
+void MixtureWCRP::update_fixed_skill_parameters() {
+    assert(use_expert_labels);
+    if (!fixed_skill_fitter) {
+        fixed_skill_tables.assign(extant_tables.begin(), extant_tables.end());
+        boost::unordered_map<size_t, size_t> skill_of_table;
+        for (size_t skill = 0; skill < fixed_skill_tables.size(); skill++) skill_of_table[fixed_skill_tables[skill]] = skill;
+        vector<size_t> skill_labels(num_items);
+        for (size_t item = 0; item < num_items; item++) skill_labels[item] = skill_of_table.at(seating_arrangement.at(item));
+        fixed_skill_fitter = new FixedSkillBKT(*dataset, skill_labels, train_students, num_threads);
+        fixed_skill_parameters.resize(fixed_skill_tables.size());
     }
 
+    for (size_t skill = 0; skill < fixed_skill_tables.size(); skill++) fixed_skill_parameters[skill] = parameters.at(fixed_skill_tables[skill]);
+    if (bkt_fit == BKT_EM) fixed_skill_fitter->fit_em(fixed_skill_parameters);
+    else fixed_skill_fitter->sample_step(generator, fixed_skill_parameters);
+    for (size_t skill = 0; skill < fixed_skill_tables.size(); skill++) parameters[fixed_skill_tables[skill]] = fixed_skill_parameters[skill];
+}
+
+
+bool MixtureWCRP::notify_phase(const size_t iteration, const sampler_phase phase) {
+    bool keep_going = true;
+    for (size_t observer = 0; observer < observers.size(); observer++) keep_going = observers[observer]->after_phase(*this, iteration, phase) && keep_going;
+    return keep_going;
+}
+
+
+// one sweep of Gibbs steps. without the adaptive scan it's a systematic scan, every item once in a shuffled order. with it,
+// num_items items are drawn with replacement in proportion to their move rates (floored at adaptive_scan_floor), so some
+// items get several steps and some none. drawing the whole sweep up front from weights that don't depend on the current
+// seating keeps each step a valid Gibbs update. run_mcmc passes adapt only while iter < burn, so the weights are fixed
+// once samples are recorded and the chain left is an ordinary random scan
+void MixtureWCRP::resample_seating(const bool adapt) {
+    const vector<size_t> * sweep_items = &all_items;
+    if (adaptive_scan_floor > 0) {
+        // draw num_items items with replacement. the weights don't depend on the current seating
+        scan_cumulative.resize(num_items);
+        double total_weight = 0.0;
+        for (size_t item = 0; item < num_items; item++) {
+            total_weight += max(scan_move_rates[item], adaptive_scan_floor);
+            scan_cumulative[item] = total_weight;
+        }
+        scan_items.resize(num_items);
+        for (size_t step = 0; step < num_items; step++) {
+            const size_t item = upper_bound(scan_cumulative.begin(), scan_cumulative.end(), generator->sampleUniform(total_weight)) - scan_cumulative.begin();
+            scan_items[step] = min(item, num_items - 1);
+        }
+        sweep_items = &scan_items;
+    }
+    else generator->shuffle(all_items);
+
+    const bool adapting = adapt && adaptive_scan_floor > 0;
+    for (size_t batch_begin = 0; batch_begin < sweep_items->size(); batch_begin += GIBBS_TRACE_BATCH) {
+        TraceScope batch_scope("gibbs_batch", "seating", "first_step", batch_begin);
+        const size_t batch_end = min(sweep_items->size(), batch_begin + GIBBS_TRACE_BATCH);
+        for (size_t step = batch_begin; step < batch_end; step++) {
+            const size_t item = (*sweep_items)[step];
+            const size_t old_table_id = seating_arrangement[item];
+            const bool was_alone = adapting && table_sizes.at(old_table_id) == 1;
+            if (approximate_top_k > 0) approximate_gibbs_resample_skill(item);
+            else gibbs_resample_skill(item);
+            if (!adapting) continue;
+
+            // a lone item drawn a new table of its own hasn't changed the partition
+            const size_t new_table_id = seating_arrangement[item];
+            const bool moved = new_table_id != old_table_id && !(was_alone && table_sizes.at(new_table_id) == 1);
+            scan_move_rates[item] += SCAN_RATE_DECAY * ((moved ? 1.0 : 0.0) - scan_move_rates[item]);
+        }
+    }
 }
 
 
@@ -390,94 +1103,576 @@ void MixtureWCRP::run_mcmc(const size_t num_iterations, const size_t burn, const
 // see algorithm 8 from http://www.stat.purdue.edu/~rdutta/24.PDF
 void MixtureWCRP::gibbs_resample_skill(const size_t item) {
 
+    const double step_begin_time = item_costs.empty() ? 0 : get_wall_time();
     const size_t cur_table_id = seating_arrangement.at(item);
-    const vector<size_t> & affected_students = students_who_studied.at(item); // (this won't contain any heldout students)
-    const vector<size_t> & first_exposures = all_first_encounters.at(item);
 
     // unassign the item's skill label
     remove_item_from_table(item, cur_table_id);
 
+    // consider assigning every possible skill label to this item
+    vector<size_t> & keys = gibbs_keys;
+    vector<double> & proportional_log_probs = gibbs_log_probs;
+    score_candidate_tables(item, keys, proportional_log_probs);
+
+    // draw a new skill label
+    const size_t num_extant_tables = keys.size();
+    const size_t drawn_event = (size_t) generator->sampleUnnormalizedDiscrete(proportional_log_probs);
+    if (drawn_event >= num_extant_tables) { // if we decided to create a new skill
+        assign_item_to_table(item, tables_ever_instantiated++, true); // sit down
+        const size_t chosen_subsample = drawn_event - num_extant_tables;
+        parameters[seating_arrangement.at(item)] = prior_samples.at(chosen_subsample); // assign parameters
+    }
+    else { // else we decided to use an existing skill
+        const size_t table_id = keys.at(drawn_event);
+        assign_item_to_table(item, table_id, false);
+    }
+
+    if (!item_costs.empty()) {
+        item_costs[item].num_steps++;
+        item_costs[item].seconds += get_wall_time() - step_begin_time;
+        item_costs[item].tables_scored += num_extant_tables;
+    }
+}
+
+
+// orders tables by decreasing approximate score
+struct sketch_score_greater {
+    sketch_score_greater(const vector<double> & scores) : scores(scores) {}
+    bool operator()(const size_t a, const size_t b) const { return scores[a] > scores[b]; }
+    const vector<double> & scores;
+};
+
+
+// a Metropolis-Hastings version of gibbs_resample_skill for when there are too many tables to score every one of them
+//
+// with the item removed, every extant table t gets an approximate score a(t): its seating probability plus sketch_log_ratio.
+// the k tables with the highest approximate scores, T, are scored exactly (e(t)), as are the auxiliary new tables. the proposal 
+// draws from
+//   q(t) proportional to exp(e(t))       for t in T and the new tables
+//   q(t) proportional to exp(a(t) + c)   for the other tables
+// where c = log sum_T exp(e) - log sum_T exp(a) puts the approximate scores on the exact ones' scale. q depends only on the 
+// other items' seating, not on the item's current table z, so moving to the proposed t is an independence Metropolis-Hastings 
+// step accepted with probability min(1, w(t) / w(z)), w = exp(e) / q. w is the same for every table scored exactly, so a 
+// proposal is always accepted when z and t are both in T (or new tables), which then makes this the Gibbs step restricted to T; 
+// otherwise the one or two tables outside T are scored exactly to compute w. the chain's stationary distribution is the 
+// posterior whatever k is; a poor k or poor sketches only show up as rejections and slower mixing. if z was a table of its own,
+// it's treated as one of the new tables
+void MixtureWCRP::approximate_gibbs_resample_skill(const size_t item) {
+
+    const double step_begin_time = item_costs.empty() ? 0 : get_wall_time();
+    const size_t cur_table_id = seating_arrangement.at(item);
+    const struct bkt_parameters cur_params = parameters.at(cur_table_id);
+    const bool was_alone = remove_item_from_table(item, cur_table_id);
+    approximate_steps++;
+
+    // the approximate score of every extant table, and the top k of them
+    const size_t num_tables = extant_tables.size();
+    sketch_lps.resize(num_tables);
+    sketch_order.resize(num_tables);
+    size_t event = 0;
+    for (set<size_t>::const_iterator table_itr = extant_tables.begin(); table_itr != extant_tables.end(); table_itr++, event++) {
+        sketch_lps[event] = old_table_seating_lp(item, *table_itr) + sketch_log_ratio(item, *table_itr);
+        sketch_order[event] = event;
+    }
+    const size_t num_exact = min(approximate_top_k, num_tables);
+    nth_element(sketch_order.begin(), sketch_order.begin() + num_exact, sketch_order.end(), sketch_score_greater(sketch_lps));
+    sort(sketch_order.begin(), sketch_order.begin() + num_exact); // extant_tables' order
+    exact_tables.clear();
+    set<size_t>::const_iterator table_itr = extant_tables.begin();
+    for (size_t rank = 0, event = 0; rank < num_exact; rank++) {
+        for ( ; event < sketch_order[rank]; event++) table_itr++;
+        exact_tables.push_back(*table_itr);
+    }
+    tables_considered += num_tables;
+    tables_pruned += num_tables - num_exact;
+
+    // the proposal: the exact scores of T and the new tables, then the calibrated approximate scores of the rest
+    vector<size_t> & keys = gibbs_keys;
+    vector<double> & proposal_lps = gibbs_log_probs;
+    score_candidate_tables(item, keys, proposal_lps, &exact_tables);
+    const size_t num_exact_events = proposal_lps.size();
+    double log_exact_total = -INFINITY, log_sketch_total = -INFINITY;
+    for (size_t rank = 0; rank < num_exact; rank++) {
+        log_exact_total = log_add(log_exact_total, proposal_lps[rank]);
+        log_sketch_total = log_add(log_sketch_total, sketch_lps[sketch_order[rank]]);
+    }
+    const double calibration = num_exact > 0 ? log_exact_total - log_sketch_total : 0.0;
+    boost::unordered_map<size_t, double> & proposal_lp_of = sketch_proposal_lps; // the approximate tables' proposal scores, by table id
+    proposal_lp_of.clear();
+    table_itr = extant_tables.begin();
+    for (size_t event = 0, rank = 0; event < num_tables; event++, table_itr++) {
+        if (rank < num_exact && sketch_order[rank] == event) {
+            rank++;
+            continue;
+        }
+        keys.push_back(*table_itr);
+        proposal_lps.push_back(sketch_lps[event] + calibration);
+        proposal_lp_of[*table_itr] = proposal_lps.back();
+    }
+
+    // draw a proposal. the draw normalizes the scores in place, so the approximate tables' are looked up in proposal_lp_of
+    const size_t drawn_event = (size_t) generator->sampleUnnormalizedDiscrete(proposal_lps);
+    const bool is_new_table = drawn_event >= num_exact && drawn_event < num_exact_events;
+    size_t table_id = is_new_table ? 0 : keys.at(drawn_event < num_exact ? drawn_event : drawn_event - num_subsamples);
+    const bool cur_is_approximate = !was_alone && proposal_lp_of.count(cur_table_id);
+    const bool proposal_is_approximate = drawn_event >= num_exact_events;
+
+    // the Metropolis-Hastings correction, if either table is outside T
+    bool accepted = true;
+    if ((cur_is_approximate || proposal_is_approximate) && !(proposal_is_approximate && table_id == cur_table_id)) {
+        double log_ratio = 0.0; // log w(proposal) - log w(current)
+        if (proposal_is_approximate) log_ratio += exact_table_score(item, table_id) - proposal_lp_of.at(table_id);
+        if (cur_is_approximate) log_ratio -= exact_table_score(item, cur_table_id) - proposal_lp_of.at(cur_table_id);
+        accepted = log_ratio >= 0.0 || log(generator->sampleUniform01()) < log_ratio;
+    }
+
+    if (!accepted) { // stay
+        approximate_rejections++;
+        assign_item_to_table(item, cur_table_id, was_alone);
+        if (was_alone) parameters[cur_table_id] = cur_params;
+    }
+    else if (is_new_table) {
+        assign_item_to_table(item, tables_ever_instantiated++, true); // sit down
+        parameters[seating_arrangement.at(item)] = prior_samples.at(drawn_event - num_exact); // assign parameters
+    }
+    else assign_item_to_table(item, table_id, false);
+
+    if (!item_costs.empty()) {
+        item_costs[item].num_steps++;
+        item_costs[item].seconds += get_wall_time() - step_begin_time;
+        item_costs[item].tables_scored += num_exact;
+    }
+}
+
+
+// the score of seating the unassigned item at the table, as score_candidate_tables computes it, using its cached forward state
+double MixtureWCRP::exact_table_score(const size_t item, const size_t table_id) {
+    const vector<size_t> & affected_students = students_who_studied.at(item);
+    const vector<size_t> & first_exposures = all_first_encounters.at(item);
+    const double seating_lp = old_table_seating_lp(item, table_id);
+    assign_item_to_table(item, table_id, false);
+    const double data_lp_with_item = skill_log_likelihood(table_id, affected_students, first_exposures, p_hat_scratch);
+    remove_item_from_table(item, table_id);
+    const double data_lp_without_item = skill_log_likelihood(table_id, affected_students, first_exposures, p_hat_scratch);
+    return seating_lp + data_lp_with_item - data_lp_without_item;
+}
+
+
+// the log likelihood of the item's responses if each came from a student whose accuracy is the table's accuracy in the 
+// student's bucket. a crude stand-in for the exact log likelihood ratio that costs a pass over the item's nonempty buckets
+double MixtureWCRP::sketch_log_ratio(const size_t item, const size_t table_id) const {
+    const struct table_sketch & sketch = table_sketches.at(table_id);
+    const vector<sketch_entry> & entries = item_sketches.at(item);
+    double lp = 0.0;
+    for (size_t idx = 0; idx < entries.size(); idx++) {
+        lp += entries[idx].correct * sketch.log_accuracy[entries[idx].bucket] + (entries[idx].total - entries[idx].correct) * sketch.log_error[entries[idx].bucket];
+    }
+    return lp;
+}
+
+
+// students are bucketed by id. each item's sketch is fixed; each table's is the sum of its items'
+void MixtureWCRP::build_sketches() {
+    item_sketches.assign(num_items, vector<sketch_entry>());
+    int correct[SKETCH_BUCKETS], total[SKETCH_BUCKETS];
+    for (size_t item = 0; item < num_items; item++) {
+        fill(correct, correct + SKETCH_BUCKETS, 0);
+        fill(total, total + SKETCH_BUCKETS, 0);
+        for (size_t student_idx = 0; student_idx < students_who_studied[item].size(); student_idx++) {
+            const size_t student = students_who_studied[item][student_idx];
+            const vector<size_t> & trials = trials_studied[student][item];
+            for (size_t idx = 0; idx < trials.size(); idx++) {
+                correct[student % SKETCH_BUCKETS] += item_and_recall_sequences[student][trials[idx]].second;
+                total[student % SKETCH_BUCKETS]++;
+            }
+        }
+        for (size_t bucket = 0; bucket < SKETCH_BUCKETS; bucket++) {
+            if (total[bucket] == 0) continue;
+            sketch_entry entry;
+            entry.bucket = bucket;
+            entry.correct = correct[bucket];
+            entry.total = total[bucket];
+            item_sketches[item].push_back(entry);
+        }
+    }
+
+    table_sketches.clear();
+    for (size_t item = 0; item < num_items; item++) {
+        if (seating_arrangement[item] != UNASSIGNED) update_table_sketch(seating_arrangement[item], item, 1);
+    }
+}
+
+
+// adds (sign = 1) or subtracts (sign = -1) the item's responses to the table's sketch
+void MixtureWCRP::update_table_sketch(const size_t table_id, const size_t item, const int sign) {
+    if (!table_sketches.count(table_id)) { // a new table
+        struct table_sketch & sketch = table_sketches[table_id];
+        fill(sketch.correct, sketch.correct + SKETCH_BUCKETS, 0);
+        fill(sketch.total, sketch.total + SKETCH_BUCKETS, 0);
+        fill(sketch.log_accuracy, sketch.log_accuracy + SKETCH_BUCKETS, log(.5));
+        fill(sketch.log_error, sketch.log_error + SKETCH_BUCKETS, log(.5));
+    }
+
+    struct table_sketch & sketch = table_sketches[table_id];
+    const vector<sketch_entry> & entries = item_sketches.at(item);
+    for (size_t idx = 0; idx < entries.size(); idx++) {
+        const size_t bucket = entries[idx].bucket;
+        sketch.correct[bucket] += sign * entries[idx].correct;
+        sketch.total[bucket] += sign * entries[idx].total;
+        assert(sketch.correct[bucket] >= 0 && sketch.total[bucket] >= sketch.correct[bucket]);
+        sketch.log_accuracy[bucket] = log((sketch.correct[bucket] + 1.0) / (sketch.total[bucket] + 2.0)); // Laplace smoothed
+        sketch.log_error[bucket] = log((sketch.total[bucket] - sketch.correct[bucket] + 1.0) / (sketch.total[bucket] + 2.0));
+    }
+}
+
+
+// orders score_candidate_tables' tables by decreasing bound
+struct table_bound_greater {
+    table_bound_greater(const vector<double> & bounds) : bounds(bounds) {}
+    bool operator()(const size_t a, const size_t b) const { return bounds[a] > bounds[b]; }
+    const vector<double> & bounds;
+};
+
+
+// computes the log of a quantity proportional to the conditional probability of seating the (unassigned) item at each table
+// keys[k] is the k^th table scored. the last num_subsamples entries of proportional_log_probs are the auxiliary new tables
+// extant tables whose combined probability is provably below exp(prune_log_tolerance) of the total are left out (see table_log_ratio_bound)
+void MixtureWCRP::score_candidate_tables(const size_t item, vector<size_t> & keys, vector<double> & proportional_log_probs, const vector<size_t> * tables) {
+
+    assert(seating_arrangement.at(item) == UNASSIGNED);
+    const vector<size_t> & affected_students = students_who_studied.at(item); // (this won't contain any heldout students)
+    const vector<size_t> & first_exposures = all_first_encounters.at(item);
+
     // precompute each student's BKT sufficient statistic up to the first encounter of item
-    vector< boost::unordered_map<size_t, double> > p_hat(affected_students.size());
-    for (size_t student_idx = 0; student_idx < affected_students.size(); student_idx++) cache_p_hat(affected_students.at(student_idx), first_exposures.at(student_idx), p_hat[student_idx]);
+    // the maps are reused across calls. cache_p_hat overwrites every extant table's entry, so entries left over from deleted
+    // tables are never read; a map is only cleared once they accumulate
+    vector< boost::unordered_map<size_t, double> > & p_hat = p_hat_scratch;
+    if (p_hat.size() < affected_students.size()) p_hat.resize(affected_students.size());
+    for (size_t student_idx = 0; student_idx < affected_students.size(); student_idx++) {
+        if (p_hat[student_idx].size() > 2 * parameters.size()) p_hat[student_idx].clear();
+        cache_p_hat(affected_students.at(student_idx), first_exposures.at(student_idx), p_hat[student_idx]);
+    }
 
-    vector<double> data_lp_with_item, data_lp_without_item, seating_lp;
+    vector<double> & data_lp_with_item = scratch_data_lp_with_item;
+    vector<double> & data_lp_without_item = scratch_data_lp_without_item;
+    vector<double> & seating_lp = scratch_seating_lp;
+    const size_t num_tables = tables ? tables->size() : extant_tables.size();
+    const bool prune = !tables && prune_log_tolerance > -INFINITY;
 
     // preallocate memory
-    const size_t final_size = extant_tables.size() + num_subsamples;
+    const size_t final_size = num_tables + num_subsamples;
     data_lp_with_item.reserve(final_size);
     data_lp_without_item.reserve(final_size);
     seating_lp.reserve(final_size);
+    data_lp_with_item.resize(num_tables);
+    data_lp_without_item.resize(num_tables);
+    seating_lp.resize(num_tables);
+    table_score_bounds.resize(num_tables);
+    table_scored.assign(num_tables, false);
+
+    // the log probability of sitting at each extant table, and a bound on its score
+    size_t num_correct = 0, num_incorrect = 0;
+    for (size_t student_idx = 0; prune && student_idx < affected_students.size(); student_idx++) {
+        const vector<size_t> & item_trials = trials_studied[affected_students[student_idx]][item];
+        for (size_t idx = 0; idx < item_trials.size(); idx++) {
+            if (item_and_recall_sequences[affected_students[student_idx]][item_trials[idx]].second) num_correct++;
+            else num_incorrect++;
+        }
+    }
+    if (tables) keys.assign(tables->begin(), tables->end());
+    else keys.assign(extant_tables.begin(), extant_tables.end()); // note: extant_tables won't change in this function
+    for (size_t event = 0; event < num_tables; event++) {
+        seating_lp[event] = old_table_seating_lp(item, keys[event]);
+        if (prune) table_score_bounds[event] = seating_lp[event] + table_log_ratio_bound(parameters.at(keys[event]), num_correct, num_incorrect);
+    }
+
+    // the new tables' scores are exact and cheap
+    const double new_table_seating_lp = log_new_table_probability(log_alpha_prime, log_gamma, num_expert_provided_skills) - log(1.0*num_subsamples);
+    double log_total = -INFINITY; // of the scores computed so far
+    for (size_t subsample = 0; subsample < num_subsamples; subsample++) log_total = log_add(log_total, new_table_seating_lp + singleton_skill_data_lp.at(item).at(subsample));
+
+    // compute the data log likelihood (of affected students) for each extant skill with and without item being assigned to it,
+    // from the highest bound down. once the bounds of the remaining tables add up to a negligible fraction of the scores computed
+    // so far, the remaining tables are pruned
+    vector<size_t> & order = table_score_order;
+    vector<double> & remaining_bound = table_remaining_bounds;
+    order.resize(num_tables);
+    for (size_t event = 0; event < num_tables; event++) order[event] = event;
+    if (prune) {
+        sort(order.begin(), order.end(), table_bound_greater(table_score_bounds));
+        remaining_bound.resize(num_tables + 1);
+        remaining_bound[num_tables] = -INFINITY;
+        for (size_t rank = num_tables; rank > 0; rank--) remaining_bound[rank - 1] = log_add(remaining_bound[rank], table_score_bounds[order[rank - 1]]);
+    }
+
+    size_t batch_tables[TABLE_LANES], batch_events[TABLE_LANES];
+    size_t num_batched = 0, num_scored = 0;
+    for (size_t rank = 0; rank < num_tables; rank++) {
+        if (prune && remaining_bound[rank] < log_total + prune_log_tolerance) break;
+
+        const size_t event = order[rank];
+        const size_t table_id = keys[event];
+        table_scored[event] = true;
+        num_scored++;
+
+        // small tables are scored a batch at a time
+        if (table_sizes.at(table_id) <= max_batched_table_size) {
+            batch_tables[num_batched] = table_id;
+            batch_events[num_batched++] = event;
+            if (num_batched == TABLE_LANES) {
+                score_table_batch(item, batch_tables, batch_events, num_batched, p_hat, data_lp_with_item, data_lp_without_item);
+                for (size_t lane = 0; lane < num_batched; lane++) {
+                    const size_t batch_event = batch_events[lane];
+                    log_total = log_add(log_total, seating_lp[batch_event] + data_lp_with_item[batch_event] - data_lp_without_item[batch_event]);
+                }
+                num_batched = 0;
+            }
+            continue;
+        }
 
-    // compute the data log likelihood (of affected students) for each extant skill with and without item being assigned to it
-    // also compute the log probability of sitting here
-    vector<size_t> keys;
-    keys.reserve(extant_tables.size());
-    for (set<size_t>::const_iterator table_itr = extant_tables.begin(); table_itr != extant_tables.end(); table_itr++) { // note: extant_tables won't change in this loop
         // data likelihood; with
-        assign_item_to_table(item, *table_itr, false);
-        data_lp_with_item.push_back(skill_log_likelihood(*table_itr, affected_students, first_exposures, p_hat));
+        assign_item_to_table(item, table_id, false);
+        data_lp_with_item[event] = skill_log_likelihood(table_id, affected_students, first_exposures, p_hat);
 
         // data likelihood; without
-        remove_item_from_table(item, *table_itr);
-        data_lp_without_item.push_back(skill_log_likelihood(*table_itr, affected_students, first_exposures, p_hat));
-
-        // seating probability
-        const double K = compute_K(item, *table_itr, false);
-        seating_lp.push_back(log_old_table_probability(table_sizes.at(*table_itr), K, log_gamma, num_expert_provided_skills));
+        remove_item_from_table(item, table_id);
+        data_lp_without_item[event] = skill_log_likelihood(table_id, affected_students, first_exposures, p_hat);
+        log_total = log_add(log_total, seating_lp[event] + data_lp_with_item[event] - data_lp_without_item[event]);
+    }
+    if (num_batched > 0) score_table_batch(item, batch_tables, batch_events, num_batched, p_hat, data_lp_with_item, data_lp_without_item);
+    if (!tables) {
+        tables_considered += num_tables;
+        tables_pruned += num_tables - num_scored;
+    }
 
-        keys.push_back(*table_itr);
+    // drop the pruned tables, keeping the rest in order
+    if (num_scored < num_tables) {
+        size_t num_kept = 0;
+        for (size_t event = 0; event < num_tables; event++) {
+            if (!table_scored[event]) continue;
+            keys[num_kept] = keys[event];
+            data_lp_with_item[num_kept] = data_lp_with_item[event];
+            data_lp_without_item[num_kept] = data_lp_without_item[event];
+            seating_lp[num_kept++] = seating_lp[event];
+        }
+        keys.resize(num_kept);
+        data_lp_with_item.resize(num_kept);
+        data_lp_without_item.resize(num_kept);
+        seating_lp.resize(num_kept);
     }
 
     // use the precomputed marginal likelihoods for calculating the new seating prob
     data_lp_with_item.insert(data_lp_with_item.end(), singleton_skill_data_lp.at(item).begin(), singleton_skill_data_lp.at(item).end());
     data_lp_without_item.resize(data_lp_without_item.size() + num_subsamples, 0.0);
-    seating_lp.resize(seating_lp.size() + num_subsamples, log_new_table_probability(log_alpha_prime, log_gamma, num_expert_provided_skills) - log(1.0*num_subsamples));
+    seating_lp.resize(seating_lp.size() + num_subsamples, new_table_seating_lp);
 
-    assert(data_lp_with_item.size() == num_used_skills + num_subsamples);
-    assert(data_lp_without_item.size() == num_used_skills + num_subsamples);
-    assert(seating_lp.size() == num_used_skills + num_subsamples);
+    assert(data_lp_with_item.size() == num_scored + num_subsamples);
+    assert(data_lp_without_item.size() == num_scored + num_subsamples);
+    assert(seating_lp.size() == num_scored + num_subsamples);
 
-    // consider assigning every possible skill label to this item
-    vector<double> proportional_log_probs(seating_lp.size());
+    proportional_log_probs.resize(seating_lp.size());
     for (size_t event = 0; event < seating_lp.size(); event++) proportional_log_probs[event] = seating_lp.at(event) + data_lp_with_item.at(event) - data_lp_without_item.at(event);
+}
 
-    // draw a new skill label
-    const size_t num_extant_tables = extant_tables.size();
-    const size_t drawn_event = (size_t) generator->sampleUnnormalizedDiscrete(proportional_log_probs);
-    if (drawn_event >= num_extant_tables) { // if we decided to create a new skill
-        assign_item_to_table(item, tables_ever_instantiated++, true); // sit down
-        const size_t chosen_subsample = drawn_event - num_extant_tables;
-        parameters[seating_arrangement.at(item)] = prior_samples.at(chosen_subsample); // assign parameters
+
+// the factor by which one of the item's trials multiplies a student's likelihood of a table's trials (see table_log_ratio_bound)
+static inline double trial_ratio(const double p, const double r, const double e1, const double e0, const double mu) {
+    return (p * e1 * r + (1.0 - p) * e0 * (mu * r + 1.0 - mu)) / (p * r + 1.0 - p);
+}
+
+
+// an upper bound on how much seating an item at a table with these parameters can raise the table's data log likelihood, given 
+// the number of correct and incorrect responses to the item (by the affected students). it's cheap enough to compute for 
+// every table before any is scored
+//
+// seat the item's trials one at a time. each adds an observation and a learning step where the filtered state is p. if the rest 
+// of the table's trials have likelihood L1 given the skill is learned and L0 given it isn't, the likelihood is multiplied by
+//   [p e1 r + (1-p) e0 (mu r + 1 - mu)] / [p r + 1 - p],  r = L1 / L0
+// where e1 and e0 are the probabilities of the response given the skill is learned and not. that's monotone in p and in r, so 
+// it's largest at a corner of their ranges: p is at least min(psi, mu), since it starts at psi and every trial leaves it at mu 
+// or more, and r is at most pi1 / (pi0 mu), since L0 includes the path that learns right after the first of the trials
+double MixtureWCRP::table_log_ratio_bound(const struct bkt_parameters & params, const size_t num_correct, const size_t num_incorrect) {
+    const double pi1 = params.pi1;
+    const double pi0 = params.pi1 * params.prop0;
+    const double mu = params.mu;
+    const double p_min = min(params.psi, mu);
+    const double r_max = max(1.0, pi1 / (pi0 * mu));
+    const double correct_factor = max(max(pi1, pi0 * (1.0 - mu)), trial_ratio(p_min, r_max, pi1, pi0, mu));
+    const double incorrect_factor = max(max(1.0 - pi1, (1.0 - pi0) * (1.0 - mu)), trial_ratio(p_min, r_max, 1.0 - pi1, 1.0 - pi0, mu));
+    return num_correct * log(correct_factor) + num_incorrect * log(incorrect_factor);
+}
+
+
+// one BKT step of a lane in score_table_batch. recall and mask are 0 or 1, and lanes whose mask is 0 are left as they are.
+// both outcomes are computed and blended by multiplying with 0 or 1, which is exact as long as both are finite, because the
+// compiler won't vectorize a loop with branches (or selects between them)
+static inline void bkt_lane_step(double & p_hat, double & likelihood, const double recall, const double mask, const double pi0, const double pi1, const double mu) {
+    const double p_correct = pi0 * (1.0 - p_hat) + pi1 * p_hat;
+    const double p_hat_if_correct = (pi1 * p_hat + mu * pi0 * (1.0 - p_hat)) / p_correct;
+    const double p_hat_if_incorrect = ((1.0 - pi1) * p_hat + mu * (1.0 - pi0) * (1.0 - p_hat)) / ((1.0 - pi1) * p_hat + (1.0 - pi0) * (1.0 - p_hat));
+    likelihood *= mask * (recall * p_correct + (1.0 - recall) * (1.0 - p_correct)) + (1.0 - mask);
+    p_hat = mask * (recall * p_hat_if_correct + (1.0 - recall) * p_hat_if_incorrect) + (1.0 - mask) * p_hat;
+}
+
+
+// every observation has probability of at least about TOL, so a product of this many can't underflow
+#define LANE_FOLD_STEPS 16
+
+
+// scores a batch of tables the way score_candidate_tables scores one: skill_log_likelihood with the item seated at the table,
+// and without it. each lane walks its table's trials merged with the item's, so the tables are never modified. the lanes step 
+// together, multiplying their observation probabilities and only taking logs every LANE_FOLD_STEPS steps
+void MixtureWCRP::score_table_batch(const size_t item, const size_t * table_ids, const size_t * events, const size_t num_tables, const vector< boost::unordered_map<size_t, double> > & init_p_hat, vector<double> & lp_with_item, vector<double> & lp_without_item) {
+
+    assert(num_tables > 0 && num_tables <= TABLE_LANES);
+    assert(seating_arrangement.at(item) == UNASSIGNED);
+    const vector<size_t> & affected_students = students_who_studied.at(item);
+    const vector<size_t> & first_exposures = all_first_encounters.at(item);
+
+    // unused lanes repeat the last table, so their arithmetic stays finite
+    double pi0[TABLE_LANES], pi1[TABLE_LANES], mu[TABLE_LANES];
+    const boost::unordered_map<size_t, vector<size_t> > * lookups[TABLE_LANES];
+    for (size_t lane = 0; lane < TABLE_LANES; lane++) {
+        const size_t table_id = table_ids[min(lane, num_tables - 1)];
+        const struct bkt_parameters & skill_params = parameters.at(table_id);
+        pi1[lane] = skill_params.pi1;
+        pi0[lane] = skill_params.pi1 * skill_params.prop0;
+        mu[lane] = skill_params.mu;
+        lookups[lane] = &trial_lookup.at(table_id);
     }
-    else { // else we decided to use an existing skill
-        const size_t table_id = keys.at(drawn_event);
-        assign_item_to_table(item, table_id, false);
+
+    double ll_with[TABLE_LANES] = {0.0}, ll_without[TABLE_LANES] = {0.0};
+    for (size_t student_idx = 0; student_idx < affected_students.size(); student_idx++) {
+
+        const size_t student = affected_students.at(student_idx);
+        const size_t start_trial = first_exposures.at(student_idx);
+        const vector< pair<size_t, bool> > & recall_items = item_and_recall_sequences.at(student);
+        const vector<size_t> & item_trials = trials_studied[student][item]; // these all come on or after start_trial
+
+        // find each lane's trials of its table from start_trial on
+        const vector<size_t> * table_trials[TABLE_LANES];
+        size_t table_begin[TABLE_LANES], num_steps = 0;
+        for (size_t lane = 0; lane < num_tables; lane++) {
+            const boost::unordered_map<size_t, vector<size_t> >::const_iterator itr = lookups[lane]->find(student);
+            table_trials[lane] = itr == lookups[lane]->end() ? NULL : &itr->second;
+            table_begin[lane] = table_trials[lane] ? lower_bound(itr->second.begin(), itr->second.end(), start_trial) - itr->second.begin() : 0;
+            num_steps = max(num_steps, item_trials.size() + (table_trials[lane] ? table_trials[lane]->size() - table_begin[lane] : 0));
+        }
+
+        // lay the lanes' steps out side by side: the merged trials, padded with masked-out steps
+        batch_recalls.assign(num_steps * TABLE_LANES, 0.0);
+        batch_with_masks.assign(num_steps * TABLE_LANES, 0.0);
+        batch_without_masks.assign(num_steps * TABLE_LANES, 0.0);
+        for (size_t lane = 0; lane < num_tables; lane++) {
+            size_t table_idx = table_begin[lane], item_idx = 0, step = 0;
+            const size_t table_end = table_trials[lane] ? table_trials[lane]->size() : 0;
+            while (table_idx < table_end || item_idx < item_trials.size()) {
+                const bool from_item = table_idx == table_end || (item_idx < item_trials.size() && item_trials[item_idx] < table_trials[lane]->at(table_idx));
+                const size_t trial = from_item ? item_trials[item_idx++] : table_trials[lane]->at(table_idx++);
+                batch_recalls[step * TABLE_LANES + lane] = recall_items[trial].second ? 1.0 : 0.0;
+                batch_with_masks[step * TABLE_LANES + lane] = 1.0;
+                batch_without_masks[step * TABLE_LANES + lane] = from_item ? 0.0 : 1.0;
+                step++;
+            }
+        }
+
+        double p_with[TABLE_LANES], p_without[TABLE_LANES], likelihood_with[TABLE_LANES], likelihood_without[TABLE_LANES];
+        double student_ll_with[TABLE_LANES], student_ll_without[TABLE_LANES];
+        for (size_t lane = 0; lane < TABLE_LANES; lane++) {
+            p_with[lane] = p_without[lane] = init_p_hat.at(student_idx).at(table_ids[min(lane, num_tables - 1)]);
+            likelihood_with[lane] = likelihood_without[lane] = 1.0;
+            student_ll_with[lane] = student_ll_without[lane] = 0.0;
+        }
+
+        for (size_t step = 0; step < num_steps; step++) {
+            const double * recalls = &batch_recalls[step * TABLE_LANES];
+            const double * with_masks = &batch_with_masks[step * TABLE_LANES];
+            const double * without_masks = &batch_without_masks[step * TABLE_LANES];
+            for (size_t lane = 0; lane < TABLE_LANES; lane++) {
+                bkt_lane_step(p_with[lane], likelihood_with[lane], recalls[lane], with_masks[lane], pi0[lane], pi1[lane], mu[lane]);
+                bkt_lane_step(p_without[lane], likelihood_without[lane], recalls[lane], without_masks[lane], pi0[lane], pi1[lane], mu[lane]);
+            }
+            if ((step + 1) % LANE_FOLD_STEPS == 0) {
+                for (size_t lane = 0; lane < TABLE_LANES; lane++) {
+                    student_ll_with[lane] += log(likelihood_with[lane]);
+                    student_ll_without[lane] += log(likelihood_without[lane]);
+                    likelihood_with[lane] = likelihood_without[lane] = 1.0;
+                }
+            }
+        }
+
+        for (size_t lane = 0; lane < num_tables; lane++) {
+            student_ll_with[lane] += log(likelihood_with[lane]);
+            student_ll_without[lane] += log(likelihood_without[lane]);
+            assert(isfinite(student_ll_with[lane]) && isfinite(student_ll_without[lane]));
+            ll_with[lane] += min(0.0, student_ll_with[lane]); // occasional minor numerical issue because of the caching trick
+            ll_without[lane] += min(0.0, student_ll_without[lane]);
+        }
+    }
+
+    for (size_t lane = 0; lane < num_tables; lane++) {
+        lp_with_item[events[lane]] = ll_with[lane];
+        lp_without_item[events[lane]] = ll_without[lane];
     }
 }
 
 
-void MixtureWCRP::record_sample(const double train_ll) {
+static bool knowledge_state_entry_less(const knowledge_state_entry & a, const knowledge_state_entry & b) {
+    return a.skill < b.skill;
+}
 
-    // record the current training data log likelihood
-    train_ll_samples.push_back(train_ll);
 
-    // record the current partitioning of items into skills
-    boost::unordered_map<size_t, int> skill_labels;
-    vector<size_t> cur_assignments(num_items);
+void MixtureWCRP::label_skills(chain_sample & sample, boost::unordered_map<size_t, int> & skill_labels) const {
+    sample.log_alpha_prime = log_alpha_prime;
+    sample.log_gamma = log_gamma;
+
+    // the current partitioning of items into skills
+    skill_labels.clear();
+    sample.skill_labels.resize(num_items);
     for (size_t item = 0; item < num_items; item++) {
         const size_t table_id = seating_arrangement.at(item);
         if (skill_labels.find(table_id) == skill_labels.end()) skill_labels[table_id] = skill_labels.size();
-        cur_assignments[item] = skill_labels.at(table_id);
+        sample.skill_labels[item] = skill_labels.at(table_id);
+    }
+
+    // each skill's BKT parameters under the same labels
+    sample.skill_parameters.resize(skill_labels.size());
+    for (boost::unordered_map<size_t, int>::const_iterator label_itr = skill_labels.begin(); label_itr != skill_labels.end(); label_itr++) sample.skill_parameters[label_itr->second] = parameters.at(label_itr->first);
+}
+
+
+void MixtureWCRP::record_sample(const size_t iteration, const double train_ll) {
+
+    TraceScope scope("record_sample", "record");
+
+    boost::unordered_map<size_t, int> skill_labels;
+    label_skills(recorded_sample, skill_labels);
+    recorded_sample.iteration = iteration;
+    recorded_sample.train_ll = train_ll;
+    if (coassignment) update_coassignment();
+
+    // the model predictions for the entire dataset, if anything needs them
+    const bool record_predictions = sample_sink->wants_predictions();
+    if (record_predictions) {
+        sample_predictions.resize(num_students);
+        for (size_t student = 0; student < num_students; student++) sample_predictions[student].resize(dataset->get_item_sequences()[student].size());
+    }
+    else sample_predictions.clear();
+    if (!record_predictions && !knowledge_state_writer) {
+        sample_sink->add_sample(recorded_sample, sample_predictions);
+        return;
     }
-    skill_label_samples.push_back(cur_assignments);
 
-    // record the model predictions for the entire dataset
+    if (knowledge_state_writer) {
+        knowledge_state_row_ends.clear();
+        knowledge_state_entries.clear();
+    }
+    vector<size_t> touched_tables;
     for (size_t student = 0; student < num_students; student++) {
 
         // define some references for convenience:
-        const vector<bool> & recall_sequence = recall_sequences.at(student);
-        const vector<size_t> & item_sequence = item_sequences.at(student);
+        const vector<bool> & recall_sequence = dataset->get_recall_sequences().at(student);
+        const vector<size_t> & item_sequence = dataset->get_item_sequences().at(student);
 
         // initialize p_hat
         boost::unordered_map<size_t, double> p_hat;
@@ -494,12 +1689,62 @@ void MixtureWCRP::record_sample(const double train_ll) {
             const double skill_mu = skill_params.mu;
             const double cur_p_hat = p_hat.at(table_id);
 
-            pRT_samples[student][trial].push_back(skill_pi0 * (1.0 - cur_p_hat) + skill_pi1 * cur_p_hat); // record prediction
-
+            if (record_predictions) sample_predictions[student][trial] = skill_pi0 * (1.0 - cur_p_hat) + skill_pi1 * cur_p_hat; // record prediction
             if (did_recall) p_hat[table_id] = (skill_pi1 * cur_p_hat + skill_mu * skill_pi0 * (1.0 - cur_p_hat)) / (skill_pi1 * cur_p_hat + skill_pi0 * (1.0 - cur_p_hat));
             else p_hat[table_id] = ((1.0 - skill_pi1) * cur_p_hat + skill_mu * (1.0 - skill_pi0) * (1.0 - cur_p_hat)) / ((1.0 - skill_pi1) * cur_p_hat + (1.0 - skill_pi0) * (1.0 - cur_p_hat));
         }
+
+        // keep the end-of-sequence state of each skill the student practiced. a student practices few skills, so a linear search will do
+        if (knowledge_state_writer) {
+            touched_tables.clear();
+            for (size_t trial = 0; trial < item_sequence.size(); trial++) {
+                const size_t table_id = seating_arrangement.at(item_sequence[trial]);
+                if (find(touched_tables.begin(), touched_tables.end(), table_id) == touched_tables.end()) touched_tables.push_back(table_id);
+            }
+            const size_t row_begin = knowledge_state_entries.size();
+            for (vector<size_t>::const_iterator table_itr = touched_tables.begin(); table_itr != touched_tables.end(); table_itr++) {
+                knowledge_state_entry entry;
+                entry.skill = (uint32_t) skill_labels.at(*table_itr);
+                entry.p_learned = (float) p_hat.at(*table_itr);
+                knowledge_state_entries.push_back(entry);
+            }
+            sort(knowledge_state_entries.begin() + row_begin, knowledge_state_entries.end(), knowledge_state_entry_less);
+            knowledge_state_row_ends.push_back(knowledge_state_entries.size());
+        }
     }
+
+    sample_sink->add_sample(recorded_sample, sample_predictions);
+    if (knowledge_state_writer) knowledge_state_writer->write_sample(knowledge_state_row_ends, knowledge_state_entries);
+}
+
+
+// tells coassignment which pairs of items joined or left each other's table since the last recorded sample. a pair's 
+// co-membership can only change if one of its items moved, so only the tables a moved item left or joined are visited. a pair 
+// of moved items is handled from its smaller item. table ids aren't reused, so an item at the same table id hasn't moved
+void MixtureWCRP::update_coassignment() {
+    current_members.clear();
+    for (size_t item = 0; item < num_items; item++) current_members[seating_arrangement[item]].push_back(item);
+
+    for (size_t item = 0; item < num_items; item++) {
+        const size_t old_table = coassignment_tables[item], new_table = seating_arrangement[item];
+        if (old_table == new_table) continue;
+        if (old_table != UNASSIGNED) {
+            const vector<size_t> & old_mates = coassignment_members.at(old_table);
+            for (vector<size_t>::const_iterator mate_itr = old_mates.begin(); mate_itr != old_mates.end(); mate_itr++) {
+                const bool mate_moved = coassignment_tables[*mate_itr] != seating_arrangement[*mate_itr];
+                if (*mate_itr != item && (!mate_moved || *mate_itr > item) && seating_arrangement[*mate_itr] != new_table) coassignment->pair_separated(item, *mate_itr);
+            }
+        }
+        const vector<size_t> & new_mates = current_members.at(new_table);
+        for (vector<size_t>::const_iterator mate_itr = new_mates.begin(); mate_itr != new_mates.end(); mate_itr++) {
+            const bool mate_moved = coassignment_tables[*mate_itr] != seating_arrangement[*mate_itr];
+            if (*mate_itr != item && (!mate_moved || *mate_itr > item) && (old_table == UNASSIGNED || coassignment_tables[*mate_itr] != old_table)) coassignment->pair_joined(item, *mate_itr);
+        }
+    }
+
+    coassignment->add_sample();
+    coassignment_tables = seating_arrangement;
+    coassignment_members.swap(current_members);
 }
 
 
@@ -548,14 +1793,20 @@ void MixtureWCRP::assign_item_to_table(const size_t item, const size_t table_id,
             if (trial_lookup[table_id].find(*student_itr) == trial_lookup[table_id].end()) trial_lookup[table_id][*student_itr] = trials_studied[*student_itr][item]; // this student hadn't previously had any items assigned to this skill, but now does
             else {
                 // this student had previously had at least one item assigned to this skill
-                // merge trials_studied[*student_itr][item] into trial_lookup[table_id][*student_itr]
-                vector<size_t> tmp;
-                tmp.reserve(trial_lookup[table_id][*student_itr].size() + trials_studied[*student_itr][item].size());
-                merge(trial_lookup[table_id][*student_itr].begin(), trial_lookup[table_id][*student_itr].end(), trials_studied[*student_itr][item].begin(), trials_studied[*student_itr][item].end(), std::back_inserter(tmp));
-                trial_lookup[table_id][*student_itr].swap(tmp);
+                // merge trials_studied[*student_itr][item] into trial_lookup[table_id][*student_itr], in place from the back
+                // so that the vector's existing capacity is reused
+                vector<size_t> & trials = trial_lookup[table_id][*student_itr];
+                const vector<size_t> & new_trials = trials_studied[*student_itr][item];
+                size_t old_end = trials.size(), new_end = new_trials.size();
+                trials.resize(old_end + new_end);
+                for (size_t dest = trials.size(); new_end > 0; ) {
+                    if (old_end > 0 && trials[old_end - 1] > new_trials[new_end - 1]) trials[--dest] = trials[--old_end];
+                    else trials[--dest] = new_trials[--new_end];
+                }
             }
         }
     }
+    if (!item_sketches.empty()) update_table_sketch(table_id, item, 1);
 
     assert(num_used_skills == table_sizes.size());
 }
@@ -573,6 +1824,7 @@ bool MixtureWCRP::remove_item_from_table(const size_t item, const size_t table_i
         num_used_skills--;
 
         trial_lookup.erase(table_id);
+        table_sketches.erase(table_id);
         return true;
     }
 
@@ -586,17 +1838,19 @@ bool MixtureWCRP::remove_item_from_table(const size_t item, const size_t table_i
             trial_lookup[table_id].erase(*student_itr);
         }
         else {
-            vector<size_t> tmp;
-            tmp.reserve(final_size);
-            size_t num_ignored = 0;
-            for (vector<size_t>::const_iterator itr = trial_lookup[table_id][*student_itr].begin(); itr != trial_lookup[table_id][*student_itr].end(); itr++) {
-                if ( (num_ignored < trials_studied[*student_itr][item].size() && *itr != trials_studied[*student_itr][item][num_ignored]) || num_ignored >= trials_studied[*student_itr][item].size()) tmp.push_back(*itr);
+            // compact in place, keeping the vector's capacity for when an item is added back
+            vector<size_t> & trials = trial_lookup[table_id][*student_itr];
+            const vector<size_t> & removed_trials = trials_studied[*student_itr][item];
+            size_t num_ignored = 0, num_kept = 0;
+            for (size_t idx = 0; idx < trials.size(); idx++) {
+                if ( (num_ignored < removed_trials.size() && trials[idx] != removed_trials[num_ignored]) || num_ignored >= removed_trials.size()) trials[num_kept++] = trials[idx];
                 else num_ignored++;
             }
-            assert(tmp.size() == final_size);
-            trial_lookup[table_id][*student_itr].swap(tmp);
+            assert(num_kept == final_size);
+            trials.resize(num_kept);
         }
     }
+    if (!item_sketches.empty()) update_table_sketch(table_id, item, -1);
 
     return false;
 }
@@ -713,8 +1967,8 @@ double MixtureWCRP::skill_log_likelihood(const size_t table_id, const vector<siz
 void MixtureWCRP::cache_p_hat(const size_t student, const size_t end_trial, boost::unordered_map<size_t, double> & p_hat) const {
 
     // define some references for convenience:
-    const vector<bool> & recall_sequence = recall_sequences.at(student);
-    const vector<size_t> & item_sequence = item_sequences.at(student);
+    const vector<bool> & recall_sequence = dataset->get_recall_sequences().at(student);
+    const vector<size_t> & item_sequence = dataset->get_item_sequences().at(student);
 
     // initialize p_hat
     for (boost::unordered_map<size_t, struct bkt_parameters>::const_iterator table_itr = parameters.begin(); table_itr != parameters.end(); table_itr++) p_hat[table_itr->first] = table_itr->second.psi;
@@ -742,6 +1996,17 @@ void MixtureWCRP::cache_p_hat(const size_t student, const size_t end_trial, boos
 // TODO: clean up
 double MixtureWCRP::log_seating_prob() const {
 
+    // a plain CRP's probability doesn't depend on the order the items sat down in:
+    // (alpha' gamma)^(# tables) prod_tables (n - 1)! / prod_{i=0}^{num_items-1} (alpha' gamma + i)
+    if (is_plain_crp()) {
+        const double log_concentration = log_alpha_prime + log_gamma;
+        double log_prob = lgamma(exp(log_concentration)) - lgamma(exp(log_concentration) + num_items);
+        for (boost::unordered_map<size_t, size_t>::const_iterator table_itr = table_sizes.begin(); table_itr != table_sizes.end(); table_itr++) {
+            log_prob += log_concentration + lgamma(1.0 * table_itr->second);
+        }
+        return log_prob;
+    }
+
     double log_prob = 0.0;
     boost::unordered_map<size_t, size_t> table_counts_so_far;
 
@@ -806,8 +2071,8 @@ double MixtureWCRP::data_log_likelihood(const size_t student, const size_t start
     double log_lik = 0.0;
 
     // define some references for convenience:
-    const vector<bool> & recall_sequence = recall_sequences.at(student);
-    const vector<size_t> & item_sequence = item_sequences.at(student);
+    const vector<bool> & recall_sequence = dataset->get_recall_sequences().at(student);
+    const vector<size_t> & item_sequence = dataset->get_item_sequences().at(student);
     num_trials = item_sequence.size(); // only used by full_data_log_likelihood. not important to the sampler
 
     boost::unordered_map<size_t, double> p_hat; // psi is a vector of length max_num_skills
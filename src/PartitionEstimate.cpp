@@ -0,0 +1,237 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef PARTITION_ESTIMATE_CPP
+#define PARTITION_ESTIMATE_CPP
+
+#include "PartitionEstimate.hpp"
+
+using namespace std;
+
+#define MAX_SWEEPS 1000
+#define MIN_IMPROVEMENT 1e-10
+
+
+partition_loss parse_partition_loss(const string & name) {
+    if (name == "binder") return BINDER_LOSS;
+    if (name == "vi") return VI_LOSS;
+    cerr << "unknown partition loss " << name << " (expected binder or vi)" << endl;
+    exit(EXIT_FAILURE);
+}
+
+
+// relabels 0, 1, ... in the order the labels first appear
+static void compact_labels(vector<size_t> & labels) {
+    boost::unordered_map<size_t, size_t> new_labels;
+    for (size_t item = 0; item < labels.size(); item++) {
+        boost::unordered_map<size_t, size_t>::iterator label_itr = new_labels.find(labels[item]);
+        if (label_itr == new_labels.end()) {
+            const size_t new_label = new_labels.size();
+            label_itr = new_labels.insert(make_pair(labels[item], new_label)).first;
+        }
+        labels[item] = label_itr->second;
+    }
+}
+
+
+PartitionEstimator::PartitionEstimator(const CoassignmentCounts & counts) : total_prob(0.0), num_items(counts.get_num_items()) {
+    assert(counts.get_num_samples() > 0);
+    vector< pair<size_t, size_t> > pairs;
+    counts.get_pairs(pairs);
+
+    // count each item's neighbors, then fill in the rows
+    row_starts.assign(num_items + 1, 0);
+    for (size_t idx = 0; idx < pairs.size(); idx++) {
+        row_starts[pairs[idx].first + 1]++;
+        row_starts[pairs[idx].second + 1]++;
+    }
+    for (size_t item = 0; item < num_items; item++) row_starts[item + 1] += row_starts[item];
+
+    neighbors.resize(row_starts[num_items]);
+    neighbor_probs.resize(row_starts[num_items]);
+    row_sums.assign(num_items, 1.0);
+    vector<size_t> next_slot(row_starts.begin(), row_starts.end() - 1);
+    for (size_t idx = 0; idx < pairs.size(); idx++) {
+        const size_t item_a = pairs[idx].first, item_b = pairs[idx].second;
+        const double prob = counts.get_probability(item_a, item_b);
+        neighbors[next_slot[item_a]] = item_b;
+        neighbor_probs[next_slot[item_a]++] = prob;
+        neighbors[next_slot[item_b]] = item_a;
+        neighbor_probs[next_slot[item_b]++] = prob;
+        row_sums[item_a] += prob;
+        row_sums[item_b] += prob;
+        total_prob += prob;
+    }
+}
+
+
+vector<size_t> PartitionEstimator::minimize(const partition_loss loss, const vector<size_t> & initial_labels) const {
+    vector<size_t> best_labels(num_items);
+    for (size_t item = 0; item < num_items; item++) best_labels[item] = item;
+    local_search(loss, best_labels, MAX_SWEEPS);
+
+    if (!initial_labels.empty()) {
+        assert(initial_labels.size() == num_items);
+        vector<size_t> labels(initial_labels);
+        compact_labels(labels);
+        local_search(loss, labels, MAX_SWEEPS);
+        if (expected_loss(loss, labels) < expected_loss(loss, best_labels)) best_labels.swap(labels);
+    }
+
+    compact_labels(best_labels);
+    return best_labels;
+}
+
+
+double PartitionEstimator::expected_loss(const partition_loss loss, const vector<size_t> & labels) const {
+    assert(labels.size() == num_items);
+    vector<size_t> compact(labels);
+    compact_labels(compact);
+    vector<size_t> sizes(num_items, 0);
+    for (size_t item = 0; item < num_items; item++) sizes[compact[item]]++;
+
+    if (loss == BINDER_LOSS) {
+        // every pair put together costs 1 - p, every pair kept apart costs p
+        double expected = total_prob;
+        for (size_t skill = 0; skill < num_items; skill++) expected += sizes[skill] * (sizes[skill] - 1.0) / 2.0;
+        for (size_t item = 0; item < num_items; item++) {
+            for (size_t idx = row_starts[item]; idx < row_starts[item + 1]; idx++) {
+                if (compact[neighbors[idx]] == compact[item]) expected -= neighbor_probs[idx]; // each pair twice
+            }
+        }
+        return expected;
+    }
+
+    double expected = 0.0;
+    for (size_t item = 0; item < num_items; item++) {
+        double affinity = 1.0;
+        for (size_t idx = row_starts[item]; idx < row_starts[item + 1]; idx++) {
+            if (compact[neighbors[idx]] == compact[item]) affinity += neighbor_probs[idx];
+        }
+        expected += log2((double) sizes[compact[item]]) - 2.0 * log2(affinity) + log2(row_sums[item]);
+    }
+    return expected / num_items;
+}
+
+
+void PartitionEstimator::local_search(const partition_loss loss, vector<size_t> & labels, const size_t max_sweeps) const {
+    vector<size_t> sizes(num_items, 0);
+    for (size_t item = 0; item < num_items; item++) sizes[labels[item]]++;
+    vector<size_t> free_skills;
+    for (size_t skill = 0; skill < num_items; skill++) {
+        if (sizes[skill] == 0) free_skills.push_back(skill);
+    }
+
+    // for the item being moved: its probability mass with each candidate skill and, for vi, how much the log affinities of its
+    // neighbors there would change if it joined
+    vector<double> skill_probs(num_items, 0.0), skill_log_changes(num_items, 0.0);
+    vector<bool> is_candidate(num_items, false);
+    vector<size_t> candidates;
+
+    // each item's probability mass with its own skill, itself included. recomputed every sweep so rounding doesn't build up
+    vector<double> affinities(num_items);
+
+    for (size_t sweep = 0; sweep < max_sweeps; sweep++) {
+        for (size_t item = 0; item < num_items; item++) {
+            affinities[item] = 1.0;
+            for (size_t idx = row_starts[item]; idx < row_starts[item + 1]; idx++) {
+                if (labels[neighbors[idx]] == labels[item]) affinities[item] += neighbor_probs[idx];
+            }
+        }
+
+        size_t num_moves = 0;
+        for (size_t item = 0; item < num_items; item++) {
+            const size_t old_skill = labels[item];
+            double old_prob = 0.0, old_log_change = 0.0;
+            candidates.clear();
+            for (size_t idx = row_starts[item]; idx < row_starts[item + 1]; idx++) {
+                const size_t neighbor = neighbors[idx], skill = labels[neighbor];
+                const double prob = neighbor_probs[idx];
+                if (skill == old_skill) {
+                    old_prob += prob;
+                    if (loss == VI_LOSS) old_log_change += log((affinities[neighbor] - prob) / affinities[neighbor]);
+                    continue;
+                }
+                if (!is_candidate[skill]) {
+                    is_candidate[skill] = true;
+                    candidates.push_back(skill);
+                }
+                skill_probs[skill] += prob;
+                if (loss == VI_LOSS) skill_log_changes[skill] += log((affinities[neighbor] + prob) / affinities[neighbor]);
+            }
+
+            // the change in expected loss from leaving the old skill, then from joining each candidate. a new skill costs nothing to join
+            const double old_size = sizes[old_skill];
+            double leave;
+            if (loss == BINDER_LOSS) leave = 2.0 * old_prob - (old_size - 1.0);
+            else leave = (old_size > 1 ? (old_size - 1.0) * log((old_size - 1.0) / old_size) : 0.0) - 2.0 * old_log_change - log(old_size) + 2.0 * log(1.0 + old_prob);
+
+            size_t best_skill = old_skill;
+            double best_delta = -MIN_IMPROVEMENT;
+            if (sizes[old_skill] > 1 && leave < best_delta) {
+                best_skill = num_items; // a new skill
+                best_delta = leave;
+            }
+            for (size_t candidate = 0; candidate < candidates.size(); candidate++) {
+                const size_t skill = candidates[candidate];
+                const double size = sizes[skill];
+                double join;
+                if (loss == BINDER_LOSS) join = size - 2.0 * skill_probs[skill];
+                else join = size * log((size + 1.0) / size) - 2.0 * skill_log_changes[skill] + log(size + 1.0) - 2.0 * log(1.0 + skill_probs[skill]);
+                if (leave + join < best_delta) {
+                    best_skill = skill;
+                    best_delta = leave + join;
+                }
+            }
+
+            const double new_prob = best_skill < num_items ? skill_probs[best_skill] : 0.0;
+            for (size_t candidate = 0; candidate < candidates.size(); candidate++) {
+                skill_probs[candidates[candidate]] = 0.0;
+                skill_log_changes[candidates[candidate]] = 0.0;
+                is_candidate[candidates[candidate]] = false;
+            }
+            if (best_skill == old_skill) continue;
+
+            // move the item
+            if (best_skill == num_items) {
+                best_skill = free_skills.back();
+                free_skills.pop_back();
+            }
+            for (size_t idx = row_starts[item]; idx < row_starts[item + 1]; idx++) {
+                const size_t neighbor = neighbors[idx];
+                if (labels[neighbor] == old_skill) affinities[neighbor] -= neighbor_probs[idx];
+                else if (labels[neighbor] == best_skill) affinities[neighbor] += neighbor_probs[idx];
+            }
+            affinities[item] = 1.0 + new_prob;
+            if (--sizes[old_skill] == 0) free_skills.push_back(old_skill);
+            sizes[best_skill]++;
+            labels[item] = best_skill;
+            num_moves++;
+        }
+        if (num_moves == 0) break;
+    }
+}
+
+#endif
@@ -0,0 +1,131 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef PERF_COUNTERS_CPP
+#define PERF_COUNTERS_CPP
+
+#include "PerfCounters.hpp"
+
+#ifdef __linux__
+#include <cstring>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+using namespace std;
+
+const char * perf_event_names[NUM_PERF_EVENTS] = {"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"};
+
+
+#ifdef __linux__
+
+// opens one counter for the calling thread and the threads it starts afterwards, on any cpu. returns -1 on failure
+static int open_counter(const unsigned int type, const unsigned long long config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1; // user space only, which is all that perf_event_paranoid = 2 allows
+    attr.exclude_hv = 1;
+    attr.inherit = 1; // FixedSkillBKT's worker threads. their counts are added in when they exit
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING; // to scale up the counts when the kernel multiplexes events
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+PerfCounters::PerfCounters() {
+    const unsigned long long l1d_read_miss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    const unsigned long long llc_read_miss = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    fds[PERF_CYCLES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    fds[PERF_INSTRUCTIONS] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[PERF_L1D_MISSES] = open_counter(PERF_TYPE_HW_CACHE, l1d_read_miss);
+    fds[PERF_LLC_MISSES] = open_counter(PERF_TYPE_HW_CACHE, llc_read_miss);
+    fds[PERF_BRANCH_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+}
+
+PerfCounters::~PerfCounters() {
+    for (size_t event = 0; event < NUM_PERF_EVENTS; event++) {
+        if (fds[event] >= 0) close(fds[event]);
+    }
+}
+
+void PerfCounters::read(perf_counts & counts) const {
+    for (size_t event = 0; event < NUM_PERF_EVENTS; event++) {
+        // the count, then the time the event was enabled and the time it was actually on a hardware counter
+        unsigned long long buffer[3];
+        if (fds[event] < 0 || ::read(fds[event], buffer, sizeof(buffer)) != sizeof(buffer) || buffer[2] == 0) {
+            counts.values[event] = -1; // never scheduled counts as unmeasured
+            continue;
+        }
+        if (buffer[2] >= buffer[1]) counts.values[event] = (long long) buffer[0];
+        else counts.values[event] = (long long) ((double) buffer[0] * buffer[1] / buffer[2]); // multiplexed: extrapolate to the whole span
+    }
+}
+
+#else
+
+PerfCounters::PerfCounters() {
+    for (size_t event = 0; event < NUM_PERF_EVENTS; event++) fds[event] = -1;
+}
+
+PerfCounters::~PerfCounters() {
+
+}
+
+void PerfCounters::read(perf_counts & counts) const {
+    for (size_t event = 0; event < NUM_PERF_EVENTS; event++) counts.values[event] = -1;
+}
+
+#endif
+
+
+bool PerfCounters::available() const {
+    for (size_t event = 0; event < NUM_PERF_EVENTS; event++) {
+        if (fds[event] >= 0) return true;
+    }
+    return false;
+}
+
+
+perf_counts PerfCounters::difference(const perf_counts & after, const perf_counts & before) {
+    perf_counts diff;
+    for (size_t event = 0; event < NUM_PERF_EVENTS; event++) {
+        diff.values[event] = (after.values[event] < 0 || before.values[event] < 0) ? -1 : after.values[event] - before.values[event];
+    }
+    return diff;
+}
+
+
+
+perf_counts PerfCounters::sum(const perf_counts & a, const perf_counts & b) {
+    perf_counts total;
+    for (size_t event = 0; event < NUM_PERF_EVENTS; event++) {
+        total.values[event] = (a.values[event] < 0 || b.values[event] < 0) ? -1 : a.values[event] + b.values[event];
+    }
+    return total;
+}
+
+#endif
@@ -0,0 +1,292 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef POSTERIOR_CPP
+#define POSTERIOR_CPP
+
+#include "Posterior.hpp"
+
+using namespace std;
+
+
+void write_posterior_header(ostream & out, const size_t num_items, const size_t num_samples, const int num_samples_width) {
+    out << "wcrp_posterior\t3" << endl;
+    out << "num_items\t" << num_items << endl;
+    out << "num_samples\t" << setfill('0') << setw(num_samples_width) << num_samples << setfill(' ') << endl;
+}
+
+
+void write_posterior_sample(ostream & out, const posterior_sample & sample) {
+    const size_t num_items = sample.skill_labels.size();
+    assert(sample.weight > 0);
+    out << setprecision(17);
+    out << "sample\t" << sample.skill_parameters.size() << "\t" << sample.log_alpha_prime << "\t" << sample.log_gamma << "\t" << sample.weight << endl;
+    for (size_t item = 0; item < num_items; item++) out << sample.skill_labels[item] << (item + 1 < num_items ? " " : "\n");
+    for (size_t skill = 0; skill < sample.skill_parameters.size(); skill++) {
+        const struct bkt_parameters & params = sample.skill_parameters[skill];
+        out << params.psi << "\t" << params.mu << "\t" << params.pi1 << "\t" << params.prop0 << endl;
+    }
+}
+
+
+void save_posterior(const char * filename, const vector<posterior_sample> & samples) {
+    assert(!samples.empty());
+    const size_t num_items = samples[0].skill_labels.size();
+
+    ofstream out(filename, ofstream::out);
+    if (!out.is_open()) {
+        cerr << "couldn't open " << string(filename) << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    write_posterior_header(out, num_items, samples.size());
+    for (size_t sample = 0; sample < samples.size(); sample++) {
+        assert(samples[sample].skill_labels.size() == num_items);
+        write_posterior_sample(out, samples[sample]);
+    }
+}
+
+
+// exits with a message naming the file if the stream failed or the condition doesn't hold
+static void check_posterior_file(const istream & in, const bool condition, const char * filename) {
+    if (in.fail() || !condition) {
+        cerr << string(filename) << " isn't a valid posterior file" << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+void load_posterior(const char * filename, vector<posterior_sample> & samples, size_t & num_items) {
+    ifstream in(filename);
+    if (!in.is_open()) {
+        cerr << "couldn't open " << string(filename) << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    string key;
+    size_t version, num_samples;
+    in >> key >> version;
+    check_posterior_file(in, key == "wcrp_posterior" && version >= 1 && version <= 3, filename);
+    in >> key >> num_items;
+    check_posterior_file(in, key == "num_items" && num_items > 0, filename);
+    in >> key >> num_samples;
+    check_posterior_file(in, key == "num_samples" && num_samples > 0, filename);
+
+    samples.assign(num_samples, posterior_sample());
+    for (size_t sample = 0; sample < num_samples; sample++) {
+        posterior_sample & cur = samples[sample];
+        size_t num_skills;
+        in >> key >> num_skills;
+        check_posterior_file(in, key == "sample" && num_skills > 0, filename);
+        if (version >= 2) {
+            // read as strings since log(gamma) is -inf when beta was fixed at 1, which istream won't parse
+            string log_alpha_prime, log_gamma;
+            in >> log_alpha_prime >> log_gamma;
+            check_posterior_file(in, true, filename);
+            cur.log_alpha_prime = strtod(log_alpha_prime.c_str(), NULL);
+            cur.log_gamma = strtod(log_gamma.c_str(), NULL);
+        }
+        else cur.log_alpha_prime = cur.log_gamma = NAN; // version 1 files didn't record them
+        cur.weight = 1.0;
+        if (version >= 3) {
+            in >> cur.weight;
+            check_posterior_file(in, cur.weight > 0, filename);
+        }
+        cur.skill_labels.resize(num_items);
+        for (size_t item = 0; item < num_items; item++) {
+            in >> cur.skill_labels[item];
+            check_posterior_file(in, cur.skill_labels[item] < num_skills, filename);
+        }
+        cur.skill_parameters.resize(num_skills);
+        for (size_t skill = 0; skill < num_skills; skill++) {
+            struct bkt_parameters & params = cur.skill_parameters[skill];
+            in >> params.psi >> params.mu >> params.pi1 >> params.prop0;
+            check_posterior_file(in, true, filename);
+        }
+    }
+}
+
+
+PosteriorPredictor::PosteriorPredictor(const vector<posterior_sample> & samples, const size_t num_items) :
+    num_items(num_items),
+    num_samples(samples.size()) {
+
+    assert(num_samples > 0);
+    double total_weight = 0.0;
+    for (size_t sample = 0; sample < num_samples; sample++) total_weight += samples[sample].weight;
+    slot.resize(num_samples * num_items);
+    for (size_t sample = 0; sample < num_samples; sample++) {
+        const posterior_sample & cur = samples[sample];
+        weight.push_back(cur.weight / total_weight);
+        assert(cur.skill_labels.size() == num_items);
+        const size_t offset = psi.size();
+        for (size_t item = 0; item < num_items; item++) slot[sample * num_items + item] = offset + cur.skill_labels[item];
+        for (size_t skill = 0; skill < cur.skill_parameters.size(); skill++) {
+            const struct bkt_parameters & params = cur.skill_parameters[skill];
+            psi.push_back(params.psi);
+            mu.push_back(params.mu);
+            pi1.push_back(params.pi1);
+            pi0.push_back(params.pi1 * params.prop0);
+        }
+    }
+}
+
+
+size_t PosteriorPredictor::get_num_items() const {
+    return num_items;
+}
+
+
+size_t PosteriorPredictor::get_num_samples() const {
+    return num_samples;
+}
+
+
+void PosteriorPredictor::init_state(vector<double> & state) const {
+    state = psi;
+}
+
+
+double PosteriorPredictor::predict(const vector<double> & state, const size_t item) const {
+    assert(item < num_items && state.size() == psi.size());
+    double total = 0.0;
+    for (size_t sample = 0; sample < num_samples; sample++) {
+        const size_t k = slot[sample * num_items + item];
+        total += weight[sample] * (pi0[k] * (1.0 - state[k]) + pi1[k] * state[k]);
+    }
+    return total;
+}
+
+
+void PosteriorPredictor::predict_each(const vector<double> & state, const size_t item, double * probs) const {
+    assert(item < num_items && state.size() == psi.size());
+    for (size_t sample = 0; sample < num_samples; sample++) {
+        const size_t k = slot[sample * num_items + item];
+        probs[sample] = pi0[k] * (1.0 - state[k]) + pi1[k] * state[k];
+    }
+}
+
+
+void PosteriorPredictor::observe(vector<double> & state, const size_t item, const bool recalled) const {
+    assert(item < num_items && state.size() == psi.size());
+    for (size_t sample = 0; sample < num_samples; sample++) {
+        const size_t k = slot[sample * num_items + item];
+        const double cur_p_hat = state[k];
+        if (recalled) state[k] = (pi1[k] * cur_p_hat + mu[k] * pi0[k] * (1.0 - cur_p_hat)) / (pi1[k] * cur_p_hat + pi0[k] * (1.0 - cur_p_hat));
+        else state[k] = ((1.0 - pi1[k]) * cur_p_hat + mu[k] * (1.0 - pi0[k]) * (1.0 - cur_p_hat)) / ((1.0 - pi1[k]) * cur_p_hat + (1.0 - pi0[k]) * (1.0 - cur_p_hat));
+    }
+}
+
+
+// probs[trial * num_samples + sample] = the probability of recall under the sample. targets[trial] = the full posterior's
+static void compute_validation_probs(const PosteriorPredictor & predictor, const vector< vector<bool> > & recall_sequences, const vector< vector<size_t> > & item_sequences, vector<float> & probs, vector<double> & targets, vector<bool> & recalls) {
+    const size_t num_samples = predictor.get_num_samples();
+    vector<double> state, sample_probs(num_samples);
+    for (size_t student = 0; student < item_sequences.size(); student++) {
+        predictor.init_state(state);
+        for (size_t trial = 0; trial < item_sequences[student].size(); trial++) {
+            const size_t item = item_sequences[student][trial];
+            const bool recalled = recall_sequences[student][trial];
+            predictor.predict_each(state, item, &sample_probs[0]);
+            probs.insert(probs.end(), sample_probs.begin(), sample_probs.end());
+            targets.push_back(predictor.predict(state, item));
+            recalls.push_back(recalled);
+            predictor.observe(state, item, recalled);
+        }
+    }
+}
+
+
+// mean negative log probability of the responses
+static double cross_entropy(const vector<double> & predictions, const vector<bool> & recalls) {
+    double total = 0.0;
+    for (size_t trial = 0; trial < recalls.size(); trial++) {
+        const double p = min(1.0 - 1e-12, max(1e-12, predictions[trial]));
+        total -= recalls[trial] ? log(p) : log(1.0 - p);
+    }
+    return total / recalls.size();
+}
+
+
+bool condense_posterior(const vector<posterior_sample> & samples, const size_t num_items, const vector< vector<bool> > & recall_sequences, const vector< vector<size_t> > & item_sequences,
+                        const size_t max_samples, const double tolerance, vector<posterior_sample> & condensed, double & full_cross_entropy, double & condensed_cross_entropy, ostream * progress) {
+
+    assert(max_samples > 0 && tolerance >= 0);
+    const size_t num_samples = samples.size();
+    const PosteriorPredictor predictor(samples, num_items);
+
+    vector<float> probs;
+    vector<double> targets;
+    vector<bool> recalls;
+    compute_validation_probs(predictor, recall_sequences, item_sequences, probs, targets, recalls);
+    const size_t num_trials = recalls.size();
+    assert(num_trials > 0);
+    full_cross_entropy = cross_entropy(targets, recalls);
+    if (progress) *progress << "full posterior: " << num_samples << " samples, validation cross-entropy " << setprecision(6) << full_cross_entropy << " over " << num_trials << " trials" << endl;
+
+    vector<double> norms(num_samples, 0.0);
+    for (size_t trial = 0; trial < num_trials; trial++) {
+        for (size_t sample = 0; sample < num_samples; sample++) norms[sample] += probs[trial * num_samples + sample] * probs[trial * num_samples + sample];
+    }
+
+    // pick n chooses the sample minimizing || picked_sum + probs[sample] - n * targets ||^2
+    vector<double> picked_sum(num_trials, 0.0), predictions(num_trials), scores(num_samples);
+    vector<size_t> num_picks(num_samples, 0);
+    bool reached = false;
+    for (size_t n = 1; n <= max_samples && !reached; n++) {
+        scores = norms;
+        for (size_t trial = 0; trial < num_trials; trial++) {
+            const double residual = 2.0 * (picked_sum[trial] - n * targets[trial]);
+            const float * trial_probs = &probs[trial * num_samples];
+            for (size_t sample = 0; sample < num_samples; sample++) scores[sample] += residual * trial_probs[sample];
+        }
+        const size_t pick = min_element(scores.begin(), scores.end()) - scores.begin();
+        num_picks[pick]++;
+        for (size_t trial = 0; trial < num_trials; trial++) {
+            picked_sum[trial] += probs[trial * num_samples + pick];
+            predictions[trial] = picked_sum[trial] / n;
+        }
+
+        condensed_cross_entropy = cross_entropy(predictions, recalls);
+        reached = fabs(condensed_cross_entropy - full_cross_entropy) <= tolerance;
+        if (progress) {
+            const size_t num_distinct = num_samples - count(num_picks.begin(), num_picks.end(), 0);
+            *progress << n << " picks, " << num_distinct << " distinct samples: validation cross-entropy " << condensed_cross_entropy
+                      << " (" << showpos << condensed_cross_entropy - full_cross_entropy << noshowpos << ")" << endl;
+        }
+    }
+
+    condensed.clear();
+    size_t total_picks = 0;
+    for (size_t sample = 0; sample < num_samples; sample++) total_picks += num_picks[sample];
+    for (size_t sample = 0; sample < num_samples; sample++) {
+        if (num_picks[sample] == 0) continue;
+        condensed.push_back(samples[sample]);
+        condensed.back().weight = num_picks[sample] / (double) total_picks;
+    }
+    return reached;
+}
+
+#endif
@@ -0,0 +1,224 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef SAMPLE_SINK_CPP
+#define SAMPLE_SINK_CPP
+
+#include "SampleSink.hpp"
+#include "Posterior.hpp"
+
+using namespace std;
+
+
+void InMemorySampleSink::add_sample(const chain_sample & sample, const vector< vector<double> > & predictions) {
+    train_ll_samples.push_back(sample.train_ll);
+    log_alpha_prime_samples.push_back(sample.log_alpha_prime);
+    log_gamma_samples.push_back(sample.log_gamma);
+    skill_label_samples.push_back(sample.skill_labels);
+    skill_parameter_samples.push_back(sample.skill_parameters);
+
+    if (pRT_samples.size() < predictions.size()) pRT_samples.resize(predictions.size());
+    for (size_t student = 0; student < predictions.size(); student++) {
+        const vector<double> & student_predictions = predictions[student];
+        vector< vector<double> > & student_samples = pRT_samples[student];
+        if (student_samples.size() < student_predictions.size()) student_samples.resize(student_predictions.size());
+        for (size_t trial = 0; trial < student_predictions.size(); trial++) student_samples[trial].push_back(student_predictions[trial]);
+    }
+}
+
+
+void InMemorySampleSink::clear() {
+    pRT_samples.clear();
+    skill_label_samples.clear();
+    train_ll_samples.clear();
+    skill_parameter_samples.clear();
+    log_alpha_prime_samples.clear();
+    log_gamma_samples.clear();
+}
+
+
+double InMemorySampleSink::get_estimated_recall_prob(const size_t student, const size_t trial) const {
+    assert(student < pRT_samples.size() && !pRT_samples[student].at(trial).empty()); // need to have called run_mcmc first
+    const vector<double> & samples = pRT_samples[student][trial];
+    return accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+}
+
+
+vector< vector<size_t> > InMemorySampleSink::get_sampled_skill_labels() const {
+    assert(!skill_label_samples.empty()); // need to have called run_mcmc first
+    return skill_label_samples;
+}
+
+
+vector<size_t> InMemorySampleSink::get_most_likely_skill_labels() const {
+    assert(!skill_label_samples.empty()); // need to have called run_mcmc first
+    assert(train_ll_samples.size() == skill_label_samples.size());
+
+    double best_ll = 0;
+    size_t best_sample = 0;
+
+    for (size_t sample = 0; sample < train_ll_samples.size(); sample++) {
+        if (sample == 0 || train_ll_samples.at(sample) > best_ll) {
+            best_ll = train_ll_samples.at(sample);
+            best_sample = sample;
+        }
+    }
+
+    return skill_label_samples.at(best_sample);
+}
+
+
+vector< vector<struct bkt_parameters> > InMemorySampleSink::get_sampled_skill_parameters() const {
+    assert(!skill_parameter_samples.empty()); // need to have called run_mcmc first
+    return skill_parameter_samples;
+}
+
+
+vector<double> InMemorySampleSink::get_train_ll_samples() const {
+    assert(!train_ll_samples.empty()); // need to have called run_mcmc first
+    return train_ll_samples;
+}
+
+
+void InMemorySampleSink::get_sampled_wcrp_hyperparameters(vector<double> & log_alpha_primes, vector<double> & log_gammas) const {
+    assert(!log_alpha_prime_samples.empty()); // need to have called run_mcmc first
+    log_alpha_primes = log_alpha_prime_samples;
+    log_gammas = log_gamma_samples;
+}
+
+
+/////////////////////////////////////////////////
+
+
+#define NUM_SAMPLES_WIDTH 20 // digits reserved for the header's sample count
+
+
+StreamingSampleSink::StreamingSampleSink(const char * filename) : filename(filename), num_samples(0), num_items(0) {
+    out.open(filename, ofstream::out | ofstream::trunc);
+    if (!out.is_open()) {
+        cerr << "couldn't open " << this->filename << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+void StreamingSampleSink::write_header() {
+    out.seekp(0);
+    write_posterior_header(out, num_items, num_samples, NUM_SAMPLES_WIDTH);
+    out.seekp(0, ios_base::end);
+}
+
+
+void StreamingSampleSink::add_sample(const chain_sample & sample, const vector< vector<double> > & /*predictions*/) {
+    if (num_samples == 0) {
+        num_items = sample.skill_labels.size();
+        write_header();
+    }
+    assert(sample.skill_labels.size() == num_items);
+
+    posterior_sample cur;
+    cur.skill_labels = sample.skill_labels;
+    cur.skill_parameters = sample.skill_parameters;
+    cur.log_alpha_prime = sample.log_alpha_prime;
+    cur.log_gamma = sample.log_gamma;
+    cur.weight = 1.0;
+    write_posterior_sample(out, cur);
+
+    num_samples++;
+    write_header();
+    out.flush();
+    if (!out.good()) {
+        cerr << "couldn't write to " << filename << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+void StreamingSampleSink::clear() {
+    out.close();
+    out.open(filename.c_str(), ofstream::out | ofstream::trunc);
+    num_samples = 0;
+}
+
+
+/////////////////////////////////////////////////
+
+
+SummarySampleSink::SummarySampleSink(const bool keep_predictions) : keep_predictions(keep_predictions) {
+    clear();
+}
+
+
+void SummarySampleSink::add_sample(const chain_sample & sample, const vector< vector<double> > & predictions) {
+    num_samples++;
+    if (num_samples == 1 || sample.train_ll > most_likely_sample.train_ll) most_likely_sample = sample;
+
+    const double delta_ll = sample.train_ll - mean_train_ll;
+    mean_train_ll += delta_ll / num_samples;
+    train_ll_m2 += delta_ll * (sample.train_ll - mean_train_ll);
+
+    const double num_skills = sample.skill_parameters.size();
+    const double delta_skills = num_skills - mean_num_skills;
+    mean_num_skills += delta_skills / num_samples;
+    num_skills_m2 += delta_skills * (num_skills - mean_num_skills);
+
+    if (prediction_sums.size() < predictions.size()) prediction_sums.resize(predictions.size());
+    for (size_t student = 0; student < predictions.size(); student++) {
+        if (prediction_sums[student].size() < predictions[student].size()) prediction_sums[student].resize(predictions[student].size(), 0.0);
+        for (size_t trial = 0; trial < predictions[student].size(); trial++) prediction_sums[student][trial] += predictions[student][trial];
+    }
+}
+
+
+void SummarySampleSink::clear() {
+    num_samples = 0;
+    mean_train_ll = train_ll_m2 = 0.0;
+    mean_num_skills = num_skills_m2 = 0.0;
+    prediction_sums.clear();
+}
+
+
+double SummarySampleSink::get_train_ll_variance() const {
+    return num_samples > 1 ? train_ll_m2 / (num_samples - 1) : 0.0;
+}
+
+
+double SummarySampleSink::get_num_skills_variance() const {
+    return num_samples > 1 ? num_skills_m2 / (num_samples - 1) : 0.0;
+}
+
+
+const chain_sample & SummarySampleSink::get_most_likely_sample() const {
+    assert(num_samples > 0); // need to have called run_mcmc first
+    return most_likely_sample;
+}
+
+
+double SummarySampleSink::get_estimated_recall_prob(const size_t student, const size_t trial) const {
+    assert(keep_predictions && num_samples > 0); // need to have called run_mcmc first
+    return prediction_sums.at(student).at(trial) / num_samples;
+}
+
+#endif
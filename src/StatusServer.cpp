@@ -0,0 +1,195 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef STATUS_SERVER_CPP
+#define STATUS_SERVER_CPP
+
+#include "StatusServer.hpp"
+#include "Diagnostics.hpp"
+
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+
+StatusServer::StatusServer(const string & socket_path, const string & checkpoint_file, const string & dump_prefix) :
+    socket_path(socket_path),
+    default_checkpoint_file(checkpoint_file),
+    default_dump_prefix(dump_prefix),
+    listen_fd(-1),
+    stopping(false),
+    have_status(false),
+    checkpoint_requested(false),
+    dump_requested(false) {
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        cerr << "socket path " << socket_path << " is too long" << endl;
+        exit(EXIT_FAILURE);
+    }
+    strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    unlink(socket_path.c_str()); // left over from a previous run
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(listen_fd, 8) != 0) {
+        cerr << "couldn't listen on " << socket_path << ": " << strerror(errno) << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    server_thread = thread(&StatusServer::serve, this);
+}
+
+
+StatusServer::~StatusServer() {
+    stopping = true;
+    server_thread.join();
+    close(listen_fd);
+    unlink(socket_path.c_str());
+}
+
+
+void StatusServer::publish(const run_status & status) {
+    unique_lock<mutex> guard(status_lock, try_to_lock);
+    if (!guard.owns_lock()) return; // a reader is copying the previous status; it'll get the next one
+    latest_status = status;
+    have_status = true;
+}
+
+
+bool StatusServer::take_checkpoint_request(string & filename) {
+    unique_lock<mutex> guard(status_lock, try_to_lock);
+    if (!guard.owns_lock() || !checkpoint_requested) return false;
+    checkpoint_requested = false;
+    filename = checkpoint_request_file;
+    return true;
+}
+
+
+bool StatusServer::take_dump_request(string & prefix) {
+    unique_lock<mutex> guard(status_lock, try_to_lock);
+    if (!guard.owns_lock() || !dump_requested) return false;
+    dump_requested = false;
+    prefix = dump_request_prefix;
+    return true;
+}
+
+
+string StatusServer::status_json(const run_status & status) {
+    ostringstream out;
+    out << setprecision(6);
+    const double seconds_per_iteration = status.iteration > 0 ? status.elapsed_seconds / status.iteration : 0.0;
+    out << "{\"run\": ";
+    write_json_string(out, status.run_name);
+    out << ", \"iteration\": " << status.iteration << ", \"num_iterations\": " << status.num_iterations << ", \"burn\": " << status.burn
+        << ", \"elapsed_seconds\": " << status.elapsed_seconds << ", \"eta_seconds\": " << seconds_per_iteration * (status.num_iterations - status.iteration)
+        << ", \"num_skills\": " << status.num_skills << ", \"beta\": " << status.beta << ", \"alpha_prime\": " << status.alpha_prime << ", \"pruned_fraction\": " << status.pruned_fraction;
+    out << ", \"phase_seconds\": {";
+    for (size_t phase = 0; phase < NUM_SAMPLER_PHASES; phase++) out << (phase > 0 ? ", " : "") << "\"" << sampler_phase_names[phase] << "\": " << status.phase_seconds[phase];
+    out << "}, \"recent_train_ll\": [";
+    for (size_t i = 0; i < status.recent_train_ll.size(); i++) out << (i > 0 ? ", " : "") << status.recent_train_ll[i];
+    out << "], \"resident_memory_kb\": " << current_resident_memory_kb() << ", \"peak_resident_memory_kb\": " << peak_resident_memory_kb() << "}";
+    return out.str();
+}
+
+
+string StatusServer::handle_command(const string & line) {
+    vector<string> words;
+    string trimmed = boost::trim_copy(line);
+    if (!trimmed.empty()) boost::split(words, trimmed, boost::is_any_of(" \t"), boost::token_compress_on);
+    const string command = words.empty() ? "status" : words[0];
+
+    if (command == "status") {
+        run_status status;
+        {
+            lock_guard<mutex> guard(status_lock);
+            if (!have_status) return "{\"iteration\": 0}";
+            status = latest_status;
+        }
+        return status_json(status); // formatted without holding the lock
+    }
+
+    if (command == "checkpoint" || command == "dump") {
+        const bool is_checkpoint = command == "checkpoint";
+        const string filename = words.size() > 1 ? words[1] : (is_checkpoint ? default_checkpoint_file : default_dump_prefix);
+        if (filename.empty()) return "{\"error\": \"no file given and no default configured\"}";
+        lock_guard<mutex> guard(status_lock);
+        if (is_checkpoint) {
+            checkpoint_requested = true;
+            checkpoint_request_file = filename;
+        }
+        else {
+            dump_requested = true;
+            dump_request_prefix = filename;
+        }
+        ostringstream out;
+        out << "{\"requested\": \"" << command << "\", \"file\": ";
+        write_json_string(out, filename);
+        out << "}";
+        return out.str();
+    }
+
+    return "{\"error\": \"unknown command. use status, checkpoint [file] or dump [prefix]\"}";
+}
+
+
+// accepts one connection at a time. polls so that the destructor can stop it
+void StatusServer::serve() {
+    while (!stopping) {
+        struct pollfd listener;
+        listener.fd = listen_fd;
+        listener.events = POLLIN;
+        if (poll(&listener, 1, 100) <= 0) continue;
+
+        const int client_fd = accept(listen_fd, NULL, NULL);
+        if (client_fd < 0) continue;
+
+        // read one line, giving up on clients that don't send one within a second
+        string line;
+        char c;
+        struct pollfd client;
+        client.fd = client_fd;
+        client.events = POLLIN;
+        while (line.size() < 1024 && poll(&client, 1, 1000) > 0 && read(client_fd, &c, 1) == 1 && c != '\n') line += c;
+
+        const string reply = handle_command(line) + "\n";
+        size_t written = 0;
+        while (written < reply.size()) {
+            const ssize_t result = send(client_fd, reply.data() + written, reply.size() - written, MSG_NOSIGNAL); // a client hanging up mustn't kill the sampler
+            if (result <= 0) break;
+            written += result;
+        }
+        close(client_fd);
+    }
+}
+
+#endif
@@ -0,0 +1,196 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef TRACE_CPP
+#define TRACE_CPP
+
+#include "Trace.hpp"
+#include "common.hpp"
+
+#include <mutex>
+#include <csignal>
+#include <cstdio>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#else
+#include <pthread.h>
+#endif
+
+using namespace std;
+
+struct trace_event {
+    const char * name;
+    const char * category;
+    const char * arg_name;
+    long long arg;
+    double begin_time;
+    double end_time;
+};
+
+
+// one thread's ring buffer. the owning thread appends while a dump may read from another thread,
+// hence the (uncontended, in the common case) lock
+struct trace_buffer {
+    long long tid;
+    mutex lock;
+    vector<trace_event> events;
+    size_t next;    // slot the next event goes in
+    size_t count;   // number of valid events, at most events.size()
+};
+
+
+static bool tracing = false;
+static string trace_filename;
+static size_t trace_capacity = 0;
+static double trace_start_time = 0;
+static mutex registry_lock;
+static vector<trace_buffer *> registry;  // never freed: buffers of exited threads still get dumped
+static volatile sig_atomic_t snapshot_requested = 0;
+static thread_local trace_buffer * thread_buffer = NULL;
+
+
+static long long current_thread_id() {
+#ifdef __linux__
+    return (long long) syscall(SYS_gettid);
+#else
+    return (long long) (size_t) pthread_self();
+#endif
+}
+
+
+static trace_buffer * get_thread_buffer() {
+    if (!thread_buffer) {
+        thread_buffer = new trace_buffer();
+        thread_buffer->tid = current_thread_id();
+        thread_buffer->events.resize(trace_capacity);
+        thread_buffer->next = 0;
+        thread_buffer->count = 0;
+        lock_guard<mutex> guard(registry_lock);
+        registry.push_back(thread_buffer);
+    }
+    return thread_buffer;
+}
+
+
+static void handle_snapshot_signal(int) {
+    snapshot_requested = 1;
+}
+
+
+static void dump_at_exit() {
+    trace_dump();
+}
+
+
+void trace_enable(const string & filename, const size_t events_per_thread) {
+    assert(!tracing);
+    assert(events_per_thread > 0);
+    trace_filename = filename;
+    trace_capacity = events_per_thread;
+    trace_start_time = get_wall_time();
+    tracing = true;
+    atexit(dump_at_exit);
+    signal(SIGUSR1, handle_snapshot_signal);
+}
+
+
+bool trace_enabled() {
+    return tracing;
+}
+
+
+void trace_complete(const char * name, const char * category, const double begin_time, const double end_time, const char * arg_name, const long long arg) {
+    if (!tracing) return;
+    trace_buffer * buffer = get_thread_buffer();
+    lock_guard<mutex> guard(buffer->lock);
+    trace_event & event = buffer->events[buffer->next];
+    event.name = name;
+    event.category = category;
+    event.arg_name = arg_name;
+    event.arg = arg;
+    event.begin_time = begin_time;
+    event.end_time = end_time;
+    buffer->next = (buffer->next + 1) % buffer->events.size();
+    if (buffer->count < buffer->events.size()) buffer->count++;
+}
+
+
+void trace_dump() {
+    if (!tracing) return;
+
+    FILE * out = fopen(trace_filename.c_str(), "w");
+    if (!out) {
+        cerr << "couldn't open " << trace_filename << endl;
+        return;
+    }
+
+    const long long pid = (long long) getpid();
+    fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    bool first = true;
+    lock_guard<mutex> registry_guard(registry_lock);
+    for (size_t b = 0; b < registry.size(); b++) {
+        trace_buffer * buffer = registry[b];
+        lock_guard<mutex> guard(buffer->lock);
+        fprintf(out, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %lld, \"tid\": %lld, \"args\": {\"name\": \"%s %lu\"}}",
+                first ? "" : ",\n", pid, buffer->tid, b == 0 ? "main" : "worker", (unsigned long) b);
+        first = false;
+        // oldest first
+        const size_t oldest = (buffer->next + buffer->events.size() - buffer->count) % buffer->events.size();
+        for (size_t i = 0; i < buffer->count; i++) {
+            const trace_event & event = buffer->events[(oldest + i) % buffer->events.size()];
+            fprintf(out, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": %lld, \"tid\": %lld",
+                    event.name, event.category, (event.begin_time - trace_start_time) * 1e6, (event.end_time - event.begin_time) * 1e6, pid, buffer->tid);
+            if (event.arg_name) fprintf(out, ", \"args\": {\"%s\": %lld}", event.arg_name, event.arg);
+            fprintf(out, "}");
+        }
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+}
+
+
+void trace_poll() {
+    if (!snapshot_requested) return;
+    snapshot_requested = 0;
+    trace_dump();
+}
+
+
+TraceScope::TraceScope(const char * name, const char * category, const char * arg_name, const long long arg) :
+    name(name),
+    category(category),
+    arg_name(arg_name),
+    arg(arg),
+    begin_time(tracing ? get_wall_time() : -1) {
+
+}
+
+
+TraceScope::~TraceScope() {
+    if (begin_time >= 0) trace_complete(name, category, begin_time, get_wall_time(), arg_name, arg);
+}
+
+#endif
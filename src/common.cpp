@@ -27,11 +27,16 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define COMMON_CPP
 
 #include "common.hpp"
+#include "Trace.hpp"
+
+const char * sampler_phase_names[NUM_SAMPLER_PHASES] = {"hyperparameters", "bkt_parameters", "seating", "likelihood", "record"};
 
 // reads a tab delimited file with the columns: student id, item id, skill id, recall success
 // all ids are assumed to start at 0 and be contiguous
 void load_student_data(const char * filename, std::vector< std::vector<bool> > & recall_sequences, std::vector< std::vector<size_t> > & item_sequences, size_t & num_students, size_t & num_items, size_t & num_skills) {
 
+    TraceScope scope("load_student_data", "io");
+
     num_students=0, num_items=0;
     size_t student, item, recall;
 
@@ -68,6 +73,8 @@ void load_student_data(const char * filename, std::vector< std::vector<bool> > &
 // reads a text file with expert-provided skill ids
 void load_expert_labels(const char * filename, std::vector<size_t> & provided_skill_labels, const size_t num_items) {
 
+    TraceScope scope("load_expert_labels", "io");
+
     std::ifstream in(filename);
     if (!in.is_open()) {
         std::cerr << "couldn't open " << std::string(filename) << std::endl;
@@ -85,6 +92,8 @@ void load_expert_labels(const char * filename, std::vector<size_t> & provided_sk
 // reads the K-fold cross validation assignments
 void load_splits(const char * filename, std::vector<std::vector<size_t> > & fold_nums, size_t & num_folds, const size_t num_students) {
 
+    TraceScope scope("load_splits", "io");
+
     std::ifstream in(filename);
     if (!in.is_open()) {
         std::cerr << "couldn't open " << std::string(filename) << std::endl;
@@ -116,4 +125,29 @@ void load_splits(const char * filename, std::vector<std::vector<size_t> > & fold
     std::cout << "# folds per replication = " << num_folds << std::endl;
 }
 
+
+// returns the current wall-clock time in seconds
+double get_wall_time() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+void write_json_string(std::ostream & out, const std::string & value) {
+    out << "\"";
+    for (size_t c = 0; c < value.size(); c++) {
+        const unsigned char ch = (unsigned char) value[c];
+        if (ch == '"' || ch == '\\') out << "\\" << value[c];
+        else if (ch == '\n') out << "\\n";
+        else if (ch == '\t') out << "\\t";
+        else if (ch < 0x20) {
+            const char * hex = "0123456789abcdef";
+            out << "\\u00" << hex[ch >> 4] << hex[ch & 0xf];
+        }
+        else out << value[c];
+    }
+    out << "\"";
+}
+
 #endif
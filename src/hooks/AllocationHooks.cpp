@@ -0,0 +1,225 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ALLOCATION_HOOKS_CPP
+#define ALLOCATION_HOOKS_CPP
+
+#include "AllocationTracker.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+// replaces the global operator new and operator delete (and, with WCRP_TRACK_MALLOC, malloc and friends) so that
+// AllocationTracker can count them. it isn't part of the wcrp library: only the programs that report allocations link it
+
+#if defined(WCRP_TRACK_MALLOC) && defined(__GLIBC__)
+
+// interpose on glibc's allocator. operator new goes through malloc, so it isn't counted twice
+
+extern "C" {
+
+void * __libc_malloc(size_t size);
+void * __libc_calloc(size_t count, size_t size);
+void * __libc_realloc(void * ptr, size_t size);
+void __libc_free(void * ptr);
+void * __libc_memalign(size_t alignment, size_t size);
+
+void * malloc(size_t size) {
+    allocation_tracking_count_allocation(size);
+    return __libc_malloc(size);
+}
+
+void * calloc(size_t count, size_t size) {
+    allocation_tracking_count_allocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+void * realloc(void * ptr, size_t size) {
+    allocation_tracking_count_deallocation(ptr);
+    allocation_tracking_count_allocation(size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void * ptr) {
+    allocation_tracking_count_deallocation(ptr);
+    __libc_free(ptr);
+}
+
+void * memalign(size_t alignment, size_t size) {
+    allocation_tracking_count_allocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+void * aligned_alloc(size_t alignment, size_t size) {
+    allocation_tracking_count_allocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void ** ptr, size_t alignment, size_t size) {
+    allocation_tracking_count_allocation(size);
+    void * aligned = __libc_memalign(alignment, size);
+    if (!aligned) return ENOMEM;
+    *ptr = aligned;
+    return 0;
+}
+
+}
+
+static inline void * tracked_new(const size_t size) {
+    return malloc(size == 0 ? 1 : size);
+}
+
+static inline void * tracked_aligned_new(const size_t size, const size_t alignment) {
+    void * ptr = NULL;
+    return posix_memalign(&ptr, alignment, size == 0 ? 1 : size) == 0 ? ptr : NULL;
+}
+
+static inline void tracked_delete(void * ptr) {
+    free(ptr);
+}
+
+#else
+
+static inline void * tracked_new(const size_t size) {
+    allocation_tracking_count_allocation(size);
+    return malloc(size == 0 ? 1 : size);
+}
+
+static inline void * tracked_aligned_new(const size_t size, const size_t alignment) {
+    allocation_tracking_count_allocation(size);
+    void * ptr = NULL;
+    return posix_memalign(&ptr, alignment, size == 0 ? 1 : size) == 0 ? ptr : NULL;
+}
+
+static inline void tracked_delete(void * ptr) {
+    allocation_tracking_count_deallocation(ptr);
+    free(ptr);
+}
+
+#endif
+
+
+void * operator new(size_t size) {
+    void * ptr = tracked_new(size);
+    if (!ptr) throw bad_alloc();
+    return ptr;
+}
+
+void * operator new[](size_t size) {
+    void * ptr = tracked_new(size);
+    if (!ptr) throw bad_alloc();
+    return ptr;
+}
+
+void * operator new(size_t size, const nothrow_t &) noexcept {
+    return tracked_new(size);
+}
+
+void * operator new[](size_t size, const nothrow_t &) noexcept {
+    return tracked_new(size);
+}
+
+void operator delete(void * ptr) noexcept {
+    tracked_delete(ptr);
+}
+
+void operator delete[](void * ptr) noexcept {
+    tracked_delete(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept {
+    tracked_delete(ptr);
+}
+
+void operator delete[](void * ptr, size_t) noexcept {
+    tracked_delete(ptr);
+}
+
+void operator delete(void * ptr, const nothrow_t &) noexcept {
+    tracked_delete(ptr);
+}
+
+void operator delete[](void * ptr, const nothrow_t &) noexcept {
+    tracked_delete(ptr);
+}
+
+#ifdef __cpp_aligned_new
+
+void * operator new(size_t size, align_val_t alignment) {
+    void * ptr = tracked_aligned_new(size, (size_t) alignment);
+    if (!ptr) throw bad_alloc();
+    return ptr;
+}
+
+void * operator new[](size_t size, align_val_t alignment) {
+    void * ptr = tracked_aligned_new(size, (size_t) alignment);
+    if (!ptr) throw bad_alloc();
+    return ptr;
+}
+
+void * operator new(size_t size, align_val_t alignment, const nothrow_t &) noexcept {
+    return tracked_aligned_new(size, (size_t) alignment);
+}
+
+void * operator new[](size_t size, align_val_t alignment, const nothrow_t &) noexcept {
+    return tracked_aligned_new(size, (size_t) alignment);
+}
+
+void operator delete(void * ptr, align_val_t) noexcept {
+    tracked_delete(ptr);
+}
+
+void operator delete[](void * ptr, align_val_t) noexcept {
+    tracked_delete(ptr);
+}
+
+void operator delete(void * ptr, size_t, align_val_t) noexcept {
+    tracked_delete(ptr);
+}
+
+void operator delete[](void * ptr, size_t, align_val_t) noexcept {
+    tracked_delete(ptr);
+}
+
+void operator delete(void * ptr, align_val_t, const nothrow_t &) noexcept {
+    tracked_delete(ptr);
+}
+
+void operator delete[](void * ptr, align_val_t, const nothrow_t &) noexcept {
+    tracked_delete(ptr);
+}
+
+#endif
+
+
+// lets allocation_tracking_available() tell whether the program linked this file
+static struct hooks_registration {
+    hooks_registration() { allocation_tracking_hooks_installed(); }
+} registration;
+
+#endif
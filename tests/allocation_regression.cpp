@@ -0,0 +1,133 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ALLOCATION_REGRESSION_CPP
+#define ALLOCATION_REGRESSION_CPP
+
+#include "common.hpp"
+#include "MixtureWCRP.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+// keeps the steady-state Gibbs sweep from drifting back toward allocating on every step
+//
+// after a burn-in (so scratch buffers and trial_lookup's vectors have grown to size), the heap allocations made
+// by Gibbs sweeps like run_mcmc's seating phase are counted over several sweeps and divided by the number of Gibbs steps.
+// MAX_ALLOCATIONS_PER_STEP is a ratchet: lower it whenever a change removes allocations from the sweep, never raise it.
+// what's left is mostly cache_p_hat's maps refilling after a table is created or deleted, compute_K's label counts
+// and creating new tables
+
+#define MAX_ALLOCATIONS_PER_STEP 10.0
+
+#define NUM_BURN_SWEEPS 30
+#define NUM_MEASURED_SWEEPS 20
+
+
+class AllocationCountingWCRP : public MixtureWCRP {
+
+  public:
+
+    AllocationCountingWCRP(Random * generator, const Dataset & dataset, const wcrp_config & config) :
+        MixtureWCRP(generator, dataset, config) {}
+
+    // runs one Gibbs sweep over the items, as run_mcmc's seating phase does, and returns the allocations it made
+    unsigned long long sweep_allocations() {
+        const allocation_counts before = read_allocation_counts();
+        generator->shuffle(all_items);
+        for (vector<size_t>::const_iterator item_itr = all_items.begin(); item_itr != all_items.end(); item_itr++) gibbs_resample_skill(*item_itr);
+        return allocation_difference(read_allocation_counts(), before).allocations;
+    }
+
+};
+
+
+// returns true if the sweep stays within budget
+bool check_sweep(const double beta, const size_t num_expert_skills, const string & context) {
+    const size_t num_students = 150, num_items = 40;
+    Random data_generator(7);
+    vector< vector<bool> > recall_sequences;
+    vector< vector<size_t> > item_sequences;
+    make_random_sequences(data_generator, num_students, num_items, 5, 60, recall_sequences, item_sequences);
+    const vector<size_t> provided_skill_labels = random_skill_labels(data_generator, num_items, num_expert_skills);
+    const wcrp_config config = test_config(beta, training_students(num_students, 10));
+    const Dataset dataset(recall_sequences, item_sequences, provided_skill_labels, num_items);
+
+    Random generator(11);
+    AllocationCountingWCRP model(&generator, dataset, config);
+    for (size_t sweep = 0; sweep < NUM_BURN_SWEEPS; sweep++) model.sweep_allocations();
+
+    unsigned long long allocations = 0;
+    for (size_t sweep = 0; sweep < NUM_MEASURED_SWEEPS; sweep++) allocations += model.sweep_allocations();
+    const double per_step = allocations / (1.0 * NUM_MEASURED_SWEEPS * num_items);
+
+    cout << context << ": " << setprecision(2) << per_step << " allocations per Gibbs step (budget " << MAX_ALLOCATIONS_PER_STEP << ")" << endl;
+    return per_step <= MAX_ALLOCATIONS_PER_STEP;
+}
+
+
+vector<double> * volatile probe; // volatile so the compiler can't elide the probe allocations
+
+struct alignas(64) aligned_probe_type {
+    double values[8];
+};
+aligned_probe_type * volatile aligned_probe;
+
+
+int main() {
+
+    cout.setf(ios::fixed);
+
+    // make sure allocations are being counted at all, or the budget check passes vacuously
+    if (!allocation_tracking_available()) {
+        cerr << "the allocation hooks aren't linked in" << endl;
+        return EXIT_FAILURE;
+    }
+    allocation_tracking_enable();
+    const allocation_counts before = read_allocation_counts();
+    probe = new vector<double>(10);
+    delete probe;
+    const allocation_counts probe_counts = allocation_difference(read_allocation_counts(), before);
+    if (probe_counts.allocations < 2 || probe_counts.deallocations < 2) {
+        cerr << "allocations aren't being counted" << endl;
+        return EXIT_FAILURE;
+    }
+    const allocation_counts before_aligned = read_allocation_counts();
+    aligned_probe = new aligned_probe_type[3];
+    delete [] aligned_probe;
+    const allocation_counts aligned_counts = allocation_difference(read_allocation_counts(), before_aligned);
+    if (aligned_counts.allocations < 1 || aligned_counts.deallocations < 1) {
+        cerr << "over-aligned allocations aren't being counted" << endl;
+        return EXIT_FAILURE;
+    }
+
+    bool passed = check_sweep(0.0, 1, "plain CRP");
+    passed = check_sweep(0.5, 5, "WCRP") && passed;
+
+    cout << (passed ? "PASSED" : "FAILED") << endl;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif
@@ -0,0 +1,224 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef FIXED_SKILL_BKT_TEST_CPP
+#define FIXED_SKILL_BKT_TEST_CPP
+
+#include "common.hpp"
+#include "FixedSkillBKT.hpp"
+#include "MixtureWCRP.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+// checks FixedSkillBKT's likelihood against a plain forward filter, that EM never lowers it and stops where its gradient
+// vanishes, that EM and data augmentation recover the parameters that generated the data, that the threads don't change
+// the results, and that run_mcmc's BKT_EM chain records the fit
+
+#define NUM_SKILLS 3
+#define NUM_STUDENTS 1500
+#define ITEMS_PER_SKILL 4
+
+
+// students practice the skills' items in random order, and respond by BKT with the true parameters
+void make_dataset(const vector<struct bkt_parameters> & truth, vector< vector<bool> > & recall_sequences, vector< vector<size_t> > & item_sequences, vector<size_t> & skill_labels) {
+    Random generator(5);
+    skill_labels.clear();
+    for (size_t item = 0; item < NUM_SKILLS * ITEMS_PER_SKILL; item++) skill_labels.push_back(item / ITEMS_PER_SKILL);
+    recall_sequences.assign(NUM_STUDENTS, vector<bool>());
+    item_sequences.assign(NUM_STUDENTS, vector<size_t>());
+    for (size_t student = 0; student < NUM_STUDENTS; student++) {
+        vector<bool> learned(NUM_SKILLS);
+        for (size_t skill = 0; skill < NUM_SKILLS; skill++) learned[skill] = generator.sampleBernoulli(truth[skill].psi);
+        const size_t length = 1 + generator.sampleUniformDiscrete(40);
+        for (size_t trial = 0; trial < length; trial++) {
+            const size_t item = generator.sampleUniformDiscrete(skill_labels.size());
+            const struct bkt_parameters & params = truth[skill_labels[item]];
+            const double p_correct = learned[skill_labels[item]] ? params.pi1 : params.pi1 * params.prop0;
+            item_sequences[student].push_back(item);
+            recall_sequences[student].push_back(generator.sampleBernoulli(p_correct));
+            if (!learned[skill_labels[item]]) learned[skill_labels[item]] = generator.sampleBernoulli(params.mu);
+        }
+    }
+}
+
+
+// the log likelihood of the training students' responses, by the forward filter of MixtureWCRP::data_log_likelihood
+double reference_log_likelihood(const Dataset & dataset, const vector<size_t> & skill_labels, const set<size_t> & train_students, const vector<struct bkt_parameters> & parameters) {
+    double ll = 0.0;
+    for (set<size_t>::const_iterator student_itr = train_students.begin(); student_itr != train_students.end(); student_itr++) {
+        vector<double> p_hat;
+        for (size_t skill = 0; skill < parameters.size(); skill++) p_hat.push_back(parameters[skill].psi);
+        for (size_t trial = 0; trial < dataset.get_item_sequences()[*student_itr].size(); trial++) {
+            const size_t skill = skill_labels[dataset.get_item_sequences()[*student_itr][trial]];
+            const double pi1 = parameters[skill].pi1, pi0 = parameters[skill].pi1 * parameters[skill].prop0, mu = parameters[skill].mu, p = p_hat[skill];
+            const double p_correct = pi0 * (1.0 - p) + pi1 * p;
+            if (dataset.get_recall_sequences()[*student_itr][trial]) {
+                ll += log(p_correct);
+                p_hat[skill] = (pi1 * p + mu * pi0 * (1.0 - p)) / p_correct;
+            }
+            else {
+                ll += log(1.0 - p_correct);
+                p_hat[skill] = ((1.0 - pi1) * p + mu * (1.0 - pi0) * (1.0 - p)) / (1.0 - p_correct);
+            }
+        }
+    }
+    return ll;
+}
+
+
+void check_fits(const Dataset & dataset, const vector<size_t> & skill_labels, const set<size_t> & train_students, const vector<struct bkt_parameters> & truth) {
+    const FixedSkillBKT fitter(dataset, skill_labels, train_students, 1), threaded_fitter(dataset, skill_labels, train_students, 3);
+    check_true(fitter.get_num_skills() == NUM_SKILLS, "number of skills");
+
+    // the likelihood at random parameters
+    Random generator(7);
+    vector<struct bkt_parameters> parameters(NUM_SKILLS);
+    for (size_t skill = 0; skill < NUM_SKILLS; skill++) {
+        parameters[skill].psi = generator.sampleUniform01();
+        parameters[skill].mu = generator.sampleUniform01();
+        parameters[skill].pi1 = generator.sampleUniform01();
+        parameters[skill].prop0 = generator.sampleUniform01();
+    }
+    const double expected_ll = reference_log_likelihood(dataset, skill_labels, train_students, parameters);
+    check_close(expected_ll, fitter.log_likelihood(parameters), 1e-8 * abs(expected_ll), "log likelihood");
+    check_close(expected_ll, threaded_fitter.log_likelihood(parameters), 1e-8 * abs(expected_ll), "log likelihood on threads");
+
+    // EM from there: the likelihood only goes up, and the threads take the same steps
+    vector<struct bkt_parameters> threaded_parameters(parameters);
+    double prev_ll = -INFINITY;
+    for (size_t step = 0; step < 20; step++) {
+        const double ll = fitter.em_step(parameters);
+        check_true(ll >= prev_ll - 1e-9 * abs(ll), "EM doesn't lower the likelihood");
+        prev_ll = ll;
+        check_close(ll, threaded_fitter.em_step(threaded_parameters), 1e-9 * abs(ll), "EM step on threads");
+    }
+    const size_t num_steps = fitter.fit_em(parameters);
+    check_true(num_steps < EM_MAX_STEPS, "EM converges");
+
+    // at the fit, the likelihood is flat in every parameter away from the bounds
+    const double fit_ll = reference_log_likelihood(dataset, skill_labels, train_students, parameters);
+    for (size_t skill = 0; skill < NUM_SKILLS; skill++) {
+        double * params[] = {&parameters[skill].psi, &parameters[skill].mu, &parameters[skill].pi1, &parameters[skill].prop0};
+        for (size_t p = 0; p < 4; p++) {
+            const double value = *params[p], h = 1e-5;
+            if (value < 10 * h || value > 1.0 - 10 * h) continue;
+            *params[p] = value + h;
+            const double ll_up = reference_log_likelihood(dataset, skill_labels, train_students, parameters);
+            *params[p] = value - h;
+            const double ll_down = reference_log_likelihood(dataset, skill_labels, train_students, parameters);
+            *params[p] = value;
+            check_close(0.0, (ll_up - ll_down) / (2 * h) / dataset.get_num_trials(), 1e-3, "gradient at the EM fit, skill " + boost::lexical_cast<string>(skill) + ", parameter " + boost::lexical_cast<string>(p));
+        }
+    }
+    check_true(fit_ll >= reference_log_likelihood(dataset, skill_labels, train_students, truth), "the EM fit is at least as likely as the truth");
+    for (size_t skill = 0; skill < NUM_SKILLS; skill++) {
+        const string what = "EM recovers skill " + boost::lexical_cast<string>(skill) + "'s ";
+        check_close(truth[skill].psi, parameters[skill].psi, .05, what + "psi");
+        check_close(truth[skill].mu, parameters[skill].mu, .05, what + "mu");
+        check_close(truth[skill].pi1, parameters[skill].pi1, .05, what + "pi1");
+        check_close(truth[skill].pi1 * truth[skill].prop0, parameters[skill].pi1 * parameters[skill].prop0, .05, what + "pi0");
+    }
+
+    // data augmentation: the same chain on threads, and posterior means near the truth
+    Random sampler(11), threaded_sampler(11);
+    vector<struct bkt_parameters> samples(parameters), threaded_samples(parameters), means(NUM_SKILLS);
+    const size_t num_burn = 50, num_samples = 150;
+    for (size_t skill = 0; skill < NUM_SKILLS; skill++) means[skill].psi = means[skill].mu = means[skill].pi1 = means[skill].prop0 = 0.0;
+    for (size_t step = 0; step < num_burn + num_samples; step++) {
+        fitter.sample_step(&sampler, samples);
+        threaded_fitter.sample_step(&threaded_sampler, threaded_samples);
+        if (step < num_burn) continue;
+        for (size_t skill = 0; skill < NUM_SKILLS; skill++) {
+            means[skill].psi += samples[skill].psi / num_samples;
+            means[skill].mu += samples[skill].mu / num_samples;
+            means[skill].pi1 += samples[skill].pi1 / num_samples;
+            means[skill].prop0 += samples[skill].pi1 * samples[skill].prop0 / num_samples; // pi0
+        }
+    }
+    for (size_t skill = 0; skill < NUM_SKILLS; skill++) {
+        check_true(samples[skill].mu == threaded_samples[skill].mu && samples[skill].prop0 == threaded_samples[skill].prop0, "data augmentation on threads");
+        const string what = "data augmentation recovers skill " + boost::lexical_cast<string>(skill) + "'s ";
+        check_close(truth[skill].psi, means[skill].psi, .05, what + "psi");
+        check_close(truth[skill].mu, means[skill].mu, .05, what + "mu");
+        check_close(truth[skill].pi1, means[skill].pi1, .05, what + "pi1");
+        check_close(truth[skill].pi1 * truth[skill].prop0, means[skill].prop0, .05, what + "pi0");
+    }
+}
+
+
+// run_mcmc with BKT_EM records the fit, and its training log likelihood is the fit's
+void check_chain(const Dataset & dataset, const vector<size_t> & skill_labels, const set<size_t> & train_students) {
+    wcrp_config config = test_config(1.0, train_students, 1);
+    config.bkt_fit = BKT_EM;
+    Random generator(13);
+    MixtureWCRP model(&generator, dataset, config);
+    model.set_progress_stream(NULL);
+    model.run_mcmc(3, 1, false, false);
+
+    const vector< vector<size_t> > label_samples = model.get_sampled_skill_labels();
+    const vector< vector<struct bkt_parameters> > parameter_samples = model.get_sampled_skill_parameters();
+    const vector<double> train_lls = model.get_train_ll_samples();
+    check_true(train_lls.size() == 2 && label_samples.size() == 2, "the chain's samples");
+    for (size_t sample = 0; sample < label_samples.size(); sample++) {
+        check_close(reference_log_likelihood(dataset, label_samples[sample], train_students, parameter_samples[sample]), train_lls[sample], 1e-8 * abs(train_lls[sample]), "the chain's training log likelihood");
+    }
+
+    const FixedSkillBKT fitter(dataset, skill_labels, train_students, 1);
+    vector<struct bkt_parameters> parameters(NUM_SKILLS);
+    for (size_t skill = 0; skill < NUM_SKILLS; skill++) {
+        parameters[skill].psi = parameters[skill].mu = parameters[skill].pi1 = parameters[skill].prop0 = .5;
+    }
+    fitter.fit_em(parameters);
+    const double fit_ll = fitter.log_likelihood(parameters);
+    check_close(fit_ll, train_lls.back(), 1e-6 * abs(fit_ll), "the chain reaches the EM fit");
+}
+
+
+int main() {
+
+    vector<struct bkt_parameters> truth(NUM_SKILLS);
+    const double true_values[NUM_SKILLS][4] = {{.3, .15, .9, .3}, {.6, .05, .8, .5}, {.1, .3, .95, .2}}; // psi, mu, pi1, prop0
+    for (size_t skill = 0; skill < NUM_SKILLS; skill++) {
+        truth[skill].psi = true_values[skill][0];
+        truth[skill].mu = true_values[skill][1];
+        truth[skill].pi1 = true_values[skill][2];
+        truth[skill].prop0 = true_values[skill][3];
+    }
+
+    vector< vector<bool> > recall_sequences;
+    vector< vector<size_t> > item_sequences;
+    vector<size_t> skill_labels;
+    make_dataset(truth, recall_sequences, item_sequences, skill_labels);
+    const Dataset dataset(recall_sequences, item_sequences, skill_labels, skill_labels.size());
+    const set<size_t> train_students = training_students(NUM_STUDENTS, 10);
+
+    check_fits(dataset, skill_labels, train_students, truth);
+    check_chain(dataset, skill_labels, train_students);
+
+    return finish_checks("fixed-skill BKT");
+}
+
+#endif
@@ -0,0 +1,181 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef INCREMENTAL_INGESTION_CPP
+#define INCREMENTAL_INGESTION_CPP
+
+#include "common.hpp"
+#include "MixtureWCRP.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+// checks append_trials against rebuilding the model from scratch
+//
+// a model is built on a prefix of a random dataset (some students and items don't appear in it at all), the rest of the 
+// trials are appended, and a few Gibbs sweeps are run. its checkpoint is then loaded by a model built on the full dataset. 
+// the two must agree on every dataset helper variable, trial_lookup, the data log likelihood, and the singleton skill 
+// likelihoods (which the rebuilt model recomputes from the checkpoint's prior samples)
+
+#define NUM_SWEEPS 3
+
+
+class InspectableWCRP : public MixtureWCRP {
+
+  public:
+
+    InspectableWCRP(Random * generator, const Dataset & dataset, const wcrp_config & config) :
+        MixtureWCRP(generator, dataset, config) {}
+
+    // the seating phase of run_mcmc (which leaves the expert labels alone)
+    void sweep() {
+        if (use_expert_labels) return;
+        generator->shuffle(all_items);
+        for (vector<size_t>::const_iterator item_itr = all_items.begin(); item_itr != all_items.end(); item_itr++) gibbs_resample_skill(*item_itr);
+    }
+
+    // returns an empty string if the models match, otherwise a description of the first mismatch
+    string compare(InspectableWCRP & other) {
+        if (num_students != other.num_students || num_items != other.num_items) return "dataset sizes";
+        if (seating_arrangement != other.seating_arrangement) return "seating_arrangement";
+        if (first_encounter != other.first_encounter) return "first_encounter";
+        if (trials_studied != other.trials_studied) return "trials_studied";
+        if (ever_studied != other.ever_studied) return "ever_studied";
+        if (item_and_recall_sequences != other.item_and_recall_sequences) return "item_and_recall_sequences";
+        if (num_expert_provided_skills != other.num_expert_provided_skills) return "num_expert_provided_skills";
+        if (item_costs.size() != other.item_costs.size()) return "item profile size";
+        for (size_t item = 0; item < item_costs.size(); item++) {
+            if (item_costs[item].affected_students != other.item_costs[item].affected_students || item_costs[item].trials_touched != other.item_costs[item].trials_touched) return "item profile of item " + to_string(item);
+        }
+
+        // students who first study an item in the appended trials are listed after the others
+        for (size_t item = 0; item < num_items; item++) {
+            if (sorted_studiers(item) != other.sorted_studiers(item)) return "students_who_studied of item " + to_string(item);
+        }
+
+        for (set<size_t>::const_iterator table_itr = extant_tables.begin(); table_itr != extant_tables.end(); table_itr++) {
+            const boost::unordered_map<size_t, vector<size_t> > & lookup = trial_lookup.at(*table_itr);
+            const boost::unordered_map<size_t, vector<size_t> > & other_lookup = other.trial_lookup.at(*table_itr);
+            if (lookup.size() != other_lookup.size()) return "trial_lookup of table " + to_string(*table_itr);
+            for (boost::unordered_map<size_t, vector<size_t> >::const_iterator itr = lookup.begin(); itr != lookup.end(); itr++) {
+                if (!other_lookup.count(itr->first) || other_lookup.at(itr->first) != itr->second) return "trial_lookup of table " + to_string(*table_itr);
+            }
+        }
+
+        size_t trials_included, other_trials_included;
+        const double ll = full_data_log_likelihood(true, trials_included);
+        const double other_ll = other.full_data_log_likelihood(true, other_trials_included);
+        if (trials_included != other_trials_included || abs(ll - other_ll) > 1e-8 * abs(ll)) return "full_data_log_likelihood";
+
+        if (!use_expert_labels) {
+            if (other.singleton_skill_data_lp.size() != num_items) return "singleton_skill_data_lp size";
+            const vector< vector<double> > appended_lp = other.singleton_skill_data_lp;
+            for (size_t item = 0; item < num_items; item++) {
+                const size_t table_id = seating_arrangement[item];
+                const struct bkt_parameters params = parameters.at(table_id);
+                const bool deleted_table = remove_item_from_table(item, table_id);
+                compute_singleton_skill_data_lp(item);
+                assign_item_to_table(item, table_id, deleted_table);
+                parameters[table_id] = params;
+                for (size_t subsample = 0; subsample < num_subsamples; subsample++) {
+                    const double expected = singleton_skill_data_lp[item][subsample];
+                    if (abs(expected - appended_lp[item][subsample]) > 1e-8 * abs(expected)) return "singleton_skill_data_lp of item " + to_string(item);
+                }
+            }
+        }
+        return "";
+    }
+
+  protected:
+
+    vector< pair<size_t, size_t> > sorted_studiers(const size_t item) const {
+        vector< pair<size_t, size_t> > studiers;
+        for (size_t idx = 0; idx < students_who_studied.at(item).size(); idx++) studiers.push_back(make_pair(students_who_studied[item][idx], all_first_encounters.at(item).at(idx)));
+        sort(studiers.begin(), studiers.end());
+        return studiers;
+    }
+
+};
+
+
+// returns true if the incrementally built model matches the rebuilt one
+bool check_append(const double beta, const size_t num_expert_skills, const string & context) {
+    const size_t num_students = 120, num_items = 30, num_prefix_students = 100, num_prefix_items = 26;
+    Random data_generator(3);
+
+    // the full dataset, and its prefix: the first part of each of the first num_prefix_students' sequences,
+    // up to their first trial of an item that's not in the prefix. the suffixes are the rest
+    vector< vector<bool> > recall_sequences, prefix_recall_sequences(num_prefix_students), suffix_recall_sequences(num_students);
+    vector< vector<size_t> > item_sequences, prefix_item_sequences(num_prefix_students), suffix_item_sequences(num_students);
+    make_random_sequences(data_generator, num_students, num_items, 1, 40, recall_sequences, item_sequences);
+    const vector<size_t> provided_skill_labels = random_skill_labels(data_generator, num_items, num_expert_skills);
+    wcrp_config config = test_config(beta, training_students(num_students, 10));
+    for (size_t student = 0; student < num_students; student++) {
+        size_t prefix_length = 0;
+        if (student < num_prefix_students) {
+            const size_t max_prefix_length = data_generator.sampleUniformDiscrete(item_sequences[student].size() + 1);
+            for (; prefix_length < max_prefix_length && item_sequences[student][prefix_length] < num_prefix_items; prefix_length++) {
+                prefix_item_sequences[student].push_back(item_sequences[student][prefix_length]);
+                prefix_recall_sequences[student].push_back(recall_sequences[student][prefix_length]);
+            }
+        }
+        suffix_item_sequences[student].assign(item_sequences[student].begin() + prefix_length, item_sequences[student].end());
+        suffix_recall_sequences[student].assign(recall_sequences[student].begin() + prefix_length, recall_sequences[student].end());
+    }
+    // build on the prefix, append the rest, and sample a little
+    Random generator(5);
+    const Dataset prefix(prefix_recall_sequences, prefix_item_sequences, provided_skill_labels, num_prefix_items);
+    InspectableWCRP appended(&generator, prefix, config);
+    appended.enable_item_profile();
+    appended.sweep();
+    const Dataset appended_dataset(prefix, Dataset(suffix_recall_sequences, suffix_item_sequences, vector<size_t>(), num_items));
+    appended.append_trials(appended_dataset);
+    for (size_t sweep = 0; sweep < NUM_SWEEPS; sweep++) appended.sweep();
+
+    // rebuild from the full dataset
+    config.checkpoint_file = "incremental_ingestion.checkpoint";
+    appended.save_checkpoint(config.checkpoint_file.c_str());
+    const Dataset full(recall_sequences, item_sequences, provided_skill_labels, num_items);
+    InspectableWCRP rebuilt(&generator, full, config);
+    rebuilt.enable_item_profile();
+    remove(config.checkpoint_file.c_str());
+
+    const string mismatch = rebuilt.compare(appended);
+    cout << context << ": " << (mismatch.empty() ? "appended model matches the rebuilt one" : "mismatch in " + mismatch) << endl;
+    return mismatch.empty();
+}
+
+
+int main() {
+
+    bool passed = check_append(0.0, 1, "plain CRP");
+    passed = check_append(0.5, 5, "WCRP") && passed;
+    passed = check_append(1.0, 5, "expert labels") && passed;
+
+    cout << (passed ? "PASSED" : "FAILED") << endl;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif
@@ -0,0 +1,680 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef KERNEL_EQUIVALENCE_CPP
+#define KERNEL_EQUIVALENCE_CPP
+
+#include "common.hpp"
+#include "MixtureWCRP.hpp"
+#include "ColdStart.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+// checks the sampler's likelihood and seating kernels against reference oracles on randomized chain states
+//
+// the reference oracles below are the original, straightforward implementations of the kernels. they must not be
+// optimized: whatever the production kernels in MixtureWCRP.cpp turn into, they have to agree with these to within
+// REL_TOL, and a chain driven by the production gibbs step has to sample the same partitions as one driven by the
+// reference gibbs step
+
+#define REL_TOL 1e-9
+
+// the gibbs steps check_sampled_partitions compares
+#define ENGINE_PRODUCTION 0
+#define ENGINE_REFERENCE 1
+#define ENGINE_APPROXIMATE 2
+#define ENGINE_ADAPTIVE_SCAN 3
+#define NUM_ENGINES 4
+
+// agreement to within REL_TOL, relative to the reference value
+void check_close(const double expected, const double actual, const string & what) {
+    check_close(expected, actual, REL_TOL * max(1.0, abs(expected)), what);
+}
+
+
+/////////////////////////////////////////////////
+//////////// reference oracles //////////////////
+/////////////////////////////////////////////////
+
+double reference_log_old_table_probability(const size_t num_seated, const double K, const double log_gamma, const size_t num_expert_provided_skills) {
+    const double gamma = exp(log_gamma);
+    return -log(1.0 * num_expert_provided_skills) + log(1.0*num_seated) + log(K + (1.0 - K) * gamma) - log(1.0/num_expert_provided_skills + (1.0 - 1.0/num_expert_provided_skills) * gamma);
+}
+
+double reference_log_new_table_probability(const double log_alpha_prime, const double log_gamma, const size_t num_expert_provided_skills) {
+    return -log(1.0 * num_expert_provided_skills) + log_alpha_prime + log_gamma;
+}
+
+
+// the raw data behind a test's Dataset, and its training students
+struct test_dataset {
+    vector< vector<bool> > recall_sequences;
+    vector< vector<size_t> > item_sequences;
+    vector<size_t> provided_skill_labels;
+    set<size_t> train_students;
+    size_t num_students;
+    size_t num_items;
+};
+
+
+// random data with the awkward cases mixed in: students with a single trial or no trials, heldout students,
+// items nobody in the training set studied, and repeated trials of the same item
+void make_test_dataset(Random & generator, const size_t num_students, const size_t num_items, const size_t num_expert_skills, test_dataset & data) {
+
+    data.num_students = num_students;
+    data.num_items = num_items;
+    data.recall_sequences.assign(num_students, vector<bool>());
+    data.item_sequences.assign(num_students, vector<size_t>());
+
+    for (size_t student = 0; student < num_students; student++) {
+        size_t length = 1 + generator.sampleUniformDiscrete(40);
+        if (student % 7 == 0) length = 1;
+        if (student == 3) length = 0;
+        for (size_t trial = 0; trial < length; trial++) {
+            // the last item is only ever studied by heldout students
+            size_t item = generator.sampleUniformDiscrete(num_items - 1);
+            if (student % 5 == 4 && generator.sampleBernoulli(.3)) item = num_items - 1;
+            if (trial > 0 && generator.sampleBernoulli(.3)) item = data.item_sequences[student][trial - 1];
+            data.item_sequences[student].push_back(item);
+            data.recall_sequences[student].push_back(generator.sampleBernoulli(.6));
+        }
+        if (student % 5 != 4) data.train_students.insert(student);
+    }
+
+    data.provided_skill_labels.resize(num_items);
+    for (size_t item = 0; item < num_items; item++) data.provided_skill_labels[item] = generator.sampleUniformDiscrete(num_expert_skills);
+}
+
+
+class ReferenceWCRP : public MixtureWCRP {
+
+  public:
+
+    ReferenceWCRP(Random * generator, const Dataset & dataset, const wcrp_config & config) :
+        MixtureWCRP(generator, dataset, config) {}
+
+    double reference_compute_K(const size_t item, const size_t table_id, const bool generative_mode) const {
+        assert(generative_mode || seating_arrangement.at(item) == UNASSIGNED);
+        const double gamma = exp(log_gamma);
+        const size_t end_idx = (generative_mode) ? item : num_items;
+        const size_t item_expert_label = dataset->get_provided_skill_labels().at(item);
+
+        boost::unordered_map<size_t, int> counts;
+        int max_count = 0;
+        for (size_t other_item = 0; other_item < end_idx; other_item++) {
+            if (item != other_item && seating_arrangement.at(other_item) == table_id) {
+                const size_t expert_label = dataset->get_provided_skill_labels().at(other_item);
+                if (counts.find(expert_label) == counts.end()) counts[expert_label] = 1;
+                else counts[expert_label]++;
+                if (counts[expert_label] > max_count) max_count = counts[expert_label];
+            }
+        }
+
+        const bool has_item_expert_label = (counts.find(item_expert_label) != counts.end());
+        const double numerator_K = (has_item_expert_label) ? pow(gamma, max_count - counts.at(item_expert_label)) : pow(gamma, max_count);
+        double denominator_K =  (num_expert_provided_skills - counts.size()) * pow(gamma, max_count);
+        for (boost::unordered_map<size_t, int>::const_iterator count_itr = counts.begin(); count_itr != counts.end(); count_itr++) denominator_K += pow(gamma, max_count - count_itr->second);
+        return numerator_K / denominator_K;
+    }
+
+    double reference_log_seating_prob() const {
+        double log_prob = 0.0;
+        boost::unordered_map<size_t, size_t> table_counts_so_far;
+
+        for (size_t item = 0; item < num_items; item++) {
+            const size_t chosen_table_id = seating_arrangement.at(item);
+            double chosen_proportional_prob = 0.0;
+            vector<double> proportional_probs;
+            bool chose_old = false;
+
+            for (boost::unordered_map<size_t, size_t>::const_iterator table_itr = table_counts_so_far.begin(); table_itr != table_counts_so_far.end(); table_itr++) {
+                const double K = reference_compute_K(item, table_itr->first, true);
+                const double prob = exp(reference_log_old_table_probability(table_itr->second, K, log_gamma, num_expert_provided_skills));
+                proportional_probs.push_back(prob);
+                if (table_itr->first == chosen_table_id) {
+                    chosen_proportional_prob = prob;
+                    chose_old = true;
+                }
+            }
+
+            proportional_probs.push_back(exp(reference_log_new_table_probability(log_alpha_prime, log_gamma, num_expert_provided_skills)));
+            if (!chose_old) chosen_proportional_prob = proportional_probs.at(proportional_probs.size() - 1);
+
+            log_prob += log(chosen_proportional_prob) - log(accumulate(proportional_probs.begin(), proportional_probs.end(), 0.0));
+
+            if (table_counts_so_far.find(chosen_table_id) == table_counts_so_far.end()) table_counts_so_far[chosen_table_id] = 1;
+            else table_counts_so_far[chosen_table_id]++;
+        }
+        return log_prob;
+    }
+
+    void reference_cache_p_hat(const size_t student, const size_t end_trial, boost::unordered_map<size_t, double> & p_hat) const {
+        const vector<bool> & recall_sequence = dataset->get_recall_sequences().at(student);
+        const vector<size_t> & item_sequence = dataset->get_item_sequences().at(student);
+        for (boost::unordered_map<size_t, struct bkt_parameters>::const_iterator table_itr = parameters.begin(); table_itr != parameters.end(); table_itr++) p_hat[table_itr->first] = table_itr->second.psi;
+
+        for (size_t trial = 0; trial < end_trial; trial++) {
+            const bool did_recall = recall_sequence.at(trial);
+            const size_t table_id = seating_arrangement.at(item_sequence.at(trial));
+            const struct bkt_parameters & skill_params = parameters.at(table_id);
+            const double skill_pi1 = skill_params.pi1;
+            const double skill_pi0 = skill_pi1 *  skill_params.prop0;
+            const double skill_mu = skill_params.mu;
+            const double cur_p_hat = p_hat.at(table_id);
+            if (did_recall) p_hat[table_id] = (skill_pi1 * cur_p_hat + skill_mu * skill_pi0 * (1.0 - cur_p_hat)) / (skill_pi1 * cur_p_hat + skill_pi0 * (1.0 - cur_p_hat));
+            else p_hat[table_id] = ((1.0 - skill_pi1) * cur_p_hat + skill_mu * (1.0 - skill_pi0) * (1.0 - cur_p_hat)) / ((1.0 - skill_pi1) * cur_p_hat + (1.0 - skill_pi0) * (1.0 - cur_p_hat));
+        }
+    }
+
+    // the trials of this student that belong to the table, recomputed from the seating arrangement rather than trial_lookup
+    vector<size_t> reference_trials_at_table(const size_t student, const size_t table_id) const {
+        vector<size_t> trials;
+        for (size_t trial = 0; trial < dataset->get_item_sequences().at(student).size(); trial++) {
+            if (seating_arrangement.at(dataset->get_item_sequences().at(student).at(trial)) == table_id) trials.push_back(trial);
+        }
+        return trials;
+    }
+
+    double reference_skill_log_likelihood(const size_t table_id, const vector<size_t> & affected_students, const vector<size_t> & first_exposures) const {
+        double skill_log_lik = 0.0;
+        const struct bkt_parameters & skill_params = parameters.at(table_id);
+        const double skill_pi1 = skill_params.pi1;
+        const double skill_pi0 = skill_pi1 *  skill_params.prop0;
+        const double skill_mu = skill_params.mu;
+
+        for (size_t k = 0; k < affected_students.size(); k++) {
+            const size_t student = affected_students.at(k);
+            double student_skill_log_lik = 0.0;
+            double cur_p_hat = skill_params.psi;
+            const vector<size_t> trials = reference_trials_at_table(student, table_id);
+            for (size_t i = 0; i < trials.size(); i++) {
+                const size_t trial = trials[i];
+                if (dataset->get_recall_sequences().at(student).at(trial)) {
+                    if (trial >= first_exposures.at(k)) student_skill_log_lik += log(skill_pi0 * (1.0 - cur_p_hat) + skill_pi1 * cur_p_hat);
+                    cur_p_hat = (skill_pi1 * cur_p_hat + skill_mu * skill_pi0 * (1.0 - cur_p_hat)) / (skill_pi1 * cur_p_hat + skill_pi0 * (1.0 - cur_p_hat));
+                }
+                else {
+                    if (trial >= first_exposures.at(k)) student_skill_log_lik += log(1.0 - (skill_pi0 * (1.0 - cur_p_hat) + skill_pi1 * cur_p_hat));
+                    cur_p_hat = ((1.0 - skill_pi1) * cur_p_hat + skill_mu * (1.0 - skill_pi0) * (1.0 - cur_p_hat)) / ((1.0 - skill_pi1) * cur_p_hat + (1.0 - skill_pi0) * (1.0 - cur_p_hat));
+                }
+            }
+            if (student_skill_log_lik > 0.0) student_skill_log_lik = 0.0;
+            skill_log_lik += student_skill_log_lik;
+        }
+        return min(0.0, skill_log_lik);
+    }
+
+    double reference_skill_log_likelihood(const size_t table_id, const vector<size_t> & affected_students, const vector<size_t> & first_exposures, const vector< boost::unordered_map<size_t, double> > & init_p_hat) const {
+        if (table_sizes.find(table_id) == table_sizes.end() || table_sizes.at(table_id) == 0) return 0.0;
+
+        double skill_log_lik = 0.0;
+        const struct bkt_parameters & skill_params = parameters.at(table_id);
+        const double skill_pi1 = skill_params.pi1;
+        const double skill_pi0 = skill_pi1 *  skill_params.prop0;
+        const double skill_mu = skill_params.mu;
+
+        for (size_t student_idx = 0; student_idx < affected_students.size(); student_idx++) {
+            const size_t student = affected_students.at(student_idx);
+            const vector<size_t> trials = reference_trials_at_table(student, table_id);
+            if (trials.empty()) continue;
+
+            double student_skill_log_lik = 0.0;
+            double cur_p_hat = init_p_hat.at(student_idx).at(table_id);
+            for (size_t i = 0; i < trials.size(); i++) {
+                const size_t trial = trials[i];
+                if (trial < first_exposures.at(student_idx)) continue;
+                if (dataset->get_recall_sequences().at(student).at(trial)) {
+                    student_skill_log_lik += log(skill_pi0 * (1.0 - cur_p_hat) + skill_pi1 * cur_p_hat);
+                    cur_p_hat = (skill_pi1 * cur_p_hat + skill_mu * skill_pi0 * (1.0 - cur_p_hat)) / (skill_pi1 * cur_p_hat + skill_pi0 * (1.0 - cur_p_hat));
+                }
+                else {
+                    student_skill_log_lik += log(1.0 - (skill_pi0 * (1.0 - cur_p_hat) + skill_pi1 * cur_p_hat));
+                    cur_p_hat = ((1.0 - skill_pi1) * cur_p_hat + skill_mu * (1.0 - skill_pi0) * (1.0 - cur_p_hat)) / ((1.0 - skill_pi1) * cur_p_hat + (1.0 - skill_pi0) * (1.0 - cur_p_hat));
+                }
+            }
+            if (student_skill_log_lik > 0.0) student_skill_log_lik = 0.0;
+            skill_log_lik += student_skill_log_lik;
+        }
+        return skill_log_lik;
+    }
+
+    double reference_data_log_likelihood(const size_t student, const size_t start_trial) const {
+        double log_lik = 0.0;
+        boost::unordered_map<size_t, double> p_hat;
+        reference_cache_p_hat(student, 0, p_hat);
+
+        for (size_t trial = 0; trial < dataset->get_item_sequences().at(student).size(); trial++) {
+            const bool did_recall = dataset->get_recall_sequences().at(student).at(trial);
+            const size_t table_id = seating_arrangement.at(dataset->get_item_sequences().at(student).at(trial));
+            const struct bkt_parameters & skill_params = parameters.at(table_id);
+            const double skill_pi1 = skill_params.pi1;
+            const double skill_pi0 = skill_pi1 *  skill_params.prop0;
+            const double skill_mu = skill_params.mu;
+            const double cur_p_hat = p_hat.at(table_id);
+            const double pRT = skill_pi0 * (1.0 - cur_p_hat) + skill_pi1 * cur_p_hat;
+            if (did_recall) {
+                if (trial >= start_trial) log_lik += log(pRT);
+                p_hat[table_id] = (skill_pi1 * cur_p_hat + skill_mu * skill_pi0 * (1.0 - cur_p_hat)) / (skill_pi1 * cur_p_hat + skill_pi0 * (1.0 - cur_p_hat));
+            }
+            else {
+                if (trial >= start_trial) log_lik += log(1.0 - pRT);
+                p_hat[table_id] = ((1.0 - skill_pi1) * cur_p_hat + skill_mu * (1.0 - skill_pi0) * (1.0 - cur_p_hat)) / ((1.0- skill_pi1) * cur_p_hat + (1.0 - skill_pi0) * (1.0 - cur_p_hat));
+            }
+        }
+        return log_lik;
+    }
+
+    // the gibbs conditional as originally written: move the item to each table, score, move it back
+    void reference_score_candidate_tables(const size_t item, vector<size_t> & keys, vector<double> & proportional_log_probs) {
+        const vector<size_t> & affected_students = students_who_studied.at(item);
+        const vector<size_t> & first_exposures = all_first_encounters.at(item);
+
+        vector< boost::unordered_map<size_t, double> > p_hat(affected_students.size());
+        for (size_t student_idx = 0; student_idx < affected_students.size(); student_idx++) reference_cache_p_hat(affected_students.at(student_idx), first_exposures.at(student_idx), p_hat[student_idx]);
+
+        keys.clear();
+        proportional_log_probs.clear();
+        const vector<size_t> tables(extant_tables.begin(), extant_tables.end());
+        for (size_t k = 0; k < tables.size(); k++) {
+            const size_t table_id = tables[k];
+            assign_item_to_table(item, table_id, false);
+            const double with_item = reference_skill_log_likelihood(table_id, affected_students, first_exposures, p_hat);
+            remove_item_from_table(item, table_id);
+            const double without_item = reference_skill_log_likelihood(table_id, affected_students, first_exposures, p_hat);
+            const double K = reference_compute_K(item, table_id, false);
+            proportional_log_probs.push_back(reference_log_old_table_probability(table_sizes.at(table_id), K, log_gamma, num_expert_provided_skills) + with_item - without_item);
+            keys.push_back(table_id);
+        }
+
+        const double new_table_lp = reference_log_new_table_probability(log_alpha_prime, log_gamma, num_expert_provided_skills) - log(1.0*num_subsamples);
+        for (size_t subsample = 0; subsample < num_subsamples; subsample++) proportional_log_probs.push_back(new_table_lp + singleton_skill_data_lp.at(item).at(subsample));
+    }
+
+    // gibbs_resample_skill with the reference conditional
+    void reference_gibbs_resample_skill(const size_t item) {
+        remove_item_from_table(item, seating_arrangement.at(item));
+        vector<size_t> keys;
+        vector<double> proportional_log_probs;
+        reference_score_candidate_tables(item, keys, proportional_log_probs);
+        const size_t drawn_event = generator->sampleUnnormalizedDiscrete(proportional_log_probs);
+        if (drawn_event >= keys.size()) {
+            assign_item_to_table(item, tables_ever_instantiated++, true);
+            parameters[seating_arrangement.at(item)] = prior_samples.at(drawn_event - keys.size());
+        }
+        else assign_item_to_table(item, keys.at(drawn_event), false);
+    }
+
+    /////////////////////////////////////////////////
+    //////////// randomized chain states ////////////
+    /////////////////////////////////////////////////
+
+    // reseats a random subset of items (sometimes at new tables), redraws every table's BKT parameters and the WCRP hyperparameters
+    // with extreme = true, parameters are often pinned to the edges of their support, [TOL, 1 - TOL]
+    void randomize_state(Random & rng, const bool extreme) {
+        for (size_t item = 0; item < num_items; item++) {
+            if (!rng.sampleBernoulli(.3)) continue;
+            remove_item_from_table(item, seating_arrangement.at(item));
+            if (extant_tables.empty() || rng.sampleBernoulli(.2)) assign_item_to_table(item, tables_ever_instantiated++, true);
+            else {
+                const vector<size_t> tables(extant_tables.begin(), extant_tables.end());
+                assign_item_to_table(item, tables.at(rng.sampleUniformDiscrete(tables.size())), false);
+            }
+        }
+
+        for (boost::unordered_map<size_t, struct bkt_parameters>::iterator table_itr = parameters.begin(); table_itr != parameters.end(); table_itr++) {
+            double * params[] = {&table_itr->second.psi, &table_itr->second.mu, &table_itr->second.pi1, &table_itr->second.prop0};
+            for (size_t p = 0; p < 4; p++) {
+                *params[p] = TOL + (ONEMINUSTOL - TOL) * rng.sampleUniform01();
+                if (extreme && rng.sampleBernoulli(.3)) *params[p] = rng.sampleBernoulli(.5) ? TOL : ONEMINUSTOL;
+            }
+        }
+
+        log_alpha_prime = log(.01 + 50 * rng.sampleUniform01());
+        log_gamma = rng.sampleBernoulli(.25) ? 0.0 : -8 * rng.sampleUniform01();
+    }
+
+    /////////////////////////////////////////////////
+    //////////// comparisons ////////////////////////
+    /////////////////////////////////////////////////
+
+    // trial_lookup, table_sizes and extant_tables must agree with the seating arrangement
+    void check_bookkeeping(const string & context) const {
+        boost::unordered_map<size_t, size_t> sizes;
+        for (size_t item = 0; item < num_items; item++) {
+            if (seating_arrangement.at(item) != UNASSIGNED) sizes[seating_arrangement.at(item)]++;
+        }
+        check_true(sizes.size() == table_sizes.size() && sizes.size() == extant_tables.size() && sizes.size() == num_used_skills, context + ": number of tables");
+        for (boost::unordered_map<size_t, size_t>::const_iterator itr = sizes.begin(); itr != sizes.end(); itr++) {
+            check_true(table_sizes.count(itr->first) && table_sizes.at(itr->first) == itr->second && extant_tables.count(itr->first) && parameters.count(itr->first), context + ": table size");
+            for (set<size_t>::const_iterator student_itr = train_students.begin(); student_itr != train_students.end(); student_itr++) {
+                const vector<size_t> expected = reference_trials_at_table(*student_itr, itr->first);
+                const boost::unordered_map<size_t, vector<size_t> > & lookup = trial_lookup.at(itr->first);
+                if (expected.empty()) check_true(!lookup.count(*student_itr), context + ": stale trial_lookup entry");
+                else check_true(lookup.count(*student_itr) && lookup.at(*student_itr) == expected, context + ": trial_lookup");
+            }
+        }
+    }
+
+    void check_kernels(Random & rng, const string & context) {
+
+        check_bookkeeping(context);
+        check_close(reference_log_seating_prob(), log_seating_prob(), context + ": log_seating_prob");
+
+        // data_log_likelihood, both overloads
+        vector<size_t> students, start_trials;
+        for (size_t student = 0; student < num_students; student++) {
+            const size_t start_trial = rng.sampleUniformDiscrete(dataset->get_item_sequences().at(student).size() + 1);
+            size_t num_trials;
+            check_close(reference_data_log_likelihood(student, start_trial), data_log_likelihood(student, start_trial, num_trials), context + ": data_log_likelihood(student)");
+            if (rng.sampleBernoulli(.5)) {
+                students.push_back(student);
+                start_trials.push_back(start_trial);
+            }
+        }
+        double expected = 0.0;
+        for (size_t k = 0; k < students.size(); k++) expected += reference_data_log_likelihood(students[k], start_trials[k]);
+        check_close(expected, data_log_likelihood(students, start_trials), context + ": data_log_likelihood(students)");
+
+        // cache_p_hat at every possible end trial of a few students
+        for (size_t student = 0; student < num_students; student += 3) {
+            for (size_t end_trial = 0; end_trial <= dataset->get_item_sequences().at(student).size(); end_trial++) {
+                boost::unordered_map<size_t, double> expected_p_hat, actual_p_hat;
+                reference_cache_p_hat(student, end_trial, expected_p_hat);
+                cache_p_hat(student, end_trial, actual_p_hat);
+                check_true(expected_p_hat.size() == actual_p_hat.size(), context + ": cache_p_hat size");
+                for (boost::unordered_map<size_t, double>::const_iterator itr = expected_p_hat.begin(); itr != expected_p_hat.end(); itr++) {
+                    check_true(actual_p_hat.count(itr->first) > 0, context + ": cache_p_hat table");
+                    if (actual_p_hat.count(itr->first)) check_close(itr->second, actual_p_hat.at(itr->first), context + ": cache_p_hat");
+                }
+            }
+        }
+
+        // skill_log_likelihood without cached state, on each table's students as run_mcmc computes them
+        for (set<size_t>::const_iterator table_itr = extant_tables.begin(); table_itr != extant_tables.end(); table_itr++) {
+            vector<size_t> table_students, first_exposures;
+            for (set<size_t>::const_iterator student_itr = train_students.begin(); student_itr != train_students.end(); student_itr++) {
+                const vector<size_t> trials = reference_trials_at_table(*student_itr, *table_itr);
+                if (trials.empty()) continue;
+                table_students.push_back(*student_itr);
+                first_exposures.push_back(rng.sampleBernoulli(.5) ? trials.front() : trials.at(rng.sampleUniformDiscrete(trials.size())));
+            }
+            check_close(reference_skill_log_likelihood(*table_itr, table_students, first_exposures), skill_log_likelihood(*table_itr, table_students, first_exposures), context + ": skill_log_likelihood");
+        }
+
+        // the gibbs conditional (and the cached skill_log_likelihood it's built on) for a sample of items
+        for (size_t item = 0; item < num_items; item++) {
+            if (!rng.sampleBernoulli(.25)) continue;
+            const size_t cur_table_id = seating_arrangement.at(item);
+            const bool was_alone = table_sizes.at(cur_table_id) == 1;
+            const struct bkt_parameters cur_params = parameters.at(cur_table_id);
+            remove_item_from_table(item, cur_table_id);
+
+            // the cached likelihood, including tables that don't exist (any more)
+            const vector<size_t> & affected_students = students_who_studied.at(item);
+            const vector<size_t> & first_exposures = all_first_encounters.at(item);
+            vector< boost::unordered_map<size_t, double> > p_hat(affected_students.size());
+            for (size_t student_idx = 0; student_idx < affected_students.size(); student_idx++) reference_cache_p_hat(affected_students[student_idx], first_exposures[student_idx], p_hat[student_idx]);
+            if (was_alone) check_close(0.0, skill_log_likelihood(cur_table_id, affected_students, first_exposures, p_hat), context + ": skill_log_likelihood of a deleted table");
+            check_close(0.0, skill_log_likelihood(tables_ever_instantiated, affected_students, first_exposures, p_hat), context + ": skill_log_likelihood of a nonexistent table");
+            for (set<size_t>::const_iterator table_itr = extant_tables.begin(); table_itr != extant_tables.end(); table_itr++) {
+                check_close(reference_skill_log_likelihood(*table_itr, affected_students, first_exposures, p_hat), skill_log_likelihood(*table_itr, affected_students, first_exposures, p_hat), context + ": cached skill_log_likelihood");
+            }
+
+            vector<size_t> expected_keys, actual_keys;
+            vector<double> expected_lps, actual_lps;
+            reference_score_candidate_tables(item, expected_keys, expected_lps);
+            prune_log_tolerance = -INFINITY;
+            score_candidate_tables(item, actual_keys, actual_lps);
+            check_true(expected_keys == actual_keys && expected_lps.size() == actual_lps.size(), context + ": candidate tables");
+            if (expected_lps.size() == actual_lps.size()) {
+                for (size_t event = 0; event < expected_lps.size(); event++) check_close(expected_lps[event], actual_lps[event], context + ": gibbs conditional");
+            }
+
+            // every table scored on its own, and every table scored in batches
+            const size_t batch_limits[] = {0, num_items};
+            for (size_t limit_idx = 0; limit_idx < 2; limit_idx++) {
+                max_batched_table_size = batch_limits[limit_idx];
+                score_candidate_tables(item, actual_keys, actual_lps);
+                check_true(expected_keys == actual_keys && expected_lps.size() == actual_lps.size(), context + ": candidate tables (batch limit " + boost::lexical_cast<string>(max_batched_table_size) + ")");
+                if (expected_lps.size() == actual_lps.size()) {
+                    for (size_t event = 0; event < expected_lps.size(); event++) check_close(expected_lps[event], actual_lps[event], context + ": gibbs conditional (batch limit " + boost::lexical_cast<string>(max_batched_table_size) + ")");
+                }
+            }
+            max_batched_table_size = MAX_BATCHED_TABLE_SIZE;
+            prune_log_tolerance = LOG_TOL;
+            check_pruning(item, expected_keys, expected_lps, context);
+            check_bookkeeping(context + " after scoring");
+
+            // put the item back where it was
+            if (was_alone) {
+                assign_item_to_table(item, cur_table_id, true);
+                parameters[cur_table_id] = cur_params;
+            }
+            else assign_item_to_table(item, cur_table_id, false);
+        }
+
+        check_cold_start(context);
+    }
+
+    // every table's bound is at least its score, and the tables score_candidate_tables prunes carry at most a TOL fraction of the 
+    // probability. the item is unassigned
+    void check_pruning(const size_t item, const vector<size_t> & expected_keys, const vector<double> & expected_lps, const string & context) {
+        size_t num_correct = 0, num_incorrect = 0;
+        const vector<size_t> & affected_students = students_who_studied.at(item);
+        for (size_t student_idx = 0; student_idx < affected_students.size(); student_idx++) {
+            const size_t student = affected_students[student_idx];
+            for (size_t idx = 0; idx < trials_studied[student][item].size(); idx++) {
+                if (item_and_recall_sequences[student][trials_studied[student][item][idx]].second) num_correct++;
+                else num_incorrect++;
+            }
+        }
+        for (size_t event = 0; event < expected_keys.size(); event++) {
+            const size_t table_id = expected_keys[event];
+            const double seating_lp = log_old_table_probability(table_sizes.at(table_id), compute_K(item, table_id, false), log_gamma, num_expert_provided_skills);
+            check_true(expected_lps[event] <= seating_lp + table_log_ratio_bound(parameters.at(table_id), num_correct, num_incorrect) + 1e-9 * max(1.0, abs(expected_lps[event])), context + ": table score bound");
+        }
+
+        vector<size_t> actual_keys;
+        vector<double> actual_lps;
+        score_candidate_tables(item, actual_keys, actual_lps);
+        check_true(actual_lps.size() == actual_keys.size() + num_subsamples, context + ": pruned candidate tables");
+        const double max_lp = *max_element(expected_lps.begin(), expected_lps.end());
+        double total = 0.0, pruned = 0.0;
+        for (size_t event = 0, kept = 0; event < expected_lps.size(); event++) {
+            total += exp(expected_lps[event] - max_lp);
+            const bool is_kept = event >= expected_keys.size() || (kept < actual_keys.size() && actual_keys[kept] == expected_keys[event]);
+            if (!is_kept) {
+                pruned += exp(expected_lps[event] - max_lp);
+                continue;
+            }
+            const size_t actual_event = event >= expected_keys.size() ? actual_keys.size() + event - expected_keys.size() : kept++;
+            if (actual_event < actual_lps.size()) check_close(expected_lps[event], actual_lps[actual_event], context + ": pruned gibbs conditional");
+        }
+        check_true(pruned <= TOL * total, context + ": pruned probability");
+    }
+
+    // ColdStartPlacer, given the current state as a posterior sample, against the Gibbs conditional of the last item, which 
+    // nobody in the training set studied
+    void check_cold_start(const string & context) {
+        const size_t item = num_items - 1;
+        check_true(students_who_studied.at(item).empty(), context + ": the last item has no training data");
+        const size_t cur_table_id = seating_arrangement.at(item);
+        const bool was_alone = table_sizes.at(cur_table_id) == 1;
+        const struct bkt_parameters cur_params = parameters.at(cur_table_id);
+        remove_item_from_table(item, cur_table_id);
+
+        vector<size_t> keys;
+        vector<double> lps;
+        score_candidate_tables(item, keys, lps);
+        const double max_lp = *max_element(lps.begin(), lps.end());
+        double total = 0.0;
+        for (size_t event = 0; event < lps.size(); event++) total += exp(lps[event] - max_lp);
+
+        // the sample's skill ids are the tables' positions in keys, and the auxiliary new tables are one event
+        posterior_sample sample;
+        boost::unordered_map<size_t, size_t> skill_ids;
+        for (size_t idx = 0; idx < keys.size(); idx++) skill_ids[keys[idx]] = idx;
+        for (size_t other_item = 0; other_item < item; other_item++) sample.skill_labels.push_back(skill_ids.at(seating_arrangement.at(other_item)));
+        sample.skill_parameters.resize(keys.size());
+        sample.log_alpha_prime = log_alpha_prime;
+        sample.log_gamma = log_gamma;
+        sample.weight = 1.0;
+        const ColdStartPlacer placer(vector<posterior_sample>(1, sample), dataset->get_provided_skill_labels());
+        vector<double> probs;
+        placer.skill_probabilities(0, dataset->get_provided_skill_labels().at(item), probs);
+
+        check_true(probs.size() == keys.size() + 1, context + ": cold start skills");
+        if (probs.size() == keys.size() + 1) {
+            double new_skill_prob = 0.0;
+            for (size_t event = keys.size(); event < lps.size(); event++) new_skill_prob += exp(lps[event] - max_lp) / total;
+            for (size_t idx = 0; idx < keys.size(); idx++) check_close(exp(lps[idx] - max_lp) / total, probs[idx], context + ": cold start probability");
+            check_close(new_skill_prob, probs.back(), context + ": cold start new skill probability");
+        }
+
+        if (was_alone) {
+            assign_item_to_table(item, cur_table_id, true);
+            parameters[cur_table_id] = cur_params;
+        }
+        else assign_item_to_table(item, cur_table_id, false);
+    }
+
+    /////////////////////////////////////////////////
+    //////////// sampling ///////////////////////////
+    /////////////////////////////////////////////////
+
+    // runs seating-only sweeps with the BKT parameters and hyperparameters held fixed, accumulating how often each pair of
+    // items shares a table and how often each number of tables occurs. the engine is ENGINE_PRODUCTION, ENGINE_REFERENCE,
+    // ENGINE_APPROXIMATE (which needs a model built with approximate_top_k) or ENGINE_ADAPTIVE_SCAN (adaptive_scan_floor), 
+    // which adapts its scan only with adapt
+    void run_seating_chain(const size_t num_sweeps, const size_t engine, const bool adapt, vector<double> & coassignment, vector<double> & num_tables_freq) {
+        coassignment.assign(num_items * num_items, 0.0);
+        num_tables_freq.assign(num_items + 1, 0.0);
+        for (size_t sweep = 0; sweep < num_sweeps; sweep++) {
+            if (engine == ENGINE_ADAPTIVE_SCAN) resample_seating(adapt);
+            for (size_t item = 0; item < num_items && engine != ENGINE_ADAPTIVE_SCAN; item++) {
+                if (engine == ENGINE_REFERENCE) reference_gibbs_resample_skill(item);
+                else if (engine == ENGINE_APPROXIMATE) approximate_gibbs_resample_skill(item);
+                else gibbs_resample_skill(item);
+            }
+            for (size_t i = 0; i < num_items; i++) {
+                for (size_t j = 0; j < num_items; j++) coassignment[i * num_items + j] += (seating_arrangement[i] == seating_arrangement[j]) / (double) num_sweeps;
+            }
+            num_tables_freq[extant_tables.size()] += 1.0 / num_sweeps;
+        }
+    }
+
+    // whether burn-in left the adaptive scan weighting items unevenly
+    bool scan_is_uneven() const {
+        return *min_element(scan_move_rates.begin(), scan_move_rates.end()) < *max_element(scan_move_rates.begin(), scan_move_rates.end());
+    }
+
+    // switches the random number generator used from here on
+    void use_generator(Random * new_generator) {
+        generator = new_generator;
+    }
+
+    // pins the hyperparameters so both chains target the same distribution
+    void fix_hyperparameters(const double alpha_prime, const double gamma) {
+        log_alpha_prime = log(alpha_prime);
+        log_gamma = log(gamma);
+    }
+};
+
+
+// compares the production, approximate (Metropolis-Hastings) and adaptive scan gibbs steps to the reference gibbs step by the partitions they 
+// sample. the chains use different seeds, so the comparison is statistical: co-assignment frequencies and the distribution of
+// the number of tables must agree to within what a few thousand autocorrelated sweeps can resolve
+void check_sampled_partitions(const double beta, const double gamma, const string & context) {
+
+    Random data_rng(11);
+    test_dataset data;
+    make_test_dataset(data_rng, 40, 7, 3, data);
+    const Dataset dataset(data.recall_sequences, data.item_sequences, data.provided_skill_labels, data.num_items);
+
+    const size_t num_sweeps = 4000;
+    vector<double> coassignment[NUM_ENGINES], num_tables_freq[NUM_ENGINES];
+    for (size_t engine = 0; engine < NUM_ENGINES; engine++) {
+        // identical initial states and auxiliary prior samples, then independent random streams
+        Random init_generator(100);
+        wcrp_config config = test_config(beta, data.train_students, 50);
+        if (engine == ENGINE_APPROXIMATE) config.approximate_top_k = 1; // most steps need the correction
+        if (engine == ENGINE_ADAPTIVE_SCAN) config.adaptive_scan_floor = .1;
+        ReferenceWCRP model(&init_generator, dataset, config);
+        Random generator(200 + engine);
+        model.use_generator(&generator);
+        model.fix_hyperparameters(1.0, gamma);
+        model.run_seating_chain(num_sweeps / 10, engine, true, coassignment[engine], num_tables_freq[engine]); // burn in
+        if (engine == ENGINE_ADAPTIVE_SCAN) check_true(model.scan_is_uneven(), context + ": the adaptive scan adapted during burn-in");
+        model.run_seating_chain(num_sweeps, engine, false, coassignment[engine], num_tables_freq[engine]);
+    }
+
+    for (size_t engine = 0; engine < NUM_ENGINES; engine++) {
+        if (engine == ENGINE_REFERENCE) continue;
+        double max_coassignment_diff = 0.0, num_tables_tv = 0.0;
+        for (size_t k = 0; k < coassignment[engine].size(); k++) max_coassignment_diff = max(max_coassignment_diff, abs(coassignment[engine][k] - coassignment[ENGINE_REFERENCE][k]));
+        for (size_t k = 0; k < num_tables_freq[engine].size(); k++) num_tables_tv += abs(num_tables_freq[engine][k] - num_tables_freq[ENGINE_REFERENCE][k]) / 2.0;
+
+        const string engine_context = context + (engine == ENGINE_APPROXIMATE ? " (approximate)" : engine == ENGINE_ADAPTIVE_SCAN ? " (adaptive scan)" : "");
+        cout << engine_context << ": max co-assignment difference = " << setprecision(4) << max_coassignment_diff << ", total variation of the number of skills = " << num_tables_tv << endl;
+        check_true(max_coassignment_diff < .1, engine_context + ": co-assignment frequencies differ between engines");
+        check_true(num_tables_tv < .1, engine_context + ": distribution of the number of skills differs between engines");
+    }
+}
+
+
+int main() {
+
+    cout.setf(ios::fixed);
+
+    // kernels on randomized states
+    const double betas[] = {0.0, 0.5};
+    for (size_t b = 0; b < 2; b++) {
+        for (size_t trial = 0; trial < 15; trial++) {
+            Random rng(1 + trial);
+            test_dataset data;
+            make_test_dataset(rng, 30, 12, 1 + trial % 4, data);
+            const Dataset dataset(data.recall_sequences, data.item_sequences, data.provided_skill_labels, data.num_items);
+
+            Random generator(1000 + trial);
+            ReferenceWCRP model(&generator, dataset, test_config(betas[b], data.train_students));
+            const string context = "beta=" + boost::lexical_cast<string>(betas[b]) + " state " + boost::lexical_cast<string>(trial);
+            model.check_kernels(rng, context + " (initial)");
+            for (size_t step = 0; step < 3; step++) {
+                model.randomize_state(rng, step > 0);
+                model.check_kernels(rng, context + (step > 0 ? " (extreme)" : " (random)"));
+            }
+        }
+    }
+    cout << "kernel checks: " << num_checks << " comparisons, " << num_failures << " mismatches" << endl;
+
+    // sampled partitions, with and without the expert-label machinery in play
+    check_sampled_partitions(0.0, 1.0, "plain CRP");
+    check_sampled_partitions(0.5, .3, "WCRP");
+
+    return finish_checks("kernel and partition checks");
+}
+
+#endif
@@ -0,0 +1,104 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef KNOWLEDGE_STATE_EXPORT_CPP
+#define KNOWLEDGE_STATE_EXPORT_CPP
+
+#include "common.hpp"
+#include "MixtureWCRP.hpp"
+#include "KnowledgeStates.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+// checks the exported knowledge states against a forward pass over each student's trials under the recorded samples
+
+#define NUM_ITERATIONS 6
+#define NUM_BURN 2
+
+
+int main() {
+
+    const size_t num_students = 60, num_items = 20;
+    Random data_generator(9);
+    vector< vector<bool> > recall_sequences;
+    vector< vector<size_t> > item_sequences;
+    make_random_sequences(data_generator, num_students, num_items, 1, 30, recall_sequences, item_sequences);
+    recall_sequences[7].clear(); // a student with no trials
+    item_sequences[7].clear();
+    vector<size_t> provided_skill_labels(num_items, 0);
+
+    const string filename = "knowledge_state_export.bin";
+    vector< vector<size_t> > skill_samples;
+    vector< vector<struct bkt_parameters> > parameter_samples;
+    {
+        Random generator(13);
+        const Dataset dataset(recall_sequences, item_sequences, provided_skill_labels, num_items);
+        MixtureWCRP model(&generator, dataset, test_config(0.0, training_students(num_students, 4)));
+        model.export_knowledge_states(filename.c_str());
+        model.run_mcmc(NUM_ITERATIONS, NUM_BURN, false, true);
+        skill_samples = model.get_sampled_skill_labels();
+        parameter_samples = model.get_sampled_skill_parameters();
+    } // the file is finished when the model is destroyed
+
+    const KnowledgeStateReader reader(filename.c_str());
+    check_true(reader.get_num_samples() == skill_samples.size(), "number of samples");
+
+    for (size_t sample = 0; sample < min(reader.get_num_samples(), skill_samples.size()); sample++) {
+        check_true(reader.get_num_students(sample) == num_students, "number of students");
+        if (reader.get_num_students(sample) != num_students) continue;
+        const vector<size_t> & labels = skill_samples[sample];
+        const vector<struct bkt_parameters> & params = parameter_samples[sample];
+        for (size_t student = 0; student < num_students; student++) {
+            // the forward pass, as in PosteriorPredictor::observe
+            map<size_t, double> p_learned;
+            for (size_t trial = 0; trial < item_sequences[student].size(); trial++) {
+                const size_t skill = labels[item_sequences[student][trial]];
+                const struct bkt_parameters & skill_params = params[skill];
+                const double pi1 = skill_params.pi1, pi0 = skill_params.pi1 * skill_params.prop0;
+                if (!p_learned.count(skill)) p_learned[skill] = skill_params.psi;
+                const double p = p_learned[skill];
+                if (recall_sequences[student][trial]) p_learned[skill] = (pi1 * p + skill_params.mu * pi0 * (1.0 - p)) / (pi1 * p + pi0 * (1.0 - p));
+                else p_learned[skill] = ((1.0 - pi1) * p + skill_params.mu * (1.0 - pi0) * (1.0 - p)) / ((1.0 - pi1) * p + (1.0 - pi0) * (1.0 - p));
+            }
+
+            size_t num_entries;
+            const knowledge_state_entry * entries = reader.get_entries(sample, student, num_entries);
+            check_true(num_entries == p_learned.size(), "number of skills a student has knowledge states for");
+            if (num_entries != p_learned.size()) continue;
+            size_t entry = 0;
+            for (map<size_t, double>::const_iterator itr = p_learned.begin(); itr != p_learned.end(); itr++, entry++) {
+                check_true(entries[entry].skill == itr->first && abs(entries[entry].p_learned - itr->second) <= 1e-6, "knowledge state entry");
+                check_close(itr->second, reader.get_p_learned(sample, student, itr->first), 1e-6, "get_p_learned");
+            }
+        }
+        check_true(reader.get_p_learned(sample, 7, 0) == -1.0, "student 7 has no trials");
+    }
+    remove(filename.c_str());
+
+    return finish_checks("knowledge states");
+}
+
+#endif
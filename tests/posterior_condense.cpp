@@ -0,0 +1,121 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef POSTERIOR_CONDENSE_TEST_CPP
+#define POSTERIOR_CONDENSE_TEST_CPP
+
+#include "common.hpp"
+#include "Posterior.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+// checks that condensing a posterior of duplicated samples keeps its predictions, and that a tolerance max_samples picks
+// can't reach is reported
+
+#define NUM_ITEMS 8
+#define NUM_STUDENTS 200
+
+
+// a random partition of the items with random BKT parameters per skill
+posterior_sample make_sample(Random & generator) {
+    posterior_sample sample;
+    const size_t num_skills = 1 + generator.sampleUniformDiscrete(4);
+    for (size_t item = 0; item < NUM_ITEMS; item++) sample.skill_labels.push_back(item < num_skills ? item : generator.sampleUniformDiscrete(num_skills));
+    sample.skill_parameters.resize(num_skills);
+    for (size_t skill = 0; skill < num_skills; skill++) {
+        sample.skill_parameters[skill].psi = generator.sampleUniform01();
+        sample.skill_parameters[skill].mu = generator.sampleUniform01();
+        sample.skill_parameters[skill].pi1 = .5 + .5 * generator.sampleUniform01();
+        sample.skill_parameters[skill].prop0 = generator.sampleUniform01();
+    }
+    sample.log_alpha_prime = sample.log_gamma = NAN;
+    sample.weight = 1.0;
+    return sample;
+}
+
+
+// the largest difference between the two posteriors' predictions over the students' trials
+double max_prediction_difference(const vector<posterior_sample> & a, const vector<posterior_sample> & b, const vector< vector<bool> > & recall_sequences, const vector< vector<size_t> > & item_sequences) {
+    const PosteriorPredictor predictor_a(a, NUM_ITEMS), predictor_b(b, NUM_ITEMS);
+    double max_difference = 0.0;
+    vector<double> state_a, state_b;
+    for (size_t student = 0; student < item_sequences.size(); student++) {
+        predictor_a.init_state(state_a);
+        predictor_b.init_state(state_b);
+        for (size_t trial = 0; trial < item_sequences[student].size(); trial++) {
+            const size_t item = item_sequences[student][trial];
+            max_difference = max(max_difference, fabs(predictor_a.predict(state_a, item) - predictor_b.predict(state_b, item)));
+            predictor_a.observe(state_a, item, recall_sequences[student][trial]);
+            predictor_b.observe(state_b, item, recall_sequences[student][trial]);
+        }
+    }
+    return max_difference;
+}
+
+
+int main() {
+
+    Random generator(17);
+    vector< vector<bool> > recall_sequences, test_recall_sequences;
+    vector< vector<size_t> > item_sequences, test_item_sequences;
+    make_random_sequences(generator, NUM_STUDENTS, NUM_ITEMS, 1, 30, recall_sequences, item_sequences);
+    make_random_sequences(generator, NUM_STUDENTS, NUM_ITEMS, 1, 30, test_recall_sequences, test_item_sequences);
+
+    // two distinct samples, each repeated: two picks reproduce the full posterior, on held-out students too
+    const posterior_sample first = make_sample(generator), second = make_sample(generator);
+    vector<posterior_sample> duplicated;
+    for (size_t copy = 0; copy < 5; copy++) {
+        duplicated.push_back(first);
+        duplicated.push_back(second);
+    }
+    vector<posterior_sample> condensed;
+    double full_cross_entropy, condensed_cross_entropy;
+    bool reached = condense_posterior(duplicated, NUM_ITEMS, recall_sequences, item_sequences, 10, 1e-6, condensed, full_cross_entropy, condensed_cross_entropy);
+    check_true(reached, "duplicated samples reach the tolerance");
+    check_true(condensed.size() == 2, "duplicated samples condense to the distinct ones");
+    check_true(fabs(condensed_cross_entropy - full_cross_entropy) <= 1e-6, "the reported cross-entropies agree");
+    double total_weight = 0.0;
+    for (size_t sample = 0; sample < condensed.size(); sample++) total_weight += condensed[sample].weight;
+    check_true(fabs(total_weight - 1.0) < 1e-12, "condensed weights sum to 1");
+    check_true(max_prediction_difference(duplicated, condensed, recall_sequences, item_sequences) < 1e-6, "condensed predictions match the full posterior's");
+    check_true(max_prediction_difference(duplicated, condensed, test_recall_sequences, test_item_sequences) < 1e-6, "condensed predictions match the full posterior's on held-out students");
+
+    // distinct samples, one pick and no tolerance: unreachable, and the achieved error says so
+    vector<posterior_sample> distinct;
+    for (size_t sample = 0; sample < 6; sample++) distinct.push_back(make_sample(generator));
+    reached = condense_posterior(distinct, NUM_ITEMS, recall_sequences, item_sequences, 1, 0.0, condensed, full_cross_entropy, condensed_cross_entropy);
+    check_true(!reached, "an unreachable tolerance is reported");
+    check_true(condensed.size() == 1 && condensed[0].weight == 1.0, "one pick keeps one sample");
+    check_true(fabs(condensed_cross_entropy - full_cross_entropy) > 0.0, "the achieved cross-entropy is outside the tolerance");
+
+    // with enough picks a loose tolerance is reached
+    reached = condense_posterior(distinct, NUM_ITEMS, recall_sequences, item_sequences, 50, .01, condensed, full_cross_entropy, condensed_cross_entropy);
+    check_true(reached && fabs(condensed_cross_entropy - full_cross_entropy) <= .01, "a loose tolerance is reached");
+
+    return finish_checks("posterior condensing");
+}
+
+#endif
@@ -0,0 +1,305 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef SAMPLE_SINKS_CPP
+#define SAMPLE_SINKS_CPP
+
+#include "common.hpp"
+#include "MixtureWCRP.hpp"
+#include "Posterior.hpp"
+#include "PartitionEstimate.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+// records one chain into the in-memory, streaming and summary sinks at once and checks that they agree, checks that 
+// observers see every phase and can stop the chain, and checks the incremental co-assignment counts against the samples
+
+#define NUM_ITERATIONS 8
+#define NUM_BURN 3
+
+
+// forwards every sample to each of the sinks
+class TeeSampleSink : public SampleSink {
+
+  public:
+
+    TeeSampleSink(const vector<SampleSink *> & sinks) : sinks(sinks) {}
+
+    bool wants_predictions() const {
+        bool any = false;
+        for (size_t sink = 0; sink < sinks.size(); sink++) any = any || sinks[sink]->wants_predictions();
+        return any;
+    }
+
+    void add_sample(const chain_sample & sample, const vector< vector<double> > & predictions) {
+        const vector< vector<double> > no_predictions;
+        for (size_t sink = 0; sink < sinks.size(); sink++) sinks[sink]->add_sample(sample, sinks[sink]->wants_predictions() ? predictions : no_predictions);
+    }
+
+    void clear() {
+        for (size_t sink = 0; sink < sinks.size(); sink++) sinks[sink]->clear();
+    }
+
+    const vector<SampleSink *> sinks;
+};
+
+
+// counts the phases it sees and stops the chain at the given iteration and phase
+class StoppingObserver : public ChainObserver {
+
+  public:
+
+    StoppingObserver(const size_t stop_iteration, const int stop_phase) : stop_iteration(stop_iteration), stop_phase(stop_phase), num_phases(0), num_iterations(0) {}
+
+    bool after_phase(const MixtureWCRP & /*model*/, const size_t iteration, const sampler_phase phase) {
+        num_phases++;
+        return !(iteration == stop_iteration && (int) phase == stop_phase);
+    }
+
+    bool after_iteration(const MixtureWCRP & model, const size_t iteration, const double /*train_ll*/) {
+        num_iterations++;
+        chain_sample sample;
+        model.get_current_sample(sample);
+        check_true(sample.skill_parameters.size() == model.get_num_skills(), "the current sample has the model's skills");
+        return !(iteration == stop_iteration && stop_phase < 0);
+    }
+
+    const size_t stop_iteration;
+    const int stop_phase; // a sampler_phase, or -1 to stop after the iteration
+    size_t num_phases;
+    size_t num_iterations;
+};
+
+
+void check_sinks(const Dataset & dataset, const wcrp_config & config) {
+    const string filename = "sample_sinks.posterior";
+    InMemorySampleSink memory;
+    SummarySampleSink summary(true), lean_summary(false);
+    StreamingSampleSink * stream = new StreamingSampleSink(filename.c_str());
+    vector<SampleSink *> sinks;
+    sinks.push_back(&memory);
+    sinks.push_back(&summary);
+    sinks.push_back(&lean_summary);
+    sinks.push_back(stream);
+    TeeSampleSink tee(sinks);
+
+    Random generator(19);
+    MixtureWCRP model(&generator, dataset, config);
+    model.set_progress_stream(NULL);
+    model.set_sample_sink(&tee);
+    model.run_mcmc(NUM_ITERATIONS, NUM_BURN, false, true);
+    delete stream;
+
+    const size_t num_samples = NUM_ITERATIONS - NUM_BURN;
+    check_true(memory.get_num_samples() == num_samples && summary.get_num_samples() == num_samples && lean_summary.get_num_samples() == num_samples, "every sink gets every sample");
+
+    // the summaries agree with the full record
+    const vector<double> train_lls = memory.get_train_ll_samples();
+    const vector< vector<size_t> > skill_samples = memory.get_sampled_skill_labels();
+    const vector< vector<struct bkt_parameters> > parameter_samples = memory.get_sampled_skill_parameters();
+    const double mean_ll = accumulate(train_lls.begin(), train_lls.end(), 0.0) / num_samples;
+    double variance_ll = 0.0;
+    for (size_t sample = 0; sample < num_samples; sample++) variance_ll += pow(train_lls[sample] - mean_ll, 2) / (num_samples - 1);
+    check_true(abs(summary.get_mean_train_ll() - mean_ll) < 1e-9 * abs(mean_ll), "mean training log likelihood");
+    check_true(abs(summary.get_train_ll_variance() - variance_ll) < 1e-6 * max(1.0, variance_ll), "variance of the training log likelihood");
+    check_true(summary.get_most_likely_sample().skill_labels == memory.get_most_likely_skill_labels(), "most likely sample");
+    for (size_t student = 0; student < dataset.get_num_students(); student++) {
+        for (size_t trial = 0; trial < dataset.get_item_sequences()[student].size(); trial++) {
+            check_true(summary.get_estimated_recall_prob(student, trial) == memory.get_estimated_recall_prob(student, trial), "mean prediction");
+        }
+    }
+
+    // the streamed posterior has every sample
+    vector<posterior_sample> streamed;
+    size_t num_items;
+    load_posterior(filename.c_str(), streamed, num_items);
+    remove(filename.c_str());
+    check_true(num_items == dataset.get_num_items() && streamed.size() == num_samples, "streamed posterior size");
+    for (size_t sample = 0; sample < min(streamed.size(), num_samples); sample++) {
+        check_true(streamed[sample].skill_labels == skill_samples[sample], "streamed skill labels");
+        check_true(streamed[sample].skill_parameters.size() == parameter_samples[sample].size(), "streamed number of skills");
+        for (size_t skill = 0; skill < min(streamed[sample].skill_parameters.size(), parameter_samples[sample].size()); skill++) {
+            check_true(streamed[sample].skill_parameters[skill].mu == parameter_samples[sample][skill].mu, "streamed parameters");
+        }
+    }
+}
+
+
+void check_observers(const Dataset & dataset, const wcrp_config & config) {
+
+    // stopping after an iteration keeps its sample
+    {
+        Random generator(23);
+        MixtureWCRP model(&generator, dataset, config);
+        model.set_progress_stream(NULL);
+        StoppingObserver observer(NUM_BURN + 2, -1);
+        model.add_observer(&observer);
+        const size_t num_run = model.run_mcmc(NUM_ITERATIONS, NUM_BURN, false, true);
+        check_true(num_run == NUM_BURN + 2 && observer.num_iterations == NUM_BURN + 2, "stopping after an iteration");
+        check_true(observer.num_phases == (NUM_BURN + 2) * NUM_SAMPLER_PHASES, "every phase is observed");
+        check_true(model.get_train_ll_samples().size() == 2, "the last iteration is recorded");
+    }
+
+    // stopping in the seating phase drops the rest of the iteration
+    {
+        Random generator(23);
+        MixtureWCRP model(&generator, dataset, config);
+        model.set_progress_stream(NULL);
+        StoppingObserver observer(NUM_BURN + 2, PHASE_SEATING);
+        model.add_observer(&observer);
+        const size_t num_run = model.run_mcmc(NUM_ITERATIONS, NUM_BURN, false, true);
+        check_true(num_run == NUM_BURN + 1 && observer.num_iterations == NUM_BURN + 1, "stopping in a phase");
+        check_true(model.get_train_ll_samples().size() == 1, "the stopped iteration isn't recorded");
+    }
+}
+
+
+void check_coassignment(const Dataset & dataset, const wcrp_config & config) {
+    Random generator(29);
+    MixtureWCRP model(&generator, dataset, config);
+    model.set_progress_stream(NULL);
+    model.run_mcmc(2, 0, false, true); // not counted
+    const CoassignmentCounts & counts = model.enable_coassignment();
+    model.run_mcmc(40, 0, false, true);
+    const vector< vector<size_t> > skill_samples = model.get_sampled_skill_labels();
+    check_true(counts.get_num_samples() == 40 && skill_samples.size() == 42, "co-assignment counts the samples after it's enabled");
+
+    const size_t num_items = dataset.get_num_items();
+    vector<size_t> expected(num_items * num_items, 0);
+    for (size_t sample = 2; sample < skill_samples.size(); sample++) {
+        for (size_t a = 0; a < num_items; a++) {
+            for (size_t b = 0; b < num_items; b++) expected[a * num_items + b] += skill_samples[sample][a] == skill_samples[sample][b];
+        }
+    }
+    size_t num_together = 0;
+    for (size_t a = 0; a < num_items; a++) {
+        for (size_t b = 0; b < num_items; b++) {
+            check_true(counts.get_count(a, b) == expected[a * num_items + b], "co-assignment count");
+            if (a < b && expected[a * num_items + b] > 0) num_together++;
+        }
+    }
+    vector< pair<size_t, size_t> > pairs;
+    counts.get_pairs(pairs);
+    check_true(pairs.size() == num_together, "co-assignment keeps exactly the pairs that were together");
+}
+
+
+// the binder loss averaged over the samples, and the vi lower bound from the dense co-assignment probabilities
+double dense_expected_loss(const partition_loss loss, const vector<size_t> & labels, const vector< vector<size_t> > & skill_samples, const CoassignmentCounts & counts) {
+    const size_t num_items = labels.size();
+    double expected = 0.0;
+    if (loss == BINDER_LOSS) {
+        for (size_t sample = 0; sample < skill_samples.size(); sample++) {
+            for (size_t a = 0; a < num_items; a++) {
+                for (size_t b = a + 1; b < num_items; b++) expected += (labels[a] == labels[b]) != (skill_samples[sample][a] == skill_samples[sample][b]);
+            }
+        }
+        return expected / skill_samples.size();
+    }
+    for (size_t a = 0; a < num_items; a++) {
+        double size = 0.0, affinity = 0.0, row_sum = 0.0;
+        for (size_t b = 0; b < num_items; b++) {
+            size += labels[a] == labels[b];
+            affinity += (labels[a] == labels[b]) * counts.get_probability(a, b);
+            row_sum += counts.get_probability(a, b);
+        }
+        expected += log2(size) - 2.0 * log2(affinity) + log2(row_sum);
+    }
+    return expected / num_items;
+}
+
+
+void check_point_estimate() {
+    // noisy draws around three skills of four items, fed to the counts pair by pair as a chain would
+    Random generator(31);
+    const size_t num_items = 12, num_samples = 40;
+    CoassignmentCounts counts(num_items);
+    vector< vector<size_t> > skill_samples;
+    for (size_t sample = 0; sample < num_samples; sample++) {
+        vector<size_t> labels(num_items);
+        for (size_t item = 0; item < num_items; item++) labels[item] = generator.sampleBernoulli(.3) ? generator.sampleUniformDiscrete(5) : item / 4;
+        for (size_t a = 0; a < num_items; a++) {
+            for (size_t b = a + 1; b < num_items; b++) {
+                const bool was_together = sample > 0 && skill_samples.back()[a] == skill_samples.back()[b];
+                if (labels[a] == labels[b] && !was_together) counts.pair_joined(a, b);
+                if (labels[a] != labels[b] && was_together) counts.pair_separated(a, b);
+            }
+        }
+        counts.add_sample();
+        skill_samples.push_back(labels);
+    }
+    const PartitionEstimator estimator(counts);
+
+    for (size_t loss_idx = 0; loss_idx < 2; loss_idx++) {
+        const partition_loss loss = loss_idx == 0 ? BINDER_LOSS : VI_LOSS;
+        const vector<size_t> labels = estimator.minimize(loss, skill_samples.front());
+        const double expected = estimator.expected_loss(loss, labels);
+        check_true(fabs(expected - dense_expected_loss(loss, labels, skill_samples, counts)) < 1e-9, "sparse expected loss matches the dense one");
+
+        double best_sample = numeric_limits<double>::infinity();
+        for (size_t sample = 0; sample < skill_samples.size(); sample++) best_sample = min(best_sample, estimator.expected_loss(loss, skill_samples[sample]));
+        check_true(expected <= best_sample + 1e-9, "the point estimate is no worse than any sample");
+
+        // no single item can do better in another skill, or alone
+        bool local_optimum = true;
+        for (size_t item = 0; item < num_items; item++) {
+            for (size_t skill = 0; skill <= num_items; skill++) {
+                vector<size_t> moved(labels);
+                moved[item] = skill;
+                if (dense_expected_loss(loss, moved, skill_samples, counts) < expected - 1e-9) local_optimum = false;
+            }
+        }
+        check_true(local_optimum, "no single move improves the point estimate");
+        check_true(labels[0] == 0 && *max_element(labels.begin(), labels.end()) < num_items, "point estimate labels are compact");
+        bool recovered = true;
+        for (size_t a = 0; a < num_items; a++) {
+            for (size_t b = 0; b < num_items; b++) recovered = recovered && (labels[a] == labels[b]) == (a / 4 == b / 4);
+        }
+        check_true(recovered, "the point estimate recovers the three skills");
+    }
+}
+
+
+int main() {
+
+    const size_t num_students = 50, num_items = 15;
+    vector< vector<bool> > recall_sequences;
+    vector< vector<size_t> > item_sequences;
+    Random data_generator(17);
+    make_random_sequences(data_generator, num_students, num_items, 1, 30, recall_sequences, item_sequences);
+    const Dataset dataset(recall_sequences, item_sequences, vector<size_t>(), num_items);
+
+    const wcrp_config config = test_config(0.0, training_students(num_students, 5));
+
+    check_sinks(dataset, config);
+    check_observers(dataset, config);
+    check_coassignment(dataset, config);
+    check_point_estimate();
+
+    return finish_checks("sample sinks and observers");
+}
+
+#endif
@@ -0,0 +1,100 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Robert Lindsey
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include "common.hpp"
+#include "Random.hpp"
+#include "MixtureWCRP.hpp"
+
+// what the tests share: the check counters, random datasets and a sampler config. each test is a single translation unit,
+// so the counters are static
+
+static size_t num_checks = 0;
+static size_t num_failures = 0;
+
+// failures past the first 20 are counted but not printed
+inline void check_true(const bool condition, const std::string & what) {
+    num_checks++;
+    if (condition) return;
+    if (num_failures++ < 20) std::cout << "FAILED: " << what << std::endl;
+}
+
+// equal values pass whatever the tolerance, so matching infinities do
+inline void check_close(const double expected, const double actual, const double tolerance, const std::string & what) {
+    num_checks++;
+    if (expected == actual || std::abs(expected - actual) <= tolerance) return;
+    if (num_failures++ < 20) std::cout << "FAILED: " << what << ": expected " << std::setprecision(17) << expected << ", got " << actual << std::endl;
+}
+
+// prints the counts and the verdict, and returns the test's exit status
+inline int finish_checks(const std::string & name) {
+    std::cout << name << ": " << num_checks << " checks, " << num_failures << " failures" << std::endl;
+    std::cout << (num_failures == 0 ? "PASSED" : "FAILED") << std::endl;
+    return num_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+// each student gets min_length + a uniform draw from 0 ... length_range - 1 trials of uniformly random items, recalled with probability .6
+inline void make_random_sequences(Random & generator, const size_t num_students, const size_t num_items, const size_t min_length, const size_t length_range,
+                                  std::vector< std::vector<bool> > & recall_sequences, std::vector< std::vector<size_t> > & item_sequences) {
+    recall_sequences.assign(num_students, std::vector<bool>());
+    item_sequences.assign(num_students, std::vector<size_t>());
+    for (size_t student = 0; student < num_students; student++) {
+        const size_t length = min_length + generator.sampleUniformDiscrete(length_range);
+        for (size_t trial = 0; trial < length; trial++) {
+            item_sequences[student].push_back(generator.sampleUniformDiscrete(num_items));
+            recall_sequences[student].push_back(generator.sampleBernoulli(.6));
+        }
+    }
+}
+
+// expert labels drawn uniformly from num_skills skills
+inline std::vector<size_t> random_skill_labels(Random & generator, const size_t num_items, const size_t num_skills) {
+    std::vector<size_t> labels(num_items);
+    for (size_t item = 0; item < num_items; item++) labels[item] = generator.sampleUniformDiscrete(num_skills);
+    return labels;
+}
+
+// every student but each heldout_every'th, starting with student 0
+inline std::set<size_t> training_students(const size_t num_students, const size_t heldout_every) {
+    std::set<size_t> train_students;
+    for (size_t student = 0; student < num_students; student++) {
+        if (student % heldout_every != 0) train_students.insert(student);
+    }
+    return train_students;
+}
+
+inline wcrp_config test_config(const double beta, const std::set<size_t> & train_students, const size_t num_subsamples = 20) {
+    wcrp_config config;
+    config.beta = beta;
+    config.init_alpha_prime = 1.0;
+    config.num_subsamples = num_subsamples;
+    config.train_students = train_students;
+    return config;
+}
+
+#endif